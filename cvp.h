@@ -22,6 +22,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 // Author: Eric Rotenberg (ericro@ncsu.edu)
 
+#include <stdio.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -175,3 +176,18 @@ void beginPredictor(int argc_other, char **argv_other);
 //
 extern
 void endPredictor();
+
+//
+// savePredictor() and restorePredictor() (optional)
+//
+// These functions are called by the simulator when it writes a checkpoint of the simulation (-K) and when it resumes
+// from one (-L), after beginPredictor(). savePredictor() writes the predictor's complete state (tables, histories,
+// in-flight instructions) to fp; restorePredictor() reads it back, in the same order. Both return false on failure.
+// They are optional: a predictor that does not define them resumes from a checkpoint with its initial state.
+//
+extern
+bool savePredictor(FILE *fp) __attribute__((weak));
+
+extern
+bool restorePredictor(FILE *fp) __attribute__((weak));
+
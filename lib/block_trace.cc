@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <zlib.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "block_trace.h"
+#include "trace_reader.h"
+
+static unsigned default_threads(unsigned threads) {
+   if (threads == 0)
+      threads = std::thread::hardware_concurrency();
+   return((threads == 0) ? 1 : threads);
+}
+
+bool is_block_trace(const char *name) {
+   char magic[sizeof(((block_trace_header_t *)0)->magic)];
+   FILE *fp = fopen(name, "rb");
+   if (!fp)
+      return(false);
+   bool block = ((fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) && !memcmp(magic, BLOCK_TRACE_MAGIC, sizeof(magic)));
+   fclose(fp);
+   return(block);
+}
+
+bool block_trace_pack(const char *in_name, const char *out_name, size_t block_size, int level, unsigned threads) {
+   // Blocks must be able to feed the reader a whole record without help from the next block.
+   block_size = std::max(block_size, MAX_TRACE_INPUT_NEED);
+   threads = default_threads(threads);
+
+   // Block and codec traces can be re-packed too (e.g., with a different block size).
+   trace_options_t options;
+   options.threads = threads;
+   trace_input_t *input = open_trace_input(in_name, options);
+   if (!input)
+      return(false);
+   FILE *fp = fopen(out_name, "wb");
+   if (!fp) {
+      delete input;
+      return(false);
+   }
+
+   block_trace_header_t header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, BLOCK_TRACE_MAGIC, sizeof(header.magic));
+   header.version = BLOCK_TRACE_VERSION;
+   header.entry_size = sizeof(block_trace_entry_t);
+   bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);	// written again once complete
+
+   std::vector<block_trace_entry_t> table;
+   std::vector<std::vector<uint8_t>> raw(threads), packed(threads);
+   uint64_t num_instr = 0;
+   uint64_t offset = sizeof(header);
+   bool more = true;
+
+   while (more && ok) {
+      // Cut up to "threads" blocks at record boundaries...
+      unsigned n;
+      for (n = 0; (n < threads) && more; n++) {
+         block_trace_entry_t e;
+         e.first_instr = num_instr;
+         raw[n].clear();
+         while (raw[n].size() < block_size) {
+            size_t avail = input->ensure(MAX_TRACE_INPUT_NEED);
+            size_t size = CVPTraceReader::recordSize(input->data(), avail);
+            if (size == 0) {
+               more = false;	// end of trace (a truncated last record is dropped)
+               break;
+            }
+            raw[n].insert(raw[n].end(), input->data(), input->data() + size);
+            input->consume(size);
+            num_instr++;
+         }
+         if (raw[n].empty()) {
+            break;
+         }
+         e.size = raw[n].size();
+         table.push_back(e);
+      }
+
+      // ...compress them in parallel...
+      std::vector<std::thread> compressors;
+      std::vector<int> status(n, Z_OK);
+      for (unsigned i = 0; i < n; i++) {
+         compressors.emplace_back([&, i]() {
+            uLongf size = compressBound(raw[i].size());
+            packed[i].resize(size);
+            status[i] = compress2(packed[i].data(), &size, raw[i].data(), raw[i].size(), level);
+            packed[i].resize(size);
+         });
+      }
+      for (auto &t : compressors)
+         t.join();
+
+      // ...and write them in order.
+      for (unsigned i = 0; i < n; i++) {
+         block_trace_entry_t &e = table[table.size() - n + i];
+         ok = ok && (status[i] == Z_OK);
+         ok = ok && (fwrite(packed[i].data(), 1, packed[i].size(), fp) == packed[i].size());
+         e.offset = offset;
+         e.compressed_size = packed[i].size();
+         offset += packed[i].size();
+         header.max_block_size = std::max(header.max_block_size, (uint64_t)e.size);
+      }
+   }
+
+   delete input;
+
+   header.num_blocks = table.size();
+   header.num_instr = num_instr;
+   header.table_offset = offset;
+   ok = ok && (fwrite(table.data(), sizeof(block_trace_entry_t), table.size(), fp) == table.size());
+   ok = ok && !fseek(fp, 0, SEEK_SET) && (fwrite(&header, sizeof(header), 1, fp) == 1);
+   return((fclose(fp) == 0) && ok);
+}
+
+int block_trace_open(const char *name, block_trace_header_t &header, std::vector<block_trace_entry_t> &table) {
+   int fd = open(name, O_RDONLY);
+   if (fd < 0) {
+      fprintf(stderr, "Cannot open trace %s\n", name);
+      return(-1);
+   }
+   if ((pread(fd, &header, sizeof(header), 0) != sizeof(header)) ||
+       memcmp(header.magic, BLOCK_TRACE_MAGIC, sizeof(header.magic)) ||
+       (header.version != BLOCK_TRACE_VERSION) ||
+       (header.entry_size != sizeof(block_trace_entry_t))) {
+      fprintf(stderr, "Invalid block trace %s\n", name);
+      close(fd);
+      return(-1);
+   }
+   table.resize(header.num_blocks);
+   size_t table_size = header.num_blocks * sizeof(block_trace_entry_t);
+   if (pread(fd, table.data(), table_size, header.table_offset) != (ssize_t)table_size) {
+      fprintf(stderr, "Truncated block trace %s\n", name);
+      close(fd);
+      return(-1);
+   }
+   return(fd);
+}
+
+bool block_trace_read(int fd, const block_trace_entry_t &e, std::vector<uint8_t> &in, uint8_t *buf) {
+   in.resize(e.compressed_size);
+   uLongf size = e.size;
+   return((pread(fd, in.data(), e.compressed_size, e.offset) == (ssize_t)e.compressed_size) &&
+          (uncompress(buf, &size, in.data(), e.compressed_size) == Z_OK) && (size == e.size));
+}
+
+block_input_t::block_input_t(const char *name, unsigned threads) {
+   block_trace_header_t header;
+   fd = block_trace_open(name, header, table);
+   if (fd < 0)
+      exit(1);
+   start(header.max_block_size, threads);
+}
+
+void block_input_t::start(uint64_t max_block_size, unsigned threads) {
+   uint64_t total = 0;
+   for (auto &e : table) {
+      block_out_offset.push_back(total);
+      total += e.size;
+   }
+   out_size = total;
+
+   pad = MAX_TRACE_INPUT_NEED;
+   buf_size = pad + max_block_size;
+   threads = default_threads(threads);
+
+   // Two blocks in flight per worker keep the workers busy while the reader consumes a block.
+   slots.resize(2 * threads);
+   for (auto &s : slots) {
+      s.buf = new uint8_t[buf_size];
+      s.size = 0;
+      s.block = 0;
+      s.ready = false;
+   }
+
+   next_schedule = 0;
+   free_before = 0;
+   generation = 0;
+   stop = false;
+   next_block = 0;
+   out_offset = 0;
+   cur = end = block_start = NULL;
+
+   for (unsigned i = 0; i < threads; i++)
+      workers.emplace_back(&block_input_t::worker, this);
+}
+
+block_input_t::~block_input_t() {
+   {
+      std::unique_lock<std::mutex> lk(lock);
+      stop = true;
+   }
+   cv_work.notify_all();
+   for (auto &t : workers)
+      t.join();
+   for (auto &s : slots)
+      delete [] s.buf;
+   if (fd >= 0)
+      close(fd);
+}
+
+void block_input_t::worker() {
+   std::vector<uint8_t> in;
+   uint8_t *mine = new uint8_t[buf_size];	// swapped with the slot's buffer once the block is decompressed
+
+   std::unique_lock<std::mutex> lk(lock);
+   while (true) {
+      // A block can be scheduled once the block that last used its slot has been consumed.
+      cv_work.wait(lk, [this]() { return (stop || ((next_schedule < table.size()) && (next_schedule < free_before + slots.size()))); });
+      if (stop)
+         break;
+      uint64_t b = next_schedule++;
+      uint64_t gen = generation;
+      lk.unlock();
+
+      size_t size = table[b].size;
+      if (!block_trace_read(fd, table[b], in, mine + pad)) {
+         fprintf(stderr, "Corrupt block %" PRIu64 " in block trace, the trace ends there\n", b);
+         size = 0;
+      }
+
+      lk.lock();
+      if (gen == generation) {
+         slot_t &s = slots[b % slots.size()];
+         std::swap(s.buf, mine);
+         s.size = size;
+         s.block = b;
+         s.ready = true;
+         cv_ready.notify_all();
+      }
+   }
+
+   delete [] mine;
+}
+
+size_t block_input_t::refill(size_t need) {
+   assert(need <= pad);
+   size_t left = (size_t)(end - cur);
+   if (next_block >= table.size())
+      return(left);
+
+   std::unique_lock<std::mutex> lk(lock);
+   slot_t &s = slots[next_block % slots.size()];
+   cv_ready.wait(lk, [&]() { return (s.ready && (s.block == next_block)); });
+
+   // Copy the unconsumed tail of the previous block in front of the next one.
+   uint8_t *start = s.buf + pad;
+   memmove(start - left, cur, left);
+   cur = start - left;
+   end = start + s.size;
+   block_start = start;
+   out_offset = block_out_offset[next_block];
+   s.ready = false;
+
+   // The previous block is no longer needed: its slot can be reused.
+   free_before = next_block;
+   next_block++;
+   lk.unlock();
+   cv_work.notify_all();
+
+   return((size_t)(end - cur));
+}
+
+uint64_t block_input_t::seek_record(uint64_t instr, uint64_t current) {
+   if (table.empty())
+      return(current);
+
+   // Last block starting at or before "instr".
+   auto it = std::upper_bound(table.begin(), table.end(), instr,
+                              [](uint64_t i, const block_trace_entry_t &e) { return i < e.first_instr; });
+   uint64_t b = ((it == table.begin()) ? 0 : (it - table.begin() - 1));
+
+   // Decode forward if the current position is already in or after that block.
+   if ((instr >= current) && (table[b].first_instr <= current))
+      return(current);
+
+   {
+      std::unique_lock<std::mutex> lk(lock);
+      generation++;
+      for (auto &s : slots)
+         s.ready = false;
+      next_schedule = b;
+      free_before = b;
+      next_block = b;
+   }
+   cv_work.notify_all();
+
+   out_offset = block_out_offset[b];
+   cur = end = block_start = NULL;
+   return(table[b].first_instr);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+// Block-compressed trace container.
+//
+// A single gzip stream can only be inflated serially. A block trace holds the
+// same CVP-1 records, cut at record boundaries into blocks of about 1 MB that
+// are compressed independently with zlib, followed by a table locating each
+// block and the first trace instruction it holds. block_input_t decompresses
+// the upcoming blocks on a pool of worker threads and hands them to
+// CVPTraceReader in order, so decoding scales with host cores; the table also
+// gives random access at block granularity. Use cvp-convert -f block to
+// re-pack existing traces.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "trace_input.h"
+
+#define BLOCK_TRACE_MAGIC	"CVPBLOCK"
+#define BLOCK_TRACE_VERSION	1
+#define DEFAULT_TRACE_BLOCK_SIZE	(1 << 20)
+
+struct block_trace_header_t {
+   char magic[8];		// BLOCK_TRACE_MAGIC, not null-terminated
+   uint32_t version;		// BLOCK_TRACE_VERSION
+   uint32_t entry_size;		// sizeof(block_trace_entry_t)
+   uint64_t num_blocks;
+   uint64_t num_instr;		// trace instructions in all blocks
+   uint64_t table_offset;	// file offset of the block table
+   uint64_t max_block_size;	// largest uncompressed block
+   uint8_t reserved[16];
+};
+
+static_assert(sizeof(block_trace_header_t) == 64, "block trace header layout changed");
+
+struct block_trace_entry_t {
+   uint64_t offset;		// file offset of the compressed block
+   uint32_t compressed_size;
+   uint32_t size;		// uncompressed size
+   uint64_t first_instr;	// trace instruction number of the block's first record
+};
+
+// Returns true if the file starts with the block trace magic.
+bool is_block_trace(const char *name);
+
+// Re-packs a CVP-1 trace (any format open_trace_input() reads) into a block trace, compressing with up to "threads" threads.
+bool block_trace_pack(const char *in_name, const char *out_name,
+                      size_t block_size = DEFAULT_TRACE_BLOCK_SIZE, int level = 6, unsigned threads = 0);
+
+// Opens a block trace and reads its header and block table. Returns the file descriptor, or -1 on error.
+int block_trace_open(const char *name, block_trace_header_t &header, std::vector<block_trace_entry_t> &table);
+
+// Decompresses block e of an open block trace into buf (e.size bytes), using "in" for the compressed bytes.
+bool block_trace_read(int fd, const block_trace_entry_t &e, std::vector<uint8_t> &in, uint8_t *buf);
+
+class block_input_t : public trace_input_t {
+private:
+   // A decompressed block. Its records start "pad" bytes into the buffer, so that
+   // the unconsumed tail of the previous block can be copied just in front of them.
+   struct slot_t {
+      uint8_t *buf;
+      size_t size;
+      uint64_t block;	// block held by the slot
+      bool ready;
+   };
+
+   std::vector<uint64_t> block_out_offset;	// decompressed offset of each block
+   uint64_t out_size;				// decompressed size of the trace
+   size_t pad;
+   size_t buf_size;
+
+   // Worker pool state, protected by lock.
+   std::mutex lock;
+   std::condition_variable cv_ready;	// signaled when a block is ready
+   std::condition_variable cv_work;	// signaled when blocks can be scheduled
+   std::vector<slot_t> slots;		// block b goes in slots[b % slots.size()]
+   uint64_t next_schedule;		// next block to hand to a worker
+   uint64_t free_before;		// blocks before this one are consumed: their slots can be reused
+   uint64_t generation;			// incremented on seeks to drop blocks decompressed for the old position
+   bool stop;
+   std::vector<std::thread> workers;
+
+   uint64_t next_block;			// next block to hand to the reader
+   uint64_t out_offset;			// decompressed offset of block_start
+   const uint8_t *block_start;		// start of the current block's own bytes (data() may be before it)
+
+   void worker();
+
+protected:
+   int fd;
+   std::vector<block_trace_entry_t> table;
+
+   // For containers that store other records in the block layout (see dict_input_t):
+   // the derived class sets fd and table, then calls start().
+   block_input_t() : fd(-1) {}
+   void start(uint64_t max_block_size, unsigned threads);
+
+   size_t refill(size_t need);
+
+public:
+   block_input_t(const char *name, unsigned threads = 0);
+   ~block_input_t();
+
+   uint64_t offset() const { return (out_offset + (cur - block_start)); }
+   double fraction_read() const { return (out_size ? ((double)offset() / out_size) : 1.0); }
+   uint64_t seek_record(uint64_t instr, uint64_t current);
+};
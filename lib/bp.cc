@@ -27,17 +27,16 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <assert.h>
 #include "cvp.h"
 #include "bp.h"
-#include "parameters.h"
-
-#include "parameters.h"
+#include "checkpoint.h"
 
 bp_t::bp_t(uint64_t cb_pc_length, uint64_t cb_bhr_length,
 	   uint64_t ib_pc_length, uint64_t ib_bhr_length,
-	   uint64_t ras_size)
+	   uint64_t ras_size, bool perfect_indirect)
    /* A. Seznec: introduction of  TAGE-SC-L and ITTAGE*/
    : TAGESCL(new PREDICTOR())
    , ITTAGE(new IPREDICTOR())
-   , ras(ras_size) {
+   , ras(ras_size)
+   , perfect_indirect(perfect_indirect) {
 
    // Initialize measurements.
    meas_branch_n = 0;
@@ -52,6 +51,8 @@ bp_t::bp_t(uint64_t cb_pc_length, uint64_t cb_bhr_length,
 }
 
 bp_t::~bp_t() {
+   delete TAGESCL;
+   delete ITTAGE;
 }
 
 // Returns true if instruction is a mispredicted branch.
@@ -121,7 +122,7 @@ bool bp_t::predict(InstClass insn, uint64_t pc, uint64_t next_pc) {
       else {
          // NOT RETURN
 #endif
-      if (PERFECT_INDIRECT_PRED) {
+      if (perfect_indirect) {
 	      misp = false;
          // Update measurements.
          meas_jumpind_n++;
@@ -163,6 +164,41 @@ bool bp_t::predict(InstClass insn, uint64_t pc, uint64_t next_pc) {
    return(misp);
 }
 
+void bp_t::warm(InstClass insn, uint64_t pc, uint64_t next_pc) {
+   if (insn == InstClass::condBranchInstClass) {
+      bool taken = (next_pc != (pc + 4));
+      bool pred_taken = TAGESCL->GetPrediction(pc);
+      TAGESCL->UpdatePredictor(pc, 1, taken, pred_taken, next_pc);
+   }
+   else if (insn == InstClass::uncondDirectBranchInstClass) {
+      TAGESCL->TrackOtherInst(pc, 0, true, next_pc);
+      ITTAGE->TrackOtherInst(pc, next_pc);
+   }
+   else if (insn == InstClass::uncondIndirectBranchInstClass) {
+      if (!perfect_indirect) {
+         ITTAGE->GetPrediction(pc);
+         ITTAGE->UpdatePredictor(pc, next_pc);
+      }
+      TAGESCL->TrackOtherInst(pc, 2, true, next_pc);
+   }
+}
+
+// The RAS is not saved: predict() does not use it.
+void bp_t::checkpoint(checkpoint_t &ck) {
+   TAGESCL->checkpoint(ck);
+   ITTAGE->checkpoint(ck);
+   ck.section("branch prediction measurements");
+   ck.io(meas_branch_n);
+   ck.io(meas_branch_m);
+   ck.io(meas_jumpdir_n);
+   ck.io(meas_jumpind_n);
+   ck.io(meas_jumpind_m);
+   ck.io(meas_jumpret_n);
+   ck.io(meas_jumpret_m);
+   ck.io(meas_notctrl_n);
+   ck.io(meas_notctrl_m);
+}
+
 inline bool bp_t::is_link_reg(uint64_t x) {
    return((x == 1) || (x == 5));
 }
@@ -170,9 +206,13 @@ inline bool bp_t::is_link_reg(uint64_t x) {
 #define BP_OUTPUT(str, n, m, i) \
 	printf("%s%10ld %10ld %5.2lf%% %5.2lf\n", (str), (n), (m), 100.0*((double)(m)/(double)(n)), 1000.0*((double)(m)/(double)(i)))
 
+uint64_t bp_t::mispredictions() const {
+   return(meas_branch_m + meas_jumpind_m + meas_jumpret_m + meas_notctrl_m);
+}
+
 void bp_t::output() {
    uint64_t num_inst = (meas_branch_n + meas_jumpdir_n + meas_jumpind_n + meas_jumpret_n + meas_notctrl_n);
-   uint64_t num_misp = (meas_branch_m + meas_jumpind_m + meas_jumpret_m + meas_notctrl_m);
+   uint64_t num_misp = mispredictions();
    printf("BRANCH PREDICTION MEASUREMENTS---------------------\n");
    printf("Type                      n          m     mr  mpki\n");
    BP_OUTPUT("All              ", num_inst, num_misp, num_inst);
@@ -39,6 +39,7 @@ public:
 	}
 
 	~ras_t() {
+	   delete [] ras;
 	}
 
 	inline void push(uint64_t x) {
@@ -65,6 +66,9 @@ private:
 	// Return address stack for predicting return targets.
 	ras_t ras;
 
+	// Perfect indirect-branch prediction.
+	bool perfect_indirect;
+
 	// Check for link register (x1) or alternate link register (x5)
 	bool is_link_reg(uint64_t x);
 
@@ -82,14 +86,23 @@ private:
 public:
 	bp_t(uint64_t cb_pc_length, uint64_t cb_bhr_length,
 	     uint64_t ib_pc_length, uint64_t ib_bhr_length,
-	     uint64_t ras_size);
+	     uint64_t ras_size, bool perfect_indirect);
 	~bp_t();
 
 	// Returns true if instruction is a mispredicted branch.
 	// Also updates all branch predictor structures as applicable.
 	bool predict(InstClass insn, uint64_t pc, uint64_t next_pc);
 
+	// Updates the predictor structures like predict(), without measurements (functional warming).
+	void warm(InstClass insn, uint64_t pc, uint64_t next_pc);
+
 	// Output all branch prediction measurements.
 	void output();
+
+	// Mispredictions of all types so far.
+	uint64_t mispredictions() const;
+
+	// Predictor tables and histories, and the measurements.
+	void checkpoint(checkpoint_t &ck);
 };
 
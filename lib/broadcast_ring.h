@@ -0,0 +1,133 @@
+#pragma once
+
+// Bounded ring for one producer and several consumers, in shared memory.
+//
+// Every consumer sees every entry: an entry is freed once all consumers have
+// released it. The ring lives in an anonymous shared mapping, so processes
+// forked after it is created share it, which is how one process decoding a
+// trace feeds the simulators of several configurations (cvp -m). The producer
+// keeps a private copy of the slowest consumer's index and only rescans the
+// consumers when the ring looks full.
+
+#include <atomic>
+#include <inttypes.h>
+#include <assert.h>
+#include <new>
+#include <sys/mman.h>
+
+template <class T>
+class broadcast_ring_t {
+private:
+	struct alignas(64) index_t {
+		std::atomic<uint64_t> value;
+	};
+
+	void *map;
+	size_t map_size;
+	T *q;
+	uint64_t mask;			// size - 1, size is a power of two
+	unsigned consumers;
+
+	index_t *tail;			// next entry to publish (written by producer)
+	std::atomic<bool> *finished;	// the producer published its last entry
+	index_t *heads;			// next entry to read, per consumer (written by that consumer); ~0: detached
+	uint64_t cached_head;		// producer's copy of the slowest head
+	uint64_t cached_tail;		// consumer's copy of tail
+
+public:
+	broadcast_ring_t(uint64_t size, unsigned consumers);
+	~broadcast_ring_t();
+
+	T *alloc();			// producer: returns the tail entry to fill, or NULL if full
+	void publish();			// producer: pushes the entry returned by alloc()
+	void finish();			// producer: no entries will be published anymore
+	void detach(unsigned c);	// producer: stop waiting for consumer c (e.g., it exited)
+
+	T *front(unsigned c);		// consumer c: returns its next entry, or NULL if none yet
+	void release(unsigned c);	// consumer c: done with the entry returned by front()
+	bool done(unsigned c);		// consumer c: true once it has read the producer's last entry
+};
+
+template <class T>
+broadcast_ring_t<T>::broadcast_ring_t(uint64_t size, unsigned consumers) : consumers(consumers) {
+   assert(size && ((size & (size - 1)) == 0));
+   map_size = (2 + consumers) * sizeof(index_t) + size * sizeof(T);
+   map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   assert(map != MAP_FAILED);
+
+   index_t *idx = (index_t *)map;
+   tail = new (&idx[0]) index_t;
+   finished = new (&idx[1]) std::atomic<bool>(false);
+   heads = &idx[2];
+   for (unsigned c = 0; c < consumers; c++)
+      new (&heads[c]) index_t;
+   q = (T *)&idx[2 + consumers];
+   mask = size - 1;
+
+   tail->value.store(0, std::memory_order_relaxed);
+   for (unsigned c = 0; c < consumers; c++)
+      heads[c].value.store(0, std::memory_order_relaxed);
+   cached_head = 0;
+   cached_tail = 0;
+}
+
+template <class T>
+broadcast_ring_t<T>::~broadcast_ring_t() {
+   munmap(map, map_size);
+}
+
+template <class T>
+T *broadcast_ring_t<T>::alloc() {
+   uint64_t t = tail->value.load(std::memory_order_relaxed);
+   if (t - cached_head > mask) {
+      // Rescan the consumers: the ring is full only for the slowest one.
+      uint64_t h = t;
+      for (unsigned c = 0; c < consumers; c++) {
+         uint64_t hc = heads[c].value.load(std::memory_order_acquire);
+         if (hc < h)
+            h = hc;
+      }
+      cached_head = h;
+      if (t - cached_head > mask)
+         return(NULL);
+   }
+   return(&q[t & mask]);
+}
+
+template <class T>
+void broadcast_ring_t<T>::publish() {
+   tail->value.store(tail->value.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <class T>
+void broadcast_ring_t<T>::finish() {
+   finished->store(true, std::memory_order_release);
+}
+
+template <class T>
+void broadcast_ring_t<T>::detach(unsigned c) {
+   heads[c].value.store(~0ull, std::memory_order_release);
+}
+
+template <class T>
+T *broadcast_ring_t<T>::front(unsigned c) {
+   uint64_t h = heads[c].value.load(std::memory_order_relaxed);
+   if (h == cached_tail) {
+      cached_tail = tail->value.load(std::memory_order_acquire);
+      if (h == cached_tail)
+         return(NULL);
+   }
+   return(&q[h & mask]);
+}
+
+template <class T>
+void broadcast_ring_t<T>::release(unsigned c) {
+   heads[c].value.store(heads[c].value.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <class T>
+bool broadcast_ring_t<T>::done(unsigned c) {
+   // finished is set after the last publish(): once it is seen, tail is final.
+   return(finished->load(std::memory_order_acquire) &&
+          (heads[c].value.load(std::memory_order_relaxed) == tail->value.load(std::memory_order_acquire)));
+}
@@ -26,11 +26,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <assert.h>
 #include <inttypes.h>
 #include <stdio.h>
-#include "parameters.h"
 #include "cache.h"
+#include "checkpoint.h"
 
 
-cache_t::cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_t *next_level) {
+cache_t::cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_t *next_level, uint64_t memory_latency) {
    uint64_t num_sets;
 
    assert(IsPow2(blocksize));
@@ -54,12 +54,18 @@ cache_t::cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t lat
 
    this->latency = latency;
    this->next_level = next_level;
+   this->memory_latency = memory_latency;
 
    accesses = 0;
+   pf_accesses = 0;
    misses = 0;
+   pf_misses = 0;
 }
 
 cache_t::~cache_t() {
+   for (uint64_t i = 0; i <= index_mask; i++)
+      delete [] C[i];
+   delete [] C;
 }
 
 bool cache_t::is_hit(uint64_t cycle, uint64_t addr) const {
@@ -118,7 +124,7 @@ uint64_t cache_t::access(uint64_t cycle, bool read, uint64_t addr, bool pf) {
       // TO DO: model writebacks (evictions of dirty blocks)
 
       // determine when the requested block will be available
-      avail = (next_level ? next_level->access((cycle + latency), read, addr, pf) : (cycle + latency + MAIN_MEMORY_LATENCY));
+      avail = (next_level ? next_level->access((cycle + latency), read, addr, pf) : (cycle + latency + memory_latency));
 
       // replace the victim block with the requested block
       C[index][victim_way].valid = true;
@@ -130,6 +136,33 @@ uint64_t cache_t::access(uint64_t cycle, bool read, uint64_t addr, bool pf) {
    return(avail);
 }
 
+void cache_t::warm(uint64_t addr) {
+   uint64_t tag = TAG(addr);
+   uint64_t index = INDEX(addr);
+   uint64_t max_lru_ctr = 0;
+   uint64_t victim_way;
+
+   for (uint64_t way = 0; way < assoc; way++) {
+      if (C[index][way].valid && (C[index][way].tag == tag)) {
+         update_lru(index, way);
+         return;
+      }
+      else if (C[index][way].lru >= max_lru_ctr) {
+         max_lru_ctr = C[index][way].lru;
+         victim_way = way;
+      }
+   }
+
+   if (next_level)
+      next_level->warm(addr);
+
+   // The block is available right away: warming does not model time.
+   C[index][victim_way].valid = true;
+   C[index][victim_way].tag = tag;
+   C[index][victim_way].timestamp = 0;
+   update_lru(index, victim_way);
+}
+
 void cache_t::update_lru(uint64_t index, uint64_t mru_way) {
    for (uint64_t way = 0; way < assoc; way++) {
       if (C[index][way].lru < C[index][mru_way].lru) {
@@ -148,3 +181,17 @@ void cache_t::stats() {
    printf("\tpf misses     = %lu\n", pf_misses);
    printf("\tpf miss ratio = %.2f%%\n", 100.0*((double)pf_misses/(double)pf_accesses));
 }
+
+void cache_t::checkpoint(checkpoint_t &ck) {
+   ck.section("cache");
+   uint64_t num_sets = (index_mask + 1);
+   ck.shape(num_sets, "cache sets");
+   ck.shape(assoc, "cache ways");
+   ck.shape(num_offset_bits, "cache block size (log2)");
+   for (uint64_t i = 0; i < num_sets; i++)
+      ck.bytes(C[i], assoc * sizeof(block_t));
+   ck.io(accesses);
+   ck.io(pf_accesses);
+   ck.io(misses);
+   ck.io(pf_misses);
+}
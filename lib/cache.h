@@ -22,6 +22,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Author: Eric Rotenberg (ericro@ncsu.edu)
 
 
+class checkpoint_t;
+
 struct block_t {
 	bool valid;
 	//bool dirty;	// TO DO
@@ -49,6 +51,9 @@ private:
 	// pointer to next cache level if applicable
 	cache_t *next_level;
 
+	// latency of main memory, past the last level
+	uint64_t memory_latency;
+
 	// measurements
 	uint64_t accesses;
 	uint64_t pf_accesses;
@@ -58,9 +63,12 @@ private:
 	void update_lru(uint64_t index, uint64_t mru_way);
 
 public:
-	cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_t *next_level);
+	cache_t(uint64_t size, uint64_t assoc, uint64_t blocksize, uint64_t latency, cache_t *next_level, uint64_t memory_latency);
 	~cache_t();
 	uint64_t access(uint64_t cycle, bool read, uint64_t addr, bool pf = false);
+	void warm(uint64_t addr);	// functional access: updates tags and LRU (here and below on a miss), no timing or measurements
     bool is_hit(uint64_t cycle, uint64_t addr) const;
 	void stats();
+	uint64_t get_misses() const { return(misses); }	// demand misses so far
+	void checkpoint(checkpoint_t &ck);	// tags, LRU state, block timestamps and measurements (not the next level)
 };
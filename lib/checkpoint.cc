@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <string>
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC	"CVP checkpoint v2"
+
+checkpoint_t::checkpoint_t(FILE *fp, bool restore) : fp(fp), restore(restore) {
+   section(CHECKPOINT_MAGIC);
+   if (!good())
+      error = "not a checkpoint of this simulator version";
+}
+
+void checkpoint_t::fail(const std::string &why) {
+   if (good())
+      error = why;
+}
+
+void checkpoint_t::bytes(void *p, size_t size) {
+   if (!good() || !size)
+      return;
+   if (restore ? (fread(p, 1, size, fp) != size) : (fwrite(p, 1, size, fp) != size))
+      fail(restore ? "truncated checkpoint" : "cannot write checkpoint");
+}
+
+void checkpoint_t::section(const char *name) {
+   char buf[64];
+   size_t size = (strlen(name) + 1);
+   if (size > sizeof(buf)) {
+      fail(std::string("section name too long: ") + name);
+      return;
+   }
+   memcpy(buf, name, size);
+   bytes(buf, size);
+   if (good() && memcmp(buf, name, size))
+      fail(std::string("section ") + name + " not found");
+}
+
+void checkpoint_t::shape(uint64_t n, const char *what) {
+   uint64_t saved = n;
+   io(saved);
+   if (good() && (saved != n))
+      fail(std::string(what) + ": " + std::to_string(n) + " here, " + std::to_string(saved) + " in the checkpoint");
+}
+
+void checkpoint_t::blob(bool (*fn)(FILE *fp), const char *what) {
+   section(what);
+   if (!good())
+      return;
+   int64_t length = 0;
+   long start;
+   if (!restore) {
+      long patch = ftell(fp);
+      io(length);
+      start = ftell(fp);
+      if (fn && !fn(fp)) {
+         fail(std::string("cannot save the ") + what);
+         return;
+      }
+      long end = ftell(fp);
+      length = (end - start);
+      if ((patch < 0) || (end < 0) || fseek(fp, patch, SEEK_SET) || (fwrite(&length, sizeof(length), 1, fp) != 1) || fseek(fp, end, SEEK_SET))
+         fail("cannot write checkpoint");
+   }
+   else {
+      io(length);
+      start = ftell(fp);
+      if (!good() || (start < 0))
+         return;
+      if (fn && length) {
+         if (!fn(fp))
+            fail(std::string("cannot restore the ") + what);
+         else if (ftell(fp) != start + length)
+            fail(std::string("the ") + what + " read " + std::to_string(ftell(fp) - start) + " bytes of its " + std::to_string(length));
+      }
+      if (good() && fseek(fp, start + length, SEEK_SET))
+         fail("truncated checkpoint");
+   }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+// Checkpoints of the simulation state (cvp -K, -L).
+//
+// Every stateful component has a checkpoint(checkpoint_t &ck) member that
+// passes each piece of its state to ck: when saving, ck writes it to the file;
+// when restoring, ck overwrites it from the file. One function describes the
+// layout in both directions, so saving and restoring cannot drift apart.
+//
+// Sizes that come from the configuration (cache geometry, predictor tables)
+// are recorded with shape(): restoring into structures sized differently fails
+// instead of misreading the rest of the file. Everything else in the
+// configuration (latencies, widths, perfect structures) may differ between the
+// saving and the restoring simulator, so that a warmed-up checkpoint can start
+// several configurations.
+//
+// After the first failure, transfers do nothing and good() is false.
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <type_traits>
+
+class checkpoint_t {
+private:
+   FILE *fp;
+   bool restore;
+   std::string error;		// first failure ("" while good)
+
+public:
+   // Starts saving to, or restoring from, fp (positioned at the start of the checkpoint).
+   checkpoint_t(FILE *fp, bool restore);
+
+   bool restoring() const { return(restore); }
+   bool good() const { return(error.empty()); }
+   const char *what() const { return(error.c_str()); }
+   void fail(const std::string &why);
+
+   // Raw bytes.
+   void bytes(void *p, size_t size);
+
+   // A marker that must be found at the same place when restoring.
+   void section(const char *name);
+
+   // A size that must be the same when restoring.
+   void shape(uint64_t n, const char *what);
+
+   template <class T> void io(T &x) {
+      static_assert(std::is_trivially_copyable<T>::value, "only plain data is saved raw");
+      bytes(&x, sizeof(T));
+   }
+
+   template <class T> void array(T *p, uint64_t n, const char *what) {
+      static_assert(std::is_trivially_copyable<T>::value, "only plain data is saved raw");
+      shape(n, what);
+      bytes(p, n * sizeof(T));
+   }
+
+   // Containers are resized to the saved number of elements.
+   template <class T> void io(std::vector<T> &v) {
+      static_assert(std::is_trivially_copyable<T>::value, "only plain data is saved raw");
+      uint64_t n = v.size();
+      io(n);
+      if (restore && good())
+         v.resize(n);
+      bytes(v.data(), v.size() * sizeof(T));
+   }
+
+   template <class T> void io(std::deque<T> &d) {
+      std::vector<T> v(d.begin(), d.end());
+      io(v);
+      if (restore && good())
+         d.assign(v.begin(), v.end());
+   }
+
+   template <class K, class V> void io(std::unordered_map<K, V> &m) {
+      std::vector<K> keys;
+      std::vector<V> values;
+      for (auto &kv : m) {
+         keys.push_back(kv.first);
+         values.push_back(kv.second);
+      }
+      io(keys);
+      io(values);
+      if (restore && good()) {
+         if (keys.size() != values.size()) {
+            fail("corrupt map");
+            return;
+         }
+         m.clear();
+         for (size_t i = 0; i < keys.size(); i++)
+            m[keys[i]] = values[i];
+      }
+   }
+
+   // Opaque state written straight to the file by fn(fp) (e.g., the predictor's), prefixed with its length so that
+   // it can be skipped. On restore, fn (if any) gets a file positioned at the state and must read all of it.
+   void blob(bool (*fn)(FILE *fp), const char *what);
+};
@@ -0,0 +1,525 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <zlib.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "trace_reader.h"
+#include "codec_trace.h"
+
+#define CODEC_PC_TABLE_BITS	14	// static instructions tracked (direct-mapped)
+#define CODEC_VALUE_TABLE_BITS	16	// static instruction value positions tracked (direct-mapped)
+#define CODEC_MAX_REGS		23	// longest register list remembered for CODEC_REGS_HIT
+
+// Prediction state of a static instruction.
+struct codec_pc_entry_t {
+   uint64_t pc;
+   uint64_t epoch;	// entries of an older epoch are empty
+   uint64_t target;	// last taken target
+   uint64_t addr;	// last address
+   uint64_t stride;	// last address stride
+   uint8_t regs_size;	// size of regs (0: not remembered)
+   uint8_t regs[CODEC_MAX_REGS];	// last register bytes: num in, in regs, num out, out regs
+};
+
+// Prediction state of the k-th 64-bit value of a static instruction.
+struct codec_value_entry_t {
+   uint64_t key;
+   uint64_t epoch;
+   uint64_t last;
+   uint64_t stride;
+};
+
+// Prediction state shared by the encoder and the decoder, which must update it identically.
+class codec_model_t {
+private:
+   std::vector<codec_pc_entry_t> pcs;
+   std::vector<codec_value_entry_t> values;
+   uint64_t epoch;
+
+   static inline size_t hash(uint64_t key, unsigned bits) { return (size_t)((key * 0x9E3779B97F4A7C15ull) >> (64 - bits)); }
+
+public:
+   uint64_t next_pc;	// predicted PC of the next record
+
+   codec_model_t() : pcs((size_t)1 << CODEC_PC_TABLE_BITS), values((size_t)1 << CODEC_VALUE_TABLE_BITS), epoch(0), next_pc(0) {
+      memset(pcs.data(), 0, pcs.size() * sizeof(codec_pc_entry_t));
+      memset(values.data(), 0, values.size() * sizeof(codec_value_entry_t));
+   }
+
+   // Forgets everything (at the start of a chunk), without touching the tables.
+   void reset() {
+      epoch++;
+      next_pc = 0;
+   }
+
+   inline codec_pc_entry_t &pc_entry(uint64_t pc) {
+      codec_pc_entry_t &e = pcs[hash(pc, CODEC_PC_TABLE_BITS)];
+      if ((e.pc != pc) || (e.epoch != epoch)) {
+         memset(&e, 0, sizeof(e));
+         e.pc = pc;
+         e.epoch = epoch;
+      }
+      return(e);
+   }
+
+   inline codec_value_entry_t &value_entry(uint64_t pc, unsigned k) {
+      uint64_t key = ((pc << 9) | k);	// k < 2 * 255
+      codec_value_entry_t &e = values[hash(key, CODEC_VALUE_TABLE_BITS)];
+      if ((e.key != key) || (e.epoch != epoch)) {
+         memset(&e, 0, sizeof(e));
+         e.key = key;
+         e.epoch = epoch;
+      }
+      return(e);
+   }
+};
+
+static inline bool is_mem(uint8_t type) {
+   return((type == InstClass::loadInstClass) || (type == InstClass::storeInstClass));
+}
+
+static inline bool is_branch(uint8_t type) {
+   return((type == InstClass::condBranchInstClass) || (type == InstClass::uncondDirectBranchInstClass) || (type == InstClass::uncondIndirectBranchInstClass));
+}
+
+// Number of 64-bit values of an output register.
+static inline unsigned num_values(uint8_t reg) {
+   return(((reg >= Offset::vecOffset) && (reg != Offset::ccOffset)) ? 2 : 1);
+}
+
+static inline uint64_t get_u64(const uint8_t *p) {
+   uint64_t value;
+   memcpy(&value, p, sizeof(value));
+   return(value);
+}
+
+static inline uint64_t zigzag(uint64_t delta) {
+   return((delta << 1) ^ (uint64_t)((int64_t)delta >> 63));
+}
+
+static inline uint64_t unzigzag(uint64_t z) {
+   return((z >> 1) ^ (uint64_t)-(int64_t)(z & 1));
+}
+
+static inline void put_varint(std::vector<uint8_t> &s, uint64_t value) {
+   while (value >= 0x80) {
+      s.push_back((uint8_t)(value | 0x80));
+      value >>= 7;
+   }
+   s.push_back((uint8_t)value);
+}
+
+// Sequential reader of a decoded stream. Reading past the end yields zeros and marks the stream bad.
+struct codec_stream_reader_t {
+   const uint8_t *p;
+   const uint8_t *end;
+   bool bad;
+
+   void init(const std::vector<uint8_t> &s) { p = s.data(); end = p + s.size(); bad = false; }
+
+   inline uint8_t get() {
+      if (p == end) {
+         bad = true;
+         return(0);
+      }
+      return(*p++);
+   }
+
+   inline uint64_t get_varint() {
+      uint64_t value = 0;
+      for (unsigned shift = 0; shift < 64; shift += 7) {
+         uint8_t b = get();
+         value |= ((uint64_t)(b & 0x7f) << shift);
+         if (!(b & 0x80))
+            return(value);
+      }
+      bad = true;
+      return(value);
+   }
+
+   inline void get_bytes(uint8_t *out, size_t n) {
+      if ((size_t)(end - p) < n) {
+         bad = true;
+         memset(out, 0, n);
+         return;
+      }
+      memcpy(out, p, n);
+      p += n;
+   }
+};
+
+// Appends the residuals of one CVP-1 record (of "size" bytes) to the streams.
+// Returns false if the record cannot be coded (its bytes would not be rebuilt exactly).
+static bool codec_encode(codec_model_t &m, const uint8_t *p, size_t size, std::vector<uint8_t> *s) {
+   const uint8_t *q = p;
+   uint64_t pc = get_u64(q);
+   uint8_t type = q[8];
+   q += 9;
+   if (type >= InstClass::undefInstClass)
+      return(false);
+
+   uint8_t tbyte = type;
+   uint8_t hits = 0;
+   if (pc == m.next_pc)
+      hits |= CODEC_PC_HIT;
+   else
+      put_varint(s[CODEC_PC], zigzag(pc - m.next_pc));
+
+   codec_pc_entry_t &e = m.pc_entry(pc);
+   if (is_mem(type)) {
+      uint64_t addr = get_u64(q);
+      if (addr == e.addr + e.stride)
+         hits |= CODEC_ADDR_HIT;
+      else
+         put_varint(s[CODEC_ADDR], zigzag(addr - e.addr));
+      e.stride = addr - e.addr;
+      e.addr = addr;
+      s[CODEC_SIZE].push_back(q[8]);
+      q += 9;
+   }
+
+   uint64_t next_pc = pc + 4;
+   if (is_branch(type)) {
+      uint8_t taken = *q++;
+      if (taken > 1)
+         return(false);
+      if (taken) {
+         uint64_t target = get_u64(q);
+         q += 8;
+         tbyte |= CODEC_TAKEN;
+         if (target == e.target)
+            hits |= CODEC_TARGET_HIT;
+         else
+            put_varint(s[CODEC_TARGET], zigzag(target - pc));
+         e.target = target;
+         next_pc = target;
+      }
+   }
+
+   const uint8_t *regs = q;
+   uint8_t num_in = regs[0];
+   uint8_t num_out = regs[1 + num_in];
+   const uint8_t *out_regs = regs + 2 + num_in;
+   size_t regs_size = 2 + num_in + num_out;
+   if ((regs_size == e.regs_size) && !memcmp(regs, e.regs, regs_size)) {
+      hits |= CODEC_REGS_HIT;
+   }
+   else {
+      s[CODEC_REGS].insert(s[CODEC_REGS].end(), regs, regs + regs_size);
+      e.regs_size = ((regs_size <= CODEC_MAX_REGS) ? regs_size : 0);
+      memcpy(e.regs, regs, e.regs_size);
+   }
+   q += regs_size;
+
+   unsigned k = 0;
+   for (unsigned i = 0; i < num_out; i++) {
+      for (unsigned j = 0; j < num_values(out_regs[i]); j++) {
+         uint64_t value = get_u64(q);
+         q += 8;
+         codec_value_entry_t &v = m.value_entry(pc, k++);
+         if (value == v.last) {
+            s[CODEC_VCODE].push_back(CODEC_VALUE_LAST);
+         }
+         else if (value == v.last + v.stride) {
+            s[CODEC_VCODE].push_back(CODEC_VALUE_STRIDE);
+         }
+         else {
+            s[CODEC_VCODE].push_back(CODEC_VALUE_DELTA);
+            put_varint(s[CODEC_VALUES], zigzag(value - v.last));
+         }
+         v.stride = value - v.last;
+         v.last = value;
+      }
+   }
+
+   s[CODEC_TYPE].push_back(tbyte);
+   s[CODEC_HITS].push_back(hits);
+   m.next_pc = next_pc;
+   return((size_t)(q - p) == size);
+}
+
+// Rebuilds one CVP-1 record at out from the streams. Returns its size.
+static size_t codec_decode(codec_model_t &m, codec_stream_reader_t *s, uint8_t *out) {
+   uint8_t *q = out;
+   uint8_t tbyte = s[CODEC_TYPE].get();
+   uint8_t hits = s[CODEC_HITS].get();
+   uint8_t type = (tbyte & 0xf);
+
+   uint64_t pc = m.next_pc;
+   if (!(hits & CODEC_PC_HIT))
+      pc += unzigzag(s[CODEC_PC].get_varint());
+   memcpy(q, &pc, 8);
+   q[8] = type;
+   q += 9;
+
+   codec_pc_entry_t &e = m.pc_entry(pc);
+   if (is_mem(type)) {
+      uint64_t addr = e.addr + ((hits & CODEC_ADDR_HIT) ? e.stride : unzigzag(s[CODEC_ADDR].get_varint()));
+      e.stride = addr - e.addr;
+      e.addr = addr;
+      memcpy(q, &addr, 8);
+      q[8] = s[CODEC_SIZE].get();
+      q += 9;
+   }
+
+   uint64_t next_pc = pc + 4;
+   if (is_branch(type)) {
+      bool taken = (tbyte & CODEC_TAKEN);
+      *q++ = taken;
+      if (taken) {
+         uint64_t target = ((hits & CODEC_TARGET_HIT) ? e.target : (pc + unzigzag(s[CODEC_TARGET].get_varint())));
+         memcpy(q, &target, 8);
+         q += 8;
+         e.target = target;
+         next_pc = target;
+      }
+   }
+
+   uint8_t *regs = q;
+   size_t regs_size;
+   if (hits & CODEC_REGS_HIT) {
+      regs_size = e.regs_size;
+      if (regs_size == 0) {
+         s[CODEC_REGS].bad = true;
+         return(0);
+      }
+      memcpy(regs, e.regs, regs_size);
+   }
+   else {
+      regs[0] = s[CODEC_REGS].get();
+      s[CODEC_REGS].get_bytes(regs + 1, regs[0]);
+      regs[1 + regs[0]] = s[CODEC_REGS].get();
+      s[CODEC_REGS].get_bytes(regs + 2 + regs[0], regs[1 + regs[0]]);
+      regs_size = 2 + regs[0] + regs[1 + regs[0]];
+      e.regs_size = ((regs_size <= CODEC_MAX_REGS) ? regs_size : 0);
+      memcpy(e.regs, regs, e.regs_size);
+   }
+   uint8_t num_out = regs[1 + regs[0]];
+   const uint8_t *out_regs = regs + 2 + regs[0];
+   q += regs_size;
+
+   unsigned k = 0;
+   for (unsigned i = 0; i < num_out; i++) {
+      for (unsigned j = 0; j < num_values(out_regs[i]); j++) {
+         codec_value_entry_t &v = m.value_entry(pc, k++);
+         uint64_t value;
+         switch (s[CODEC_VCODE].get()) {
+            case CODEC_VALUE_LAST:	value = v.last; break;
+            case CODEC_VALUE_STRIDE:	value = v.last + v.stride; break;
+            default:			value = v.last + unzigzag(s[CODEC_VALUES].get_varint()); break;
+         }
+         v.stride = value - v.last;
+         v.last = value;
+         memcpy(q, &value, 8);
+         q += 8;
+      }
+   }
+
+   m.next_pc = next_pc;
+   return((size_t)(q - out));
+}
+
+bool is_codec_trace(const char *name) {
+   char magic[sizeof(((codec_trace_header_t *)0)->magic)];
+   FILE *fp = fopen(name, "rb");
+   if (!fp)
+      return(false);
+   bool codec = ((fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) && !memcmp(magic, CODEC_TRACE_MAGIC, sizeof(magic)));
+   fclose(fp);
+   return(codec);
+}
+
+bool codec_trace_pack(const char *in_name, const char *out_name, int level) {
+   trace_input_t *input = open_trace_input(in_name);
+   if (!input)
+      return(false);
+   FILE *fp = fopen(out_name, "wb");
+   if (!fp) {
+      delete input;
+      return(false);
+   }
+
+   codec_trace_header_t header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, CODEC_TRACE_MAGIC, sizeof(header.magic));
+   header.version = CODEC_TRACE_VERSION;
+   header.num_streams = NUM_CODEC_STREAMS;
+   bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);	// written again once complete
+
+   codec_model_t *model = new codec_model_t();
+   std::vector<codec_chunk_entry_t> table;
+   std::vector<uint8_t> streams[NUM_CODEC_STREAMS];
+   std::vector<uint8_t> packed;
+   codec_chunk_entry_t chunk;
+   memset(&chunk, 0, sizeof(chunk));
+   uint64_t offset = sizeof(header);
+
+   while (ok) {
+      size_t avail = input->ensure(MAX_TRACE_INPUT_NEED);
+      size_t size = CVPTraceReader::recordSize(input->data(), avail);
+      if (size != 0) {
+         if (chunk.num_records == 0) {
+            model->reset();
+            chunk.first_instr = header.num_instr;
+         }
+         if (!codec_encode(*model, input->data(), size, streams)) {
+            fprintf(stderr, "Trace record %" PRIu64 " cannot be coded\n", header.num_instr);
+            ok = false;
+            break;
+         }
+         input->consume(size);
+         chunk.num_records++;
+         chunk.size += size;
+         header.num_instr++;
+      }
+
+      // Compress the streams of a full chunk, or of the last one (a truncated last record is dropped).
+      if ((chunk.num_records == CODEC_CHUNK_RECORDS) || ((size == 0) && (chunk.num_records != 0))) {
+         for (unsigned i = 0; i < NUM_CODEC_STREAMS; i++) {
+            uLongf packed_size = compressBound(streams[i].size());
+            packed.resize(packed_size);
+            ok = ok && (compress2(packed.data(), &packed_size, streams[i].data(), streams[i].size(), level) == Z_OK);
+            ok = ok && (fwrite(packed.data(), 1, packed_size, fp) == packed_size);
+            chunk.streams[i].offset = offset;
+            chunk.streams[i].compressed_size = packed_size;
+            chunk.streams[i].size = streams[i].size();
+            offset += packed_size;
+            streams[i].clear();
+         }
+         header.max_chunk_size = std::max(header.max_chunk_size, (uint64_t)chunk.size);
+         table.push_back(chunk);
+         memset(&chunk, 0, sizeof(chunk));
+      }
+      if (size == 0)
+         break;
+   }
+
+   delete model;
+   delete input;
+
+   header.num_chunks = table.size();
+   header.table_offset = offset;
+   ok = ok && (fwrite(table.data(), sizeof(codec_chunk_entry_t), table.size(), fp) == table.size());
+   ok = ok && !fseek(fp, 0, SEEK_SET) && (fwrite(&header, sizeof(header), 1, fp) == 1);
+   return((fclose(fp) == 0) && ok);
+}
+
+codec_input_t::codec_input_t(const char *name) {
+   codec_trace_header_t header;
+   fd = open(name, O_RDONLY);
+   if (fd < 0) {
+      fprintf(stderr, "Cannot open trace %s\n", name);
+      exit(1);
+   }
+   if ((pread(fd, &header, sizeof(header), 0) != sizeof(header)) ||
+       memcmp(header.magic, CODEC_TRACE_MAGIC, sizeof(header.magic)) ||
+       (header.version != CODEC_TRACE_VERSION) ||
+       (header.num_streams != NUM_CODEC_STREAMS)) {
+      fprintf(stderr, "Invalid codec trace %s\n", name);
+      exit(1);
+   }
+   table.resize(header.num_chunks);
+   size_t table_size = header.num_chunks * sizeof(codec_chunk_entry_t);
+   if (pread(fd, table.data(), table_size, header.table_offset) != (ssize_t)table_size) {
+      fprintf(stderr, "Truncated codec trace %s\n", name);
+      exit(1);
+   }
+
+   uint64_t total = 0;
+   for (auto &e : table) {
+      if (e.size > header.max_chunk_size) {
+         fprintf(stderr, "Invalid codec trace %s\n", name);
+         exit(1);
+      }
+      chunk_out_offset.push_back(total);
+      total += e.size;
+   }
+   out_size = total;
+
+   // A corrupt chunk may decode to up to one record more than its size before decoding stops.
+   buf = new uint8_t[MAX_TRACE_INPUT_NEED + header.max_chunk_size + CVPTraceReader::cMaxRecordBytes];
+   model = new codec_model_t();
+   next_chunk = 0;
+   out_offset = 0;
+   cur = end = chunk_start = buf + MAX_TRACE_INPUT_NEED;
+}
+
+codec_input_t::~codec_input_t() {
+   delete model;
+   delete [] buf;
+   close(fd);
+}
+
+bool codec_input_t::decode_chunk(uint64_t c, uint8_t *out) {
+   const codec_chunk_entry_t &e = table[c];
+   codec_stream_reader_t s[NUM_CODEC_STREAMS];
+   for (unsigned i = 0; i < NUM_CODEC_STREAMS; i++) {
+      const codec_stream_entry_t &se = e.streams[i];
+      in.resize(se.compressed_size);
+      streams[i].resize(se.size);
+      uLongf size = se.size;
+      if ((pread(fd, in.data(), se.compressed_size, se.offset) != (ssize_t)se.compressed_size) ||
+          (uncompress(streams[i].data(), &size, in.data(), se.compressed_size) != Z_OK) || (size != se.size))
+         return(false);
+      s[i].init(streams[i]);
+   }
+
+   model->reset();
+   size_t size = 0;
+   for (uint32_t r = 0; (r < e.num_records) && (size <= e.size); r++)
+      size += codec_decode(*model, s, out + size);
+
+   // Every stream must be used up exactly.
+   bool ok = (size == e.size);
+   for (unsigned i = 0; i < NUM_CODEC_STREAMS; i++)
+      ok = ok && !s[i].bad && (s[i].p == s[i].end);
+   return(ok);
+}
+
+size_t codec_input_t::refill(size_t need) {
+   assert(need <= MAX_TRACE_INPUT_NEED);
+   size_t left = (size_t)(end - cur);
+   if (next_chunk >= table.size())
+      return(left);
+
+   // Copy the unconsumed tail of the previous chunk in front of the next one.
+   uint8_t *start = buf + MAX_TRACE_INPUT_NEED;
+   memmove(start - left, cur, left);
+   cur = start - left;
+   chunk_start = start;
+   out_offset = chunk_out_offset[next_chunk];
+   if (!decode_chunk(next_chunk, start)) {
+      fprintf(stderr, "Corrupt chunk %" PRIu64 " in codec trace, the trace ends there\n", next_chunk);
+      end = start;
+      next_chunk = table.size();
+      return(left);
+   }
+   end = start + table[next_chunk].size;
+   next_chunk++;
+   return((size_t)(end - cur));
+}
+
+uint64_t codec_input_t::seek_record(uint64_t instr, uint64_t current) {
+   if (table.empty())
+      return(current);
+
+   // Last chunk starting at or before "instr".
+   auto it = std::upper_bound(table.begin(), table.end(), instr,
+                              [](uint64_t i, const codec_chunk_entry_t &e) { return i < e.first_instr; });
+   uint64_t c = ((it == table.begin()) ? 0 : (it - table.begin() - 1));
+
+   // Decode forward if the current position is already in or after that chunk.
+   if ((instr >= current) && (table[c].first_instr <= current))
+      return(current);
+
+   next_chunk = c;
+   out_offset = chunk_out_offset[c];
+   cur = end = chunk_start = buf + MAX_TRACE_INPUT_NEED;
+   return(table[c].first_instr);
+}
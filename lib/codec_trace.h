@@ -0,0 +1,125 @@
+#pragma once
+
+// Model-coded trace format: CVP-1 records stored as prediction residuals.
+//
+// gzip finds little to share between successive CVP-1 records: a record is
+// mostly 64-bit PCs, addresses and values that differ from the previous
+// record. They are very predictable from the program's own behavior, though:
+// the PC is usually the previous record's fall-through or taken target, a
+// static load/store usually strides from its previous address, and a
+// destination value often repeats or strides from the last value the same
+// static instruction produced. A codec trace keeps, per static instruction, the
+// last target, address, stride, registers and values, and stores only whether
+// each prediction hit and, if not, a small delta. The residuals of each chunk of
+// CODEC_CHUNK_RECORDS records are split into streams of like fields that are
+// deflated separately.
+//
+// Decoding rebuilds the CVP-1 records byte for byte, so CVPTraceReader (and
+// every tool that copies records) reads a codec trace like the trace it was
+// converted from. Chunks reset the prediction state, so they can be decoded
+// independently, which gives random access at chunk granularity. Use
+// cvp-convert -f codec to produce codec traces.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+#include "trace_input.h"
+
+#define CODEC_TRACE_MAGIC	"CVPCODEC"
+#define CODEC_TRACE_VERSION	1
+#define CODEC_CHUNK_RECORDS	(1 << 18)
+
+// Streams, in the order they are stored in a chunk.
+enum codec_stream_t {
+   CODEC_TYPE,		// uint8_t per record: instruction class and CODEC_* record flags
+   CODEC_HITS,		// uint8_t per record: CODEC_*_HIT prediction flags
+   CODEC_PC,		// varint: PC - predicted PC, for records without CODEC_PC_HIT
+   CODEC_TARGET,	// varint: target - PC, for taken branches without CODEC_TARGET_HIT
+   CODEC_ADDR,		// varint: address - last address, for loads/stores without CODEC_ADDR_HIT
+   CODEC_SIZE,		// uint8_t access size, for loads/stores
+   CODEC_REGS,		// register bytes of the record, for records without CODEC_REGS_HIT
+   CODEC_VCODE,		// uint8_t codec_value_t per 64-bit value
+   CODEC_VALUES,	// varint: value - last value, for CODEC_VALUE_DELTA values
+   NUM_CODEC_STREAMS
+};
+
+// CODEC_TYPE flags (the instruction class is in the low 4 bits).
+#define CODEC_TAKEN		(1 << 4)	// taken branch
+
+// CODEC_HITS flags.
+#define CODEC_PC_HIT		(1 << 0)	// PC is the previous record's next PC
+#define CODEC_TARGET_HIT	(1 << 1)	// taken target is the static branch's last taken target
+#define CODEC_ADDR_HIT		(1 << 2)	// address is the static load/store's last address plus its last stride
+#define CODEC_REGS_HIT		(1 << 3)	// registers are the static instruction's last registers
+
+// How a 64-bit value is coded (CODEC_VCODE), relative to the last value in the same position of the same static instruction.
+enum codec_value_t {
+   CODEC_VALUE_LAST,		// same as the last value
+   CODEC_VALUE_STRIDE,		// last value plus the last stride
+   CODEC_VALUE_DELTA		// delta in CODEC_VALUES
+};
+
+struct codec_trace_header_t {
+   char magic[8];		// CODEC_TRACE_MAGIC, not null-terminated
+   uint32_t version;		// CODEC_TRACE_VERSION
+   uint32_t num_streams;	// NUM_CODEC_STREAMS
+   uint64_t num_chunks;
+   uint64_t num_instr;		// trace records in all chunks
+   uint64_t table_offset;	// file offset of the chunk table
+   uint64_t max_chunk_size;	// largest decoded chunk, in CVP-1 record bytes
+   uint8_t reserved[16];
+};
+
+static_assert(sizeof(codec_trace_header_t) == 64, "codec trace header layout changed");
+
+struct codec_stream_entry_t {
+   uint64_t offset;		// file offset of the compressed stream
+   uint32_t compressed_size;
+   uint32_t size;		// uncompressed size
+};
+
+struct codec_chunk_entry_t {
+   uint64_t first_instr;	// trace instruction number of the chunk's first record
+   uint32_t num_records;
+   uint32_t size;		// decoded size, in CVP-1 record bytes
+   codec_stream_entry_t streams[NUM_CODEC_STREAMS];
+};
+
+// Returns true if the file starts with the codec trace magic.
+bool is_codec_trace(const char *name);
+
+// Converts a CVP-1 trace (any format open_trace_input() reads) into a codec trace.
+bool codec_trace_pack(const char *in_name, const char *out_name, int level = 6);
+
+class codec_model_t;
+
+// Decodes a codec trace chunk by chunk into CVP-1 records.
+class codec_input_t : public trace_input_t {
+private:
+   int fd;
+   std::vector<codec_chunk_entry_t> table;
+   std::vector<uint64_t> chunk_out_offset;	// decoded offset of each chunk
+   uint64_t out_size;				// decoded size of the trace
+   codec_model_t *model;
+
+   std::vector<uint8_t> in;			// compressed stream
+   std::vector<uint8_t> streams[NUM_CODEC_STREAMS];
+   uint8_t *buf;		// MAX_TRACE_INPUT_NEED bytes for the unconsumed tail of the previous chunk, then a chunk
+   uint64_t next_chunk;
+   uint64_t out_offset;		// decoded offset of chunk_start
+   const uint8_t *chunk_start;	// start of the current chunk's own bytes (data() may be before it)
+
+   // Decodes chunk c into out (table[c].size bytes). Returns false if the chunk is corrupt.
+   bool decode_chunk(uint64_t c, uint8_t *out);
+
+protected:
+   size_t refill(size_t need);
+
+public:
+   codec_input_t(const char *name);
+   ~codec_input_t();
+
+   uint64_t offset() const { return (out_offset + (cur - chunk_start)); }
+   double fraction_read() const { return (out_size ? ((double)offset() / out_size) : 1.0); }
+   uint64_t seek_record(uint64_t instr, uint64_t current);
+};
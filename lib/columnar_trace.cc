@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <zlib.h>
+#include "columnar_trace.h"
+
+// Bytes per micro-op of each column (for the sparse columns, per micro-op present in the column).
+static const uint32_t column_width[NUM_COLUMNS] = {8, 8, 3, 12, 4, 8};
+
+// Columns needed for each TRACE_FIELD_* bit; COLUMN_INFO is always read.
+static unsigned column_fields(unsigned col) {
+   switch (col) {
+      case COLUMN_PC:		return(TRACE_FIELD_PC | TRACE_FIELD_NEXT_PC);	// next_pc is usually pc + 4
+      case COLUMN_NEXT_PC:	return(TRACE_FIELD_NEXT_PC);
+      case COLUMN_MEM:		return(TRACE_FIELD_MEM);
+      case COLUMN_REGS:		return(TRACE_FIELD_REGS);
+      case COLUMN_VALUES:	return(TRACE_FIELD_VALUES);
+      default:			return(TRACE_FIELDS_ALL);
+   }
+}
+
+template <class T>
+static inline T column_get(const uint8_t *p) {
+   T value;
+   memcpy(&value, p, sizeof(value));
+   return(value);
+}
+
+template <class T>
+static inline void column_put(std::vector<uint8_t> &column, T value) {
+   const uint8_t *p = (const uint8_t *)&value;
+   column.insert(column.end(), p, p + sizeof(value));
+}
+
+bool is_columnar_trace(const char *name) {
+   char magic[sizeof(((columnar_trace_header_t *)0)->magic)];
+   FILE *fp = fopen(name, "rb");
+   if (!fp)
+      return(false);
+   bool columnar = ((fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) && !memcmp(magic, COLUMNAR_TRACE_MAGIC, sizeof(magic)));
+   fclose(fp);
+   return(columnar);
+}
+
+columnar_trace_reader_t::columnar_trace_reader_t(const char *name, unsigned fields) {
+   columnar_trace_header_t header;
+   fd = open(name, O_RDONLY);
+   if (fd < 0) {
+      fprintf(stderr, "Cannot open trace %s\n", name);
+      exit(1);
+   }
+   if ((pread(fd, &header, sizeof(header), 0) != sizeof(header)) ||
+       memcmp(header.magic, COLUMNAR_TRACE_MAGIC, sizeof(header.magic)) ||
+       (header.version != COLUMNAR_TRACE_VERSION) ||
+       (header.num_columns != NUM_COLUMNS)) {
+      fprintf(stderr, "Invalid columnar trace %s\n", name);
+      exit(1);
+   }
+   table.resize(header.num_chunks);
+   size_t table_size = header.num_chunks * sizeof(columnar_chunk_entry_t);
+   if (pread(fd, table.data(), table_size, header.table_offset) != (ssize_t)table_size) {
+      fprintf(stderr, "Truncated columnar trace %s\n", name);
+      exit(1);
+   }
+
+   for (unsigned col = 0; col < NUM_COLUMNS; col++)
+      load[col] = ((column_fields(col) & fields) != 0);
+
+   total_uops = header.num_uops;
+   uops_before = 0;
+   nInstr = 0;
+   chunk = 0;
+   next = 0;
+   num_uops = 0;
+   if (!table.empty())
+      load_chunk(0);
+}
+
+columnar_trace_reader_t::~columnar_trace_reader_t() {
+   close(fd);
+
+   std::cout  << " Read " << nInstr << " instrs " << std::endl;
+}
+
+bool columnar_trace_reader_t::load_chunk(uint64_t c) {
+   const columnar_chunk_entry_t &e = table[c];
+   if (c == chunk + 1) {
+      uops_before += num_uops;
+   }
+   else {
+      uops_before = 0;
+      for (uint64_t i = 0; i < c; i++)
+         uops_before += table[i].num_uops;
+   }
+   chunk = c;
+   next = 0;
+   num_uops = 0;
+
+   for (unsigned col = 0; col < NUM_COLUMNS; col++) {
+      const columnar_column_entry_t &ce = e.columns[col];
+      if (!load[col]) {
+         data[col].clear();
+         continue;
+      }
+      in.resize(ce.compressed_size);
+      data[col].resize(ce.size);
+      uLongf size = ce.size;
+      if ((pread(fd, in.data(), ce.compressed_size, ce.offset) != (ssize_t)ce.compressed_size) ||
+          (uncompress(data[col].data(), &size, in.data(), ce.compressed_size) != Z_OK) || (size != ce.size)) {
+         fprintf(stderr, "Corrupt chunk %" PRIu64 " in columnar trace, the trace ends there\n", c);
+         return(false);
+      }
+   }
+
+   next_pc = data[COLUMN_NEXT_PC].data();
+   mem = data[COLUMN_MEM].data();
+   values = data[COLUMN_VALUES].data();
+   num_uops = e.num_uops;
+   return(true);
+}
+
+void columnar_trace_reader_t::decode(db_t *inst) {
+   native_uop_t u;
+   memset(&u, 0, sizeof(u));
+   const uint8_t *info = &data[COLUMN_INFO][next * column_width[COLUMN_INFO]];
+   u.insn = info[0];
+   uint16_t flags = column_get<uint16_t>(info + 1);
+   u.flags = (flags & ~COLUMNAR_NEXT_PC);
+
+   if (load[COLUMN_PC])
+      u.pc = column_get<uint64_t>(&data[COLUMN_PC][next * column_width[COLUMN_PC]]);
+   if (load[COLUMN_NEXT_PC]) {
+      if (flags & COLUMNAR_NEXT_PC) {
+         u.next_pc = column_get<uint64_t>(next_pc);
+         next_pc += column_width[COLUMN_NEXT_PC];
+      }
+      else {
+         u.next_pc = u.pc + 4;
+      }
+   }
+   if (load[COLUMN_REGS])
+      memcpy(u.reg, &data[COLUMN_REGS][next * column_width[COLUMN_REGS]], sizeof(u.reg));
+   if (load[COLUMN_MEM] && (u.flags & (NATIVE_IS_LOAD | NATIVE_IS_STORE))) {
+      u.addr = column_get<uint64_t>(mem);
+      u.size = column_get<uint32_t>(mem + 8);
+      mem += column_width[COLUMN_MEM];
+   }
+   if (load[COLUMN_VALUES] && (u.flags & NATIVE_D_VALID)) {
+      u.value = column_get<uint64_t>(values);
+      values += column_width[COLUMN_VALUES];
+   }
+
+   native_decode(u, inst);
+   nInstr += ((u.flags & NATIVE_FIRST_PIECE) ? 1 : 0);
+   next++;
+}
+
+size_t columnar_trace_reader_t::get_batch(db_t *out, size_t max) {
+   size_t n = 0;
+   while (n < max) {
+      if ((next == num_uops) && ((chunk + 1 >= table.size()) || !load_chunk(chunk + 1)))
+         break;
+      decode(&out[n++]);
+   }
+   return(n);
+}
+
+db_t *columnar_trace_reader_t::get_inst() {
+   db_t *inst = new db_t();
+   if (get_batch(inst, 1))
+      return(inst);
+   delete inst;
+   return(nullptr);
+}
+
+bool columnar_trace_reader_t::seek(uint64_t instr) {
+   if (table.empty())
+      return(instr == 0);
+
+   // Last chunk that starts at or before the first micro-op of trace instruction "instr".
+   auto it = std::upper_bound(table.begin(), table.end(), instr,
+                              [](uint64_t i, const columnar_chunk_entry_t &e) { return i < e.first_instr; });
+   uint64_t c = ((it == table.begin()) ? 0 : (it - table.begin() - 1));
+   if ((c != chunk) || (instr < nInstr)) {
+      if (!load_chunk(c))
+         return(false);
+      nInstr = table[c].first_instr;
+   }
+
+   // Stop at the first piece of trace instruction "instr", i.e., after "instr" first pieces.
+   db_t skipped;
+   while (true) {
+      if ((next == num_uops) && ((chunk + 1 >= table.size()) || !load_chunk(chunk + 1)))
+         return(nInstr == instr);
+      uint16_t flags = column_get<uint16_t>(&data[COLUMN_INFO][next * column_width[COLUMN_INFO] + 1]);
+      if ((flags & NATIVE_FIRST_PIECE) && (nInstr == instr))
+         return(true);
+      decode(&skipped);
+   }
+}
+
+columnar_trace_writer_t::columnar_trace_writer_t(const char *name, int level) : level(level) {
+   fp = fopen(name, "wb");
+   if (!fp) {
+      fprintf(stderr, "Cannot create columnar trace %s\n", name);
+      exit(1);
+   }
+
+   // Written again with the final counts when the trace is complete.
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, COLUMNAR_TRACE_MAGIC, sizeof(header.magic));
+   header.version = COLUMNAR_TRACE_VERSION;
+   header.num_columns = NUM_COLUMNS;
+   ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+   offset = sizeof(header);
+
+   memset(&chunk, 0, sizeof(chunk));
+}
+
+columnar_trace_writer_t::~columnar_trace_writer_t() {
+   flush();
+   header.num_chunks = table.size();
+   header.table_offset = offset;
+   ok = ok && (fwrite(table.data(), sizeof(columnar_chunk_entry_t), table.size(), fp) == table.size());
+   ok = ok && !fseek(fp, 0, SEEK_SET) && (fwrite(&header, sizeof(header), 1, fp) == 1);
+   if (fclose(fp) || !ok)
+      fprintf(stderr, "Error writing columnar trace\n");
+}
+
+void columnar_trace_writer_t::write(const db_t *inst, bool first_piece) {
+   if (chunk.num_uops == 0)
+      chunk.first_instr = header.num_instr;
+
+   native_uop_t u;
+   native_encode(inst, first_piece, u);
+   assert(!(u.flags & COLUMNAR_NEXT_PC));
+   if (u.next_pc != u.pc + 4) {
+      u.flags |= COLUMNAR_NEXT_PC;
+      column_put<uint64_t>(data[COLUMN_NEXT_PC], u.next_pc);
+   }
+   column_put<uint64_t>(data[COLUMN_PC], u.pc);
+   column_put<uint8_t>(data[COLUMN_INFO], u.insn);
+   column_put<uint16_t>(data[COLUMN_INFO], u.flags);
+   if (u.flags & (NATIVE_IS_LOAD | NATIVE_IS_STORE)) {
+      column_put<uint64_t>(data[COLUMN_MEM], u.addr);
+      column_put<uint32_t>(data[COLUMN_MEM], u.size);
+   }
+   data[COLUMN_REGS].insert(data[COLUMN_REGS].end(), u.reg, u.reg + sizeof(u.reg));
+   if (u.flags & NATIVE_D_VALID)
+      column_put<uint64_t>(data[COLUMN_VALUES], u.value);
+
+   header.num_uops++;
+   header.num_instr += (first_piece ? 1 : 0);
+   if (++chunk.num_uops == COLUMNAR_CHUNK_UOPS)
+      flush();
+}
+
+void columnar_trace_writer_t::flush() {
+   if (chunk.num_uops == 0)
+      return;
+
+   std::vector<uint8_t> packed;
+   for (unsigned col = 0; col < NUM_COLUMNS; col++) {
+      uLongf size = compressBound(data[col].size());
+      packed.resize(size);
+      ok = ok && (compress2(packed.data(), &size, data[col].data(), data[col].size(), level) == Z_OK);
+      ok = ok && (fwrite(packed.data(), 1, size, fp) == size);
+      chunk.columns[col].offset = offset;
+      chunk.columns[col].compressed_size = size;
+      chunk.columns[col].size = data[col].size();
+      offset += size;
+      data[col].clear();
+   }
+   table.push_back(chunk);
+   memset(&chunk, 0, sizeof(chunk));
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+// Columnar trace format: cracked micro-ops stored field by field.
+//
+// Like a native trace, a columnar trace holds already-cracked micro-ops, but
+// each group of COLUMNAR_CHUNK_UOPS micro-ops (a chunk) is stored as separate
+// zlib-compressed columns: PCs, next PCs, types and flags, memory accesses
+// (loads and stores only), register names, and destination values (micro-ops
+// with a destination only). A reader given a field mask (trace_options_t::fields)
+// neither reads nor inflates the columns it does not need; e.g., simulations
+// without value prediction skip the values, which are most of the trace.
+// Fields that are not read are zero in the micro-ops returned. Use
+// cvp-convert -f columnar to produce columnar traces.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+#include "native_trace.h"
+#include "trace_reader.h"
+
+#define COLUMNAR_TRACE_MAGIC	"CVPCOLMN"
+#define COLUMNAR_TRACE_VERSION	1
+#define COLUMNAR_CHUNK_UOPS	(1 << 16)
+
+// Columns, in the order they are stored in a chunk.
+enum columnar_column_t {
+   COLUMN_PC,		// uint64_t pc
+   COLUMN_NEXT_PC,	// uint64_t next_pc, for micro-ops with COLUMNAR_NEXT_PC only (others: pc + 4)
+   COLUMN_INFO,		// uint8_t insn, uint16_t native_uop_t flags
+   COLUMN_MEM,		// uint64_t addr, uint32_t size, for loads and stores only
+   COLUMN_REGS,		// uint8_t log_reg of A, B, C, D
+   COLUMN_VALUES,	// uint64_t D.value, for micro-ops with a valid D only
+   NUM_COLUMNS
+};
+
+// Column flag, in addition to the native_uop_t flags: next_pc is not pc + 4 and is in COLUMN_NEXT_PC.
+#define COLUMNAR_NEXT_PC	(1 << 15)
+
+struct columnar_trace_header_t {
+   char magic[8];		// COLUMNAR_TRACE_MAGIC, not null-terminated
+   uint32_t version;		// COLUMNAR_TRACE_VERSION
+   uint32_t num_columns;	// NUM_COLUMNS
+   uint64_t num_chunks;
+   uint64_t num_uops;
+   uint64_t num_instr;
+   uint64_t table_offset;	// file offset of the chunk table
+   uint8_t reserved[16];
+};
+
+static_assert(sizeof(columnar_trace_header_t) == 64, "columnar trace header layout changed");
+
+struct columnar_column_entry_t {
+   uint64_t offset;		// file offset of the compressed column
+   uint32_t compressed_size;
+   uint32_t size;		// uncompressed size
+};
+
+struct columnar_chunk_entry_t {
+   uint64_t first_instr;	// trace instruction number of the chunk's first micro-op
+   uint32_t num_uops;
+   uint32_t reserved;
+   columnar_column_entry_t columns[NUM_COLUMNS];
+};
+
+// Returns true if the file starts with the columnar trace magic.
+bool is_columnar_trace(const char *name);
+
+// Reads the columns of a columnar trace selected by a TRACE_FIELD_* mask.
+class columnar_trace_reader_t : public trace_reader_t {
+private:
+   int fd;
+   std::vector<columnar_chunk_entry_t> table;
+   bool load[NUM_COLUMNS];	// columns read from the file
+
+   std::vector<uint8_t> in;			// compressed column
+   std::vector<uint8_t> data[NUM_COLUMNS];	// current chunk's columns
+   const uint8_t *next_pc;	// next entries of the sparse columns
+   const uint8_t *mem;
+   const uint8_t *values;
+
+   uint64_t chunk;		// index of the current chunk
+   uint32_t next;		// index of the next micro-op in the current chunk
+   uint32_t num_uops;		// micro-ops in the current chunk (0: no chunk loaded)
+   uint64_t nInstr;		// trace instructions returned so far
+   uint64_t total_uops;
+   uint64_t uops_before;	// micro-ops in the chunks before the current one
+
+   bool load_chunk(uint64_t c);
+   void decode(db_t *inst);
+
+public:
+   columnar_trace_reader_t(const char *name, unsigned fields = TRACE_FIELDS_ALL);
+   ~columnar_trace_reader_t();
+   db_t *get_inst();
+   size_t get_batch(db_t *out, size_t max);
+   uint64_t num_instr() const { return nInstr; }
+   double fraction_read() const { return (total_uops ? ((double)(uops_before + next) / total_uops) : 1.0); }
+   bool seek(uint64_t instr);
+};
+
+// Writes a columnar trace. The chunk table and header are written by the destructor.
+class columnar_trace_writer_t {
+private:
+   FILE *fp;
+   columnar_trace_header_t header;
+   std::vector<columnar_chunk_entry_t> table;
+   std::vector<uint8_t> data[NUM_COLUMNS];	// columns of the chunk being filled
+   columnar_chunk_entry_t chunk;
+   uint64_t offset;
+   int level;
+   bool ok;
+
+   void flush();
+
+public:
+   columnar_trace_writer_t(const char *name, int level = 6);
+   ~columnar_trace_writer_t();
+   void write(const db_t *inst, bool first_piece);
+};
@@ -27,16 +27,61 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <inttypes.h>
 #include <assert.h>
 #include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
 #include "cvp.h"
 #include "cvp_trace_reader.h"
+#include "trace_reader.h"
 #include "fifo.h"
 #include "cache.h"
 #include "bp.h"
 #include "resource_schedule.h"
 #include "uarchsim.h"
 #include "parameters.h"
+#include "sim_config.h"
+#include "spsc_ring.h"
+#include "broadcast_ring.h"
+#include "progress.h"
+#include "sampler.h"
+#include "simpoint.h"
+#include "checkpoint.h"
+#include "interval_stats.h"
 
+// Decoded micro-ops buffered between the decode thread and the simulation thread (-T).
+// Micro-ops are handed from the trace reader to the simulator in batches of DECODE_BATCH_SIZE.
+// The decode ring holds DECODE_RING_SIZE batches.
+#define DECODE_BATCH_SIZE 64
+#define DECODE_RING_SIZE 64
+
+struct db_batch_t {
+  size_t n;
+  uint64_t instr;	// reader's num_instr() once the batch was read
+  db_t inst[DECODE_BATCH_SIZE];
+};
+
+// Where the simulation is in the trace, for checkpoints (-K, -L).
+struct trace_position_t {
+  uint64_t uops;	// micro-ops simulated (or warmed, or sampled)
+  uint64_t instr;	// trace instructions started
+  uint64_t pieces;	// micro-ops of the last trace instruction started that were simulated
+  uint64_t last_pc;	// their PC
+};
+
+sim_config_t config;
 uarchsim_t *sim;
+sampler_t *sampler = NULL;	// with -s
+uint64_t fast_forward = 0;	// micro-ops left to warm before simulating (-S)
+trace_position_t position = {0, 0, 0, 0};
+uint64_t next_checkpoint;	// position.uops of the next checkpoint (-K)
+simpoint_estimate_t *simpoint_estimate = NULL;	// with -x
 
 int parseargs(int argc, char ** argv) {
   int i = 1;
@@ -44,202 +89,262 @@ int parseargs(int argc, char ** argv) {
   // read optional flags
   while (i < argc)
   {
-     if (!strcmp(argv[i], "-v"))
+     if (config.parse_option(argc, argv, i))
+     {
+        // simulator option (see sim_config_t)
+     }
+     else if (!strcmp(argv[i], "-c"))
      {
-        VP_ENABLE = true;
         i++;
+        if ((i < argc) && config.parse_file(argv[i]))
+        {
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing or invalid configuration file: -c <config_file>.\n");
+           exit(0);
+        }
      }
-     else if (!strcmp(argv[i], "-p"))
+     else if (!strcmp(argv[i], "-k"))
      {
-        VP_PERFECT = true;
         i++;
+        if (i < argc)
+        {
+           SKIP_INSTR = strtoull(argv[i], NULL, 0);
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing number of instructions to skip: -k <skip_instrs>.\n");
+           exit(0);
+        }
      }
-     else if (!strcmp(argv[i], "-t"))
+     else if (!strcmp(argv[i], "-S"))
      {
         i++;
         if (i < argc)
         {
-           VP_TRACK = stoul(argv[i]);
-           assert(VP_TRACK <  static_cast<std::underlying_type<VPTracks>::type>(VPTracks::NumTracks));
+           FAST_FORWARD = strtoull(argv[i], NULL, 0);
            i++;
         }
         else
         {
-           printf("Usage: missing track number : -t <track_number>.\n");
+           printf("Usage: missing number of micro-ops to fast-forward: -S <fast_forward_uops>.\n");
            exit(0);
         }
      }
-     else if (!strcmp(argv[i], "-d"))
+     else if (!strcmp(argv[i], "-T"))
      {
-        PERFECT_CACHE = true;
+        TRACE_DECODE_THREAD = true;
         i++;
      }
-     else if (!strcmp(argv[i], "-b"))
+     else if (!strcmp(argv[i], "-B"))
      {
-        PERFECT_BRANCH_PRED = true;
         i++;
+        if (i < argc)
+        {
+           TRACE_BUFFER_SIZE = ((uint64_t)atoi(argv[i]) << 20);
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing trace buffer size: -B <trace_buffer_MB>.\n");
+           exit(0);
+        }
      }
-     else if (!strcmp(argv[i], "-i"))
+     else if (!strcmp(argv[i], "-j"))
      {
-        PERFECT_INDIRECT_PRED = true;
         i++;
+        if (i < argc)
+        {
+           TRACE_THREADS = atoi(argv[i]);
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing number of trace decompression threads: -j <trace_threads>.\n");
+           exit(0);
+        }
      }
-     else if (!strcmp(argv[i], "-P"))
+     else if (!strcmp(argv[i], "-C"))
      {
-        PREFETCHER_ENABLE = true;
+        TRACE_SHARED_CACHE = true;
         i++;
      }
-     else if (!strcmp(argv[i], "-f"))
+     else if (!strcmp(argv[i], "-a"))
      {
         i++;
         if (i < argc)
         {
-           PIPELINE_FILL_LATENCY = atoi(argv[i]);
+           TRACE_READ_AHEAD = atoi(argv[i]);
            i++;
         }
         else
         {
-           printf("Usage: missing pipeline fill latency: -f <pipeline_fill_latency>.\n");
+           printf("Usage: missing read-ahead depth: -a <read_ahead_chunks>.\n");
            exit(0);
         }
      }
-     else if (!strcmp(argv[i], "-M"))
+     else if (!strcmp(argv[i], "-U"))
+     {
+        TRACE_DROP_CACHE = true;
+        i++;
+     }
+     else if (!strcmp(argv[i], "-q"))
+     {
+        PROGRESS_INTERVAL = 0.0;
+        i++;
+     }
+     else if (!strcmp(argv[i], "-r"))
      {
         i++;
         if (i < argc)
         {
-           NUM_LDST_LANES = atoi(argv[i]);
+           PROGRESS_INTERVAL = atof(argv[i]);
            i++;
         }
         else
         {
-           printf("Usage: missing # load/store lanes: -M <num_ldst_lanes>.\n");
+           printf("Usage: missing progress report interval: -r <progress_interval_s>.\n");
            exit(0);
         }
      }
-     else if (!strcmp(argv[i], "-A"))
+     else if (!strcmp(argv[i], "-m"))
      {
         i++;
         if (i < argc)
         {
-           NUM_ALU_LANES = atoi(argv[i]);
+           SWEEP_FILE = argv[i];
            i++;
         }
         else
         {
-           printf("Usage: missing # alu lanes: -A <num_alu_lanes>.\n");
+           printf("Usage: missing sweep file: -m <sweep_file>.\n");
            exit(0);
         }
      }
-     //else if (!strcmp(argv[i], "-s")) {
-     //   WRITE_ALLOCATE = true;
-     //	i++;
-     //}
-     else if (!strcmp(argv[i], "-F"))
+     else if (!strcmp(argv[i], "-s"))
+     {
+        i++;
+        unsigned long long unit, period, warmup;
+        int n = ((i < argc) ? sscanf(argv[i], "%llu,%llu,%llu", &unit, &period, &warmup) : 0);
+        if (n == 2)
+           warmup = 2 * unit;
+        if ((n >= 2) && unit && (period >= unit + warmup))
+        {
+           SAMPLE_UNIT = unit;
+           SAMPLE_PERIOD = period;
+           SAMPLE_WARMUP = warmup;
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing or invalid sampling parameters: -s <unit>,<period>[,<warmup>] (period >= unit + warmup).\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-e"))
      {
         i++;
         if (i < argc)
         {
-           unsigned int temp1, temp2, temp3, temp4, temp5;
-           if (sscanf(argv[i], "%d,%d,%d,%d,%d", &temp1, &temp2, &temp3, &temp4, &temp5) == 5)
-           {
-              FETCH_WIDTH = (uint64_t)temp1;
-              FETCH_NUM_BRANCH = (uint64_t)temp2;
-              FETCH_STOP_AT_INDIRECT = (temp3 ? true : false);
-              FETCH_STOP_AT_TAKEN = (temp4 ? true : false);
-              FETCH_MODEL_ICACHE = (temp5 ? true : false);
-           }
-           else
-           {
-              printf("Usage: missing one or more fetch bundle constraints: -F <fetch_width>,<fetch_num_branch>,<fetch_stop_at_indirect>,<fetch_stop_at_taken>,<fetch_model_icache>.\n");
-              exit(0);
-           }
+           SAMPLE_ERROR = (atof(argv[i]) / 100.0);
            i++;
         }
         else
         {
-           printf("Usage: missing one or more fetch bundle constraints: -F <fetch_width>,<fetch_num_branch>,<fetch_stop_at_indirect>,<fetch_stop_at_taken>,<fetch_model_icache>.\n");
+           printf("Usage: missing sampling target error: -e <target_error_%%>.\n");
            exit(0);
         }
      }
-     else if (!strcmp(argv[i], "-I"))
+     else if (!strcmp(argv[i], "-x"))
      {
         i++;
         if (i < argc)
         {
-           unsigned int temp1, temp2, temp3;
-           if (sscanf(argv[i], "%d,%d,%d", &temp1, &temp2, &temp3) == 3)
-           {
-              IC_SIZE = (uint64_t)(1 << temp1);
-              IC_ASSOC = (uint64_t)temp2;
-              IC_BLOCKSIZE = (uint64_t)temp3;
-           }
-           else
-           {
-              printf("Usage: missing one or more I$ parameters: -I <log2_size>,<assoc>,<blocksize>.\n");
-              exit(0);
-           }
+           SIMPOINT_FILE = argv[i];
            i++;
         }
         else
         {
-           printf("Usage: missing I$ parameters: -I <log2_size>,<assoc>,<blocksize>.\n");
+           printf("Usage: missing simulation point file: -x <simpoint_file>.\n");
            exit(0);
         }
      }
-     else if (!strcmp(argv[i], "-D"))
+     else if (!strcmp(argv[i], "-X"))
      {
         i++;
         if (i < argc)
         {
-           unsigned int temp1, temp2, temp3, temp4, temp5, temp6, temp7, temp8, temp9, temp10, temp11, temp12, temp13;
-           if (sscanf(argv[i], "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
-                      &temp1, &temp2, &temp3, &temp4,
-                      &temp5, &temp6, &temp7, &temp8,
-                      &temp9, &temp10, &temp11, &temp12,
-                      &temp13) == 13)
-           {
-              L1_SIZE = (uint64_t)(1 << temp1);
-              L1_ASSOC = (uint64_t)temp2;
-              L1_BLOCKSIZE = (uint64_t)temp3;
-              L1_LATENCY = (uint64_t)temp4;
-
-              L2_SIZE = (uint64_t)(1 << temp5);
-              L2_ASSOC = (uint64_t)temp6;
-              L2_BLOCKSIZE = (uint64_t)temp7;
-              L2_LATENCY = (uint64_t)temp8;
-
-              L3_SIZE = (uint64_t)(1 << temp9);
-              L3_ASSOC = (uint64_t)temp10;
-              L3_BLOCKSIZE = (uint64_t)temp11;
-              L3_LATENCY = (uint64_t)temp12;
-
-              MAIN_MEMORY_LATENCY = (uint64_t)temp13;
-           }
-           else
-           {
-              printf("Usage: missing one or more L1$, L2$, and L3$ parameters: -D <log2_L1_size>,<L1_assoc>,<L1_blocksize>,<L1_latency>,<log2_L2_size>,<L2_assoc>,<L2_blocksize>,<L2_latency>,<log2_L3_size>,<L3_assoc>,<L3_blocksize>,<L3_latency>,<main_memory_latency>.\n");
-              exit(0);
-           }
+           SIMPOINT_WARMUP = strtoull(argv[i], NULL, 0);
            i++;
         }
         else
         {
-           printf("Usage: missing L1$, L2$, and L3$ parameters: -D <log2_L1_size>,<L1_assoc>,<L1_blocksize>,<L1_latency>,<log2_L2_size>,<L2_assoc>,<L2_blocksize>,<L2_latency>,<log2_L3_size>,<L3_assoc>,<L3_blocksize>,<L3_latency>,<main_memory_latency>.\n");
+           printf("Usage: missing simulation point warmup: -X <warmup_instrs>.\n");
            exit(0);
         }
      }
-     else if (!strcmp(argv[i], "-w"))
+     else if (!strcmp(argv[i], "-K"))
+     {
+        i++;
+        unsigned long long period;
+        int n = 0;
+        if ((i < argc) && (sscanf(argv[i], "%llu,%n", &period, &n) == 1) && n && period && argv[i][n])
+        {
+           CHECKPOINT_PERIOD = period;
+           CHECKPOINT_FILE = &argv[i][n];
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing or invalid checkpoint parameters: -K <checkpoint_period_uops>,<checkpoint_file>.\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-L"))
      {
         i++;
         if (i < argc)
         {
-           WINDOW_SIZE = atoi(argv[i]);
+           RESTORE_FILE = argv[i];
            i++;
         }
         else
         {
-           printf("Usage: missing window size: -w <window_size>.\n");
+           printf("Usage: missing checkpoint to resume from: -L <checkpoint_file>.\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-o"))
+     {
+        i++;
+        unsigned long long size;
+        int n = 0;
+        if ((i < argc) && (sscanf(argv[i], "%llu,%n", &size, &n) == 1) && n && size && argv[i][n])
+        {
+           INTERVAL_SIZE = size;
+           INTERVAL_FILE = &argv[i][n];
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing or invalid interval statistics parameters: -o <interval_uops>,<csv_file>.\n");
+           exit(0);
+        }
+     }
+     else if (!strcmp(argv[i], "-R"))
+     {
+        i++;
+        if (i < argc)
+        {
+           PROGRESS_FILE = argv[i];
+           i++;
+        }
+        else
+        {
+           printf("Usage: missing progress status file: -R <status_file>.\n");
            exit(0);
         }
      }
@@ -249,22 +354,366 @@ int parseargs(int argc, char ** argv) {
      }
   }
 
+  if (SIMPOINT_FILE && (SAMPLE_UNIT || SWEEP_FILE || SKIP_INSTR || FAST_FORWARD)) {
+     printf("Usage: -x <simpoint_file> cannot be combined with -s, -m, -k or -S.\n");
+     exit(0);
+  }
+
+  if ((CHECKPOINT_FILE || RESTORE_FILE) && (SWEEP_FILE || SIMPOINT_FILE)) {
+     printf("Usage: -K and -L cannot be combined with -m or -x.\n");
+     exit(0);
+  }
+  if (INTERVAL_FILE && SWEEP_FILE) {
+     printf("Usage: -o cannot be combined with -m.\n");
+     exit(0);
+  }
+  if (RESTORE_FILE && SKIP_INSTR) {
+     printf("Usage: -L <checkpoint_file> cannot be combined with -k (the checkpoint holds the trace position).\n");
+     exit(0);
+  }
+
   if (i < argc) {
      return(i);
   }
   else {
-     printf("usage:\t%s\n\t[optional: -v to enable value prediction]\n\t[optional: -p to enable perfect value prediction (if -v also specified)]\n\t[optional: -d to enable perfect data cache]\n\t[optional: -b to enable perfect branch prediction (all branch types)]\n\t[optional: -i to enable perfect indirect-branch prediction]\n\t[optional: -P to enable stride prefetcher in L1D]\n\t[optional: -f <pipeline_fill_latency>]\n\t[optional: -M <num_ldst_lanes>\n\t[optional: -A <num_alu_lanes>\n\t[optional: -F <fetch_width>,<fetch_num_branch>,<fetch_stop_at_indirect>,<fetch_stop_at_taken>,<fetch_model_icache>]\n\t[optional: -I <log2_ic_size>,<ic_assoc>,<ic_blocksize>]\n\t[optional: -D <log2_L1_size>,<L1_assoc>,<L1_blocksize>,<L1_latency>,<log2_L2_size>,<L2_assoc>,<L2_blocksize>,<L2_latency>,<log2_L3_size>,<L3_assoc>,<L3_blocksize>,<L3_latency>,<main_memory_latency>]\n\t[optional: -w <window_size>]\n\t[REQUIRED: .gz trace file]\n\t[optional: contestant's arguments]\n", argv[0]);
+     printf("usage:\t%s\n\t[optional: -v to enable value prediction]\n\t[optional: -p to enable perfect value prediction (if -v also specified)]\n\t[optional: -d to enable perfect data cache]\n\t[optional: -b to enable perfect branch prediction (all branch types)]\n\t[optional: -i to enable perfect indirect-branch prediction]\n\t[optional: -P to enable stride prefetcher in L1D]\n\t[optional: -f <pipeline_fill_latency>]\n\t[optional: -M <num_ldst_lanes>\n\t[optional: -A <num_alu_lanes>\n\t[optional: -F <fetch_width>,<fetch_num_branch>,<fetch_stop_at_indirect>,<fetch_stop_at_taken>,<fetch_model_icache>]\n\t[optional: -I <log2_ic_size>,<ic_assoc>,<ic_blocksize>]\n\t[optional: -D <log2_L1_size>,<L1_assoc>,<L1_blocksize>,<L1_latency>,<log2_L2_size>,<L2_assoc>,<L2_blocksize>,<L2_latency>,<log2_L3_size>,<L3_assoc>,<L3_blocksize>,<L3_latency>,<main_memory_latency>]\n\t[optional: -w <window_size>]\n\t[optional: -c <config_file> to read simulator options (the options above) from config_file]\n\t[optional: -B <trace_buffer_MB>]\n\t[optional: -T to decode the trace on a separate thread]\n\t[optional: -j <trace_threads> to decompress block traces with trace_threads threads]\n\t[optional: -C to decode the trace once per host into shared memory, shared by all cvp processes using -C]\n\t[optional: -a <read_ahead_chunks> to read .gz traces read_ahead_chunks chunks ahead (default 4, 0: synchronous reads)]\n\t[optional: -U to drop trace file pages from the page cache once read]\n\t[optional: -m <sweep_file> to simulate the configurations in sweep_file (simulator options, one configuration per line) in a single pass over the trace]\n\t[optional: -s <unit>,<period>[,<warmup>] to sample: simulate in detail unit micro-ops (after warmup, default 2*unit) out of every period, warm the rest]\n\t[optional: -e <target_error_%%> to stop sampling once the confidence intervals are within target_error_%%]\n\t[optional: -x <simpoint_file> to simulate only the simulation points in simpoint_file (from cvp-simpoint), warm the instructions before each]\n\t[optional: -X <warmup_instrs> warmed before each simulation point (default: one interval)]\n\t[optional: -k <skip_instrs> to start simulating at trace instruction skip_instrs]\n\t[optional: -S <fast_forward_uops> to warm caches and predictors (without timing) with the first fast_forward_uops micro-ops, then simulate]\n\t[optional: -K <checkpoint_period_uops>,<checkpoint_file> to write a checkpoint of the simulation every checkpoint_period_uops micro-ops]\n\t[optional: -L <checkpoint_file> to resume the simulation from a checkpoint]\n\t[optional: -o <interval_uops>,<csv_file> to write IPC, MPKIs and value prediction statistics of every interval_uops simulated micro-ops to csv_file]\n\t[optional: -r <progress_interval_s> between progress reports on stderr (default 10)]\n\t[optional: -R <status_file> to write progress reports to status_file instead]\n\t[optional: -q to disable progress reports]\n\t[REQUIRED: .gz, native, block, columnar, codec or dict trace file]\n\t[optional: contestant's arguments]\n", argv[0]);
+     exit(0);
+  }
+}
+
+// Creates the simulator (and its sampler, with -s).
+void new_simulator(const sim_config_t &sim_config) {
+  sim = new uarchsim_t(sim_config);
+  fast_forward = FAST_FORWARD;
+  if (SAMPLE_UNIT)
+     sampler = new sampler_t(sim, SAMPLE_UNIT, SAMPLE_PERIOD, SAMPLE_WARMUP, SAMPLE_ERROR, (sim_config.vp_enable && !sim_config.vp_perfect));
+}
+
+// Simulates n micro-ops, or samples them with -s, after fast-forwarding (-S). Returns false once sampling needs no more micro-ops.
+bool simulate(db_t *inst, size_t n) {
+  if (fast_forward) {
+     size_t warm = ((n < fast_forward) ? n : fast_forward);
+     for (size_t j = 0; j < warm; j++)
+        sim->warm(&inst[j]);
+     fast_forward -= warm;
+     inst += warm;
+     n -= warm;
+     if (!n)
+        return(true);
+  }
+  if (!sampler) {
+     sim->step_batch(inst, n);
+     return(true);
+  }
+  sampler->step_batch(inst, n);
+  return(!sampler->done());
+}
+
+void output() {
+  sim->output();
+  if (sampler)
+     sampler->output();
+  if (simpoint_estimate)
+     simpoint_estimate->output(config.vp_enable && !config.vp_perfect);
+}
+
+// Saves or restores everything a resumed simulation needs (see checkpoint.h).
+void checkpoint_state(checkpoint_t &ck) {
+  ck.section("trace position");
+  ck.io(position);
+  ck.io(fast_forward);
+  sim->checkpoint(ck);
+  bool sampling = (sampler != NULL);
+  ck.shape(sampling, "sampling (-s)");
+  if (sampler)
+     sampler->checkpoint(ck);
+  ck.blob(ck.restoring() ? restorePredictor : savePredictor, "value predictor");
+}
+
+// Writes the checkpoint next to CHECKPOINT_FILE and renames it, so that a crash while writing keeps the previous one.
+void save_checkpoint() {
+  std::string tmp = (std::string(CHECKPOINT_FILE) + ".tmp");
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (!fp) {
+     fprintf(stderr, "Cannot write checkpoint %s.\n", tmp.c_str());
+     return;
+  }
+  checkpoint_t ck(fp, false);
+  checkpoint_state(ck);
+  bool ok = ck.good();
+  ok = ((fclose(fp) == 0) && ok);
+  if (!ok || rename(tmp.c_str(), CHECKPOINT_FILE))
+     fprintf(stderr, "Cannot write checkpoint %s: %s.\n", CHECKPOINT_FILE, (ck.good() ? "write error" : ck.what()));
+}
+
+// Restores RESTORE_FILE into the simulator (created, with its predictor begun) and moves the reader to the
+// micro-op after the last one simulated.
+void restore_checkpoint(trace_reader_t *reader) {
+  FILE *fp = fopen(RESTORE_FILE, "rb");
+  if (!fp) {
+     printf("Cannot open checkpoint %s.\n", RESTORE_FILE);
+     exit(0);
+  }
+  checkpoint_t ck(fp, true);
+  checkpoint_state(ck);
+  fclose(fp);
+  if (!ck.good()) {
+     printf("Cannot restore checkpoint %s: %s.\n", RESTORE_FILE, ck.what());
+     exit(0);
+  }
+
+  // The last instruction may have been cracked into more micro-ops than were simulated: re-read the ones that were.
+  bool ok;
+  if (position.pieces) {
+     ok = reader->seek(position.instr - 1);
+     db_t skipped[DECODE_BATCH_SIZE];
+     for (uint64_t left = position.pieces; ok && left; ) {
+        size_t n = reader->get_batch(skipped, ((left < DECODE_BATCH_SIZE) ? left : DECODE_BATCH_SIZE));
+        ok = ((n > 0) && (skipped[n - 1].pc == position.last_pc));
+        left -= n;
+     }
+     ok = (ok && (reader->num_instr() == position.instr));
+  }
+  else {
+     ok = reader->seek(position.instr);
+  }
+  if (!ok) {
+     printf("Checkpoint %s does not match the trace.\n", RESTORE_FILE);
      exit(0);
   }
 }
 
+// Accounts for a batch the simulation consumed, and writes a checkpoint when one is due.
+void advance(const db_batch_t *batch) {
+  if (!batch->n)
+     return;
+  position.uops += batch->n;
+  position.instr = batch->instr;
+
+  // Trailing micro-ops of the last instruction: pieces of a cracked instruction share its PC, and the instruction
+  // after a non-branch has another PC. A branch is a single micro-op.
+  auto is_branch = [](const db_t &u) {
+     return((u.insn == InstClass::condBranchInstClass) || (u.insn == InstClass::uncondDirectBranchInstClass) ||
+            (u.insn == InstClass::uncondIndirectBranchInstClass));
+  };
+  const db_t &last = batch->inst[batch->n - 1];
+  uint64_t pieces = 1;
+  if (!is_branch(last)) {
+     size_t j = (batch->n - 1);
+     while ((j > 0) && (batch->inst[j - 1].pc == last.pc)) {
+        pieces++;
+        j--;
+     }
+     if ((j == 0) && position.pieces && (position.last_pc == last.pc))
+        pieces += position.pieces;
+  }
+  position.pieces = pieces;
+  position.last_pc = last.pc;
+
+  if (CHECKPOINT_PERIOD && (position.uops >= next_checkpoint)) {
+     save_checkpoint();
+     next_checkpoint = ((position.uops / CHECKPOINT_PERIOD) + 1) * CHECKPOINT_PERIOD;
+  }
+}
+
+// Opens the trace and skips to the first simulated instruction.
+trace_reader_t *open_input(const char *name, bool values) {
+  trace_options_t trace_options;
+  trace_options.buffer_size = TRACE_BUFFER_SIZE;
+  trace_options.threads = TRACE_THREADS;
+  trace_options.shared_cache = TRACE_SHARED_CACHE;
+  trace_options.read_ahead = TRACE_READ_AHEAD;
+  trace_options.drop_cache = TRACE_DROP_CACHE;
+  // Destination values are only used by value prediction.
+  trace_options.fields = (values ? TRACE_FIELDS_ALL : (TRACE_FIELDS_ALL & ~TRACE_FIELD_VALUES));
+  trace_reader_t *reader = open_trace(name, trace_options);
+  if (SKIP_INSTR && !reader->seek(SKIP_INSTR)) {
+     printf("Trace has fewer than %" PRIu64 " instructions.\n", SKIP_INSTR);
+     exit(0);
+  }
+  return(reader);
+}
+
+// Simulates the simulation points of SIMPOINT_FILE (-x): for each point, warms the simulator functionally
+// (skipping ahead first if the previous point ended earlier), then simulates the point's interval in detail.
+void run_simpoints(trace_reader_t *reader, progress_t &progress) {
+  simpoints_t simpoints;
+  if (!simpoints.read(SIMPOINT_FILE)) {
+     printf("Cannot read simulation point file %s.\n", SIMPOINT_FILE);
+     exit(0);
+  }
+  uint64_t size = simpoints.interval_size;
+  uint64_t warmup = (SIMPOINT_WARMUP ? SIMPOINT_WARMUP : size);
+  simpoint_estimate = new simpoint_estimate_t;
+
+  db_batch_t *batch = new db_batch_t;
+  bool end = false;
+  for (const simpoint_t &point : simpoints.points) {
+     uint64_t start = (point.interval * size);
+     uint64_t warm_start = ((start > warmup) ? (start - warmup) : 0);
+     if ((reader->num_instr() < warm_start) && !reader->seek(warm_start))
+        break;
+
+     // Intervals are simulated at batch granularity, as cvp-simpoint profiled them.
+     while (!end && (reader->num_instr() < start)) {
+        end = ((batch->n = reader->get_batch(batch->inst, DECODE_BATCH_SIZE)) < DECODE_BATCH_SIZE);
+        for (size_t j = 0; j < batch->n; j++)
+           sim->warm(&batch->inst[j]);
+        progress.tick(batch->n);
+     }
+     sim_results_t before = sim->results();
+     while (!end && (reader->num_instr() < start + size)) {
+        end = ((batch->n = reader->get_batch(batch->inst, DECODE_BATCH_SIZE)) < DECODE_BATCH_SIZE);
+        sim->step_batch(batch->inst, batch->n);
+        progress.tick(batch->n);
+     }
+     sim_results_t after = sim->results();
+     simpoint_estimate->add(point, after.instructions - before.instructions, after.cycles - before.cycles,
+                  after.vp_correct - before.vp_correct, after.vp_incorrect - before.vp_incorrect);
+     if (end)
+        break;
+  }
+  delete batch;
+}
+
+// Simulates configuration c of a sweep from the micro-ops the parent broadcasts.
+// Runs in a child process: the predictor is global state.
+void sweep_child(unsigned c, const sim_config_t &sim_config, int pred_argc, char **pred_argv,
+                 broadcast_ring_t<db_batch_t> &ring) {
+  new_simulator(sim_config);
+  beginPredictor(pred_argc, pred_argv);
+
+  db_batch_t *batch;
+  while (true) {
+    if ((batch = ring.front(c))) {
+      simulate(batch->inst, batch->n);	// keeps consuming the broadcast once sampling is done
+      ring.release(c);
+    }
+    else if (ring.done(c))
+      break;
+    else
+      std::this_thread::yield();
+  }
+
+  endPredictor();
+  output();
+}
+
+// Single-pass sweep (-m): one child process per configuration simulates the micro-ops that this process
+// decodes once and broadcasts to all of them. Outputs are printed in configuration order.
+void run_sweep(const char *trace, int pred_argc, char **pred_argv) {
+  std::ifstream file(SWEEP_FILE);
+  if (!file) {
+     printf("Cannot open sweep file %s.\n", SWEEP_FILE);
+     exit(0);
+  }
+  std::vector<std::string> lines;
+  std::vector<sim_config_t> configs;
+  std::string line;
+  while (std::getline(file, line)) {
+     // Each configuration overrides the command line's options.
+     std::istringstream tokens(line);
+     std::string first;
+     if (!(tokens >> first) || (first[0] == '#'))
+        continue;
+     sim_config_t sim_config = config;
+     if (!sim_config.parse_string(line)) {
+        printf("Invalid configuration in sweep file %s: %s\n", SWEEP_FILE, line.c_str());
+        exit(0);
+     }
+     lines.push_back(line);
+     configs.push_back(sim_config);
+  }
+  if (configs.empty()) {
+     printf("Sweep file %s has no configurations.\n", SWEEP_FILE);
+     exit(0);
+  }
+
+  unsigned n = configs.size();
+  broadcast_ring_t<db_batch_t> ring(DECODE_RING_SIZE, n);
+  std::vector<FILE *> outputs(n);
+  std::vector<pid_t> pids(n);
+  std::vector<int> status(n);
+  std::vector<bool> running(n, true);
+
+  // Fork before opening the trace, so that children do not inherit the reader's threads.
+  fflush(stdout);
+  for (unsigned c = 0; c < n; c++) {
+     outputs[c] = tmpfile();
+     pids[c] = fork();
+     if (pids[c] < 0) {
+        printf("Cannot fork the simulator of configuration %u.\n", c);
+        exit(0);
+     }
+     if (pids[c] == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);	// do not wait forever for a parent that died
+        dup2(fileno(outputs[c]), STDOUT_FILENO);
+        sweep_child(c, configs[c], pred_argc, pred_argv, ring);
+        fflush(stdout);
+        _exit(0);
+     }
+  }
+
+  // Any configuration may enable value prediction.
+  trace_reader_t *reader = open_input(trace, true);
+  progress_t progress(reader, PROGRESS_INTERVAL, PROGRESS_FILE);
+
+  db_batch_t *batch;
+  size_t num;
+  do {
+    for (unsigned spins = 1; !(batch = ring.alloc()); spins++) {
+      // Stop waiting for children that exited early (e.g., bad configuration).
+      if ((spins % 1024) == 0) {
+        for (unsigned c = 0; c < n; c++) {
+          if (running[c] && (waitpid(pids[c], &status[c], WNOHANG) == pids[c])) {
+            running[c] = false;
+            ring.detach(c);
+          }
+        }
+      }
+      std::this_thread::yield();
+    }
+    num = batch->n = reader->get_batch(batch->inst, DECODE_BATCH_SIZE);
+    ring.publish();
+    progress.tick(num);
+  } while (num == DECODE_BATCH_SIZE);
+  ring.finish();
+
+  for (unsigned c = 0; c < n; c++)
+     if (running[c])
+        waitpid(pids[c], &status[c], 0);
+  progress.finish();
+  delete reader;
+
+  char buf[4096];
+  for (unsigned c = 0; c < n; c++) {
+     printf("==== Configuration %u: %s\n", c, lines[c].c_str());
+     fflush(stdout);
+     rewind(outputs[c]);
+     size_t size;
+     while ((size = fread(buf, 1, sizeof(buf), outputs[c])))
+        fwrite(buf, 1, size, stdout);
+     fclose(outputs[c]);
+     if (!WIFEXITED(status[c]) || WEXITSTATUS(status[c]))
+        printf("Simulator of configuration %u failed.\n", c);
+     printf("\n");
+  }
+}
+
 int main(int argc, char ** argv)
 {
   int i = parseargs(argc, argv);
-  CVPTraceReader reader(argv[i]);
 
-  // Need to create simulator after parsing arguments (for global parameters).
-  sim = new uarchsim_t;
+  if (SWEEP_FILE) {
+     // Predictor arguments follow the trace file name.
+     run_sweep(argv[i], argc - i - 1, ((i + 1 < argc) ? &argv[i + 1] : (char **)NULL));
+     return(0);
+  }
+
+  trace_reader_t *reader = open_input(argv[i], config.vp_enable);
+
+  // Need to create simulator after parsing arguments (for its configuration).
+  new_simulator(config);
  
   // Get to next (optional) argument after trace filename.
   i++;
@@ -272,13 +721,88 @@ int main(int argc, char ** argv)
      beginPredictor((argc - i), &(argv[i]));
   else
      beginPredictor(0, (char **)NULL);
+  if (RESTORE_FILE)
+     restore_checkpoint(reader);
+  if (CHECKPOINT_PERIOD)
+     next_checkpoint = (((position.uops / CHECKPOINT_PERIOD) + 1) * CHECKPOINT_PERIOD);
+  FILE *interval_fp = NULL;
+  interval_stats_t *intervals = NULL;
+  if (INTERVAL_FILE) {
+     if (!(interval_fp = fopen(INTERVAL_FILE, "w"))) {
+        printf("Cannot write interval statistics %s.\n", INTERVAL_FILE);
+        exit(0);
+     }
+     intervals = new interval_stats_t(interval_fp, INTERVAL_SIZE, sim->results());
+     sim->record_intervals(intervals);
+  }
+  progress_t progress(reader, PROGRESS_INTERVAL, PROGRESS_FILE);
 
-  db_t *inst = nullptr; 
-  while (inst = reader.get_inst()) {
-    sim->step(inst);
-    delete inst;
+  if (SIMPOINT_FILE) {
+    run_simpoints(reader, progress);
   }
+  else if (TRACE_DECODE_THREAD) {
+    // Pipelined mode: a producer thread inflates and decodes the trace while this thread simulates.
+    // Batches are decoded into and simulated from the ring's own entries.
+    spsc_ring_t<db_batch_t> ring(DECODE_RING_SIZE);
+    std::atomic<bool> decode_done(false);
+    std::atomic<bool> stop(false);	// sampling needs no more micro-ops
+
+    std::thread decoder([&]() {
+      db_batch_t *batch;
+      size_t n;
+      do {
+        while (!(batch = ring.alloc()) && !stop.load(std::memory_order_acquire))
+          std::this_thread::yield();
+        if (!batch)
+          break;
+        n = batch->n = reader->get_batch(batch->inst, DECODE_BATCH_SIZE);
+        batch->instr = reader->num_instr();
+        ring.publish();
+        progress.tick(n);
+      } while (n == DECODE_BATCH_SIZE);
+      decode_done.store(true, std::memory_order_release);
+    });
 
+    db_batch_t *batch;
+    while (true) {
+      if ((batch = ring.front())) {
+        bool more = simulate(batch->inst, batch->n);
+        advance(batch);
+        ring.release();
+        if (!more) {
+          stop.store(true, std::memory_order_release);
+          break;
+        }
+      }
+      else if (decode_done.load(std::memory_order_acquire) && ring.empty())
+        break;
+      else
+        std::this_thread::yield();
+    }
+    decoder.join();
+  }
+  else {
+    db_batch_t *batch = new db_batch_t;
+    while ((batch->n = reader->get_batch(batch->inst, DECODE_BATCH_SIZE))) {
+      batch->instr = reader->num_instr();
+      bool more = simulate(batch->inst, batch->n);
+      advance(batch);
+      progress.tick(batch->n);
+      if (!more)
+        break;
+    }
+    delete batch;
+  }
+
+  progress.finish();
+  if (intervals) {
+     intervals->finish(sim->results());
+     sim->record_intervals(NULL);
+     delete intervals;
+     if (fclose(interval_fp))
+        fprintf(stderr, "Cannot write interval statistics %s.\n", INTERVAL_FILE);
+  }
   endPredictor();
-  sim->output();
+  output();
+  delete reader;
 }
@@ -1,3 +1,4 @@
+#pragma once
 // CVP1 Trace Reader
 // Author: Arthur Perais (arthur.perais@gmail.com)
 
@@ -31,7 +32,7 @@ This project relies on https://www.cs.unc.edu/Research/compgeom/gzstream/ (LGPL)
 For ease of use, gzstream.h and gzstream.C are provided with minor modifications (include paths) with the reader.
 */
 
-// Compilation : Don't forget to add gzstream.C in the source list and to link with zlib (-lz).
+// Compilation : Don't forget to add trace_input.cc in the source list and to link with zlib (-lz).
 //
 // Usage : CVPTraceReader reader("./my_trace.tar.gz")
 //         while(reader.readInstr())
@@ -63,7 +64,10 @@ For ease of use, gzstream.h and gzstream.C are provided with minor modifications
 #include <iostream>
 #include <vector>
 #include <cassert>
-#include "./gzstream.h"
+#include <cstring>
+#include "./trace_input.h"
+#include "./trace_reader.h"
+#include "./dict_trace.h"
 
 #if 0
 enum InstClass : uint8_t
@@ -169,8 +173,15 @@ enum Offset
 // For instance, for a multiply, two objects with same PC will be created through two subsequent calls to get_inst(). Each will have the same
 // inputs, but one will have the low part of the product as output, and one will have the high part of the product as output.
 // Other instructions subject to this are (list not exhaustive): load pair and vector inststructions.
-struct CVPTraceReader
+struct CVPTraceReader : public trace_reader_t
 {
+  // Operand storage is inline and sized for the largest record the format can encode (255 input and 255 SIMD
+  // output registers, plus the flag register added for CMPs and conditional branches), so decoding a record
+  // never touches the heap.
+  static constexpr size_t cMaxInRegs = 256;
+  static constexpr size_t cMaxOutRegs = 256;
+  static constexpr size_t cMaxOutRegsValues = 2 * cMaxOutRegs;
+
   struct Instr
   {
     uint64_t mPc;
@@ -180,10 +191,11 @@ struct CVPTraceReader
     uint64_t mEffAddr;
     uint8_t mMemSize; // In bytes
     uint8_t mNumInRegs;
-    std::vector<uint8_t> mInRegs;
+    uint8_t mInRegs[cMaxInRegs];
     uint8_t mNumOutRegs;
-    std::vector<uint8_t> mOutRegs;
-    std::vector<uint64_t> mOutRegsValues;
+    uint8_t mOutRegs[cMaxOutRegs];
+    uint16_t mNumOutRegsValues;
+    uint64_t mOutRegsValues[cMaxOutRegsValues];
 
     Instr()
     {
@@ -198,9 +210,7 @@ struct CVPTraceReader
       mType = undefInstClass;
       mTaken = false;
       mNumInRegs = mNumOutRegs = 0;
-      mInRegs.clear();
-      mOutRegs.clear();
-      mOutRegsValues.clear();
+      mNumOutRegsValues = 0;
     }
 
     void printInstr()
@@ -215,22 +225,22 @@ struct CVPTraceReader
         std::cout << " ( tkn:" << mTaken << " tar: 0x" << std::hex << mTarget << ") ";
 
       std::cout << std::dec << " InRegs : { ";
-      for(unsigned elt : mInRegs)
+      for(unsigned i = 0; i < mNumInRegs; i++)
       {
-        std::cout << elt << " ";
+        std::cout << (unsigned) mInRegs[i] << " ";
       }
       std::cout << " } OutRegs : { ";
-      for(unsigned i = 0, j = 0; i < mOutRegs.size(); i++)
+      for(unsigned i = 0, j = 0; i < mNumOutRegs; i++)
       {
         if(mOutRegs[i] >= Offset::vecOffset && mOutRegs[i] != Offset::ccOffset)
         {
-          assert(j+1 < mOutRegsValues.size());
+          assert(j+1 < mNumOutRegsValues);
           std::cout << std::dec << (unsigned) mOutRegs[i] << std::hex << " (hi:" << mOutRegsValues[j+1] << " lo:" << mOutRegsValues[j] << ") ";
           j += 2;
         }
         else
         {
-          assert(j < mOutRegsValues.size());
+          assert(j < mNumOutRegsValues);
           std::cout << std::dec << (unsigned) mOutRegs[i] << std::hex << " (" << mOutRegsValues[j++] << ") ";
         }
       }
@@ -239,7 +249,12 @@ struct CVPTraceReader
     }
   };
 
-  gz::igzstream * dpressed_input;
+  // Decompressed trace bytes; records are decoded in place from its buffer.
+  trace_input_t * dpressed_input;
+
+  // Largest possible trace record: PC, type, EA and size, taken and target, 255 input regs, 255 SIMD output regs.
+  static constexpr size_t cMaxRecordBytes = 8 + 1 + 8 + 1 + 1 + 8 + 1 + 255 + 1 + 255 + 255 * 16;
+  static_assert(cMaxRecordBytes <= MAX_TRACE_INPUT_NEED, "trace inputs cannot provide a whole record");
 
   // Buffer to hold trace instruction information
   Instr mInstr;
@@ -263,19 +278,45 @@ struct CVPTraceReader
   // Number of instructions processed so far.
   uint64_t nInstr;
 
+  // Print the number of instructions read when the reader is destroyed.
+  bool mPrintSummary;
+
+  // Raw bytes of the last record read, valid until the next call to readInstr() (see cvp_trace_writer_t).
+  // For dictionary traces, this is the dynamic record, not a CVP-1 record.
+  const uint8_t * mRecord;
+  size_t mRecordSize;
+
+  // Static instructions of a dictionary trace (see dict_trace.h), or nullptr for CVP-1 records.
+  const trace_dict_t * mDict;
+
   // This simply tracks how many lanes one SIMD register have been processed.
   // In this case, since SIMD is 128 bits and pieces output 64 bits, if it is pair and we are creating an instruction object from a trace instruction, this means that
   // the output of the instruction object will contain the low order bits of the SIMD register.
   // If it is odd, it means that it will contain the high order bits of the SIMD register.
   uint8_t start_fp_reg;
 
-  // Note that there is no check for trace existence, so modify to suit your needs.
-  CVPTraceReader(const char * trace_name)
+  // buffer_size is the size of the decompression buffer records are decoded from.
+  CVPTraceReader(const char * trace_name, size_t buffer_size = DEFAULT_TRACE_BUFFER_SIZE)
   {
-    dpressed_input = new gz::igzstream();
-    dpressed_input->open(trace_name, std::ios_base::in | std::ios_base::binary);
+    dpressed_input = new gz_input_t(trace_name, buffer_size);
+    mDict = dpressed_input->dictionary();
 
     mCrackRegIdx = mCrackValIdx = mRemainingPieces = mSizeFactor = nInstr = start_fp_reg =  0;
+    mPrintSummary = true;
+    mRecord = nullptr;
+    mRecordSize = 0;
+  }
+
+  // Reads records from an already opened input, which the reader takes ownership of.
+  CVPTraceReader(trace_input_t * input)
+  {
+    dpressed_input = input;
+    mDict = dpressed_input->dictionary();
+
+    mCrackRegIdx = mCrackValIdx = mRemainingPieces = mSizeFactor = nInstr = start_fp_reg =  0;
+    mPrintSummary = true;
+    mRecord = nullptr;
+    mRecordSize = 0;
   }
 
   ~CVPTraceReader()
@@ -283,7 +324,8 @@ struct CVPTraceReader
     if(dpressed_input)
       delete dpressed_input;
 
-    std::cout  << " Read " << nInstr << " instrs " << std::endl;
+    if(mPrintSummary)
+      std::cout  << " Read " << nInstr << " instrs " << std::endl;
   }
 
   // This is the main API function
@@ -305,6 +347,41 @@ struct CVPTraceReader
 
   }
 
+  // Allocation-free variant of get_inst(): pieces are written straight into the caller's storage.
+  size_t get_batch(db_t * out, size_t max)
+  {
+    size_t n = 0;
+    while(n < max && (mRemainingPieces || readInstr()))
+      populateInstr(&out[n++]);
+    return n;
+  }
+
+  uint64_t num_instr() const
+  {
+    return nInstr;
+  }
+
+  double fraction_read() const
+  {
+    return dpressed_input->fraction_read();
+  }
+
+  // Let the input jump as close as it can (e.g., with a gzip index), then decode forward without cracking.
+  bool seek(uint64_t instr)
+  {
+    nInstr = dpressed_input->seek_record(instr, nInstr);
+    while(nInstr < instr)
+    {
+      if(!readInstr())
+      {
+        mRemainingPieces = 0;
+        return false;
+      }
+    }
+    mRemainingPieces = 0;
+    return true;
+  }
+
   // Creates a new object and populate it with trace information.
   // Subsequent calls to populateNewInstr() will take care of creating multiple pieces for a trace instruction
   // that has several outputs or 128-bit output.
@@ -312,6 +389,14 @@ struct CVPTraceReader
   db_t *populateNewInstr()
   {
      db_t * inst = new db_t();
+     populateInstr(inst);
+     return inst;
+  }
+
+  // Populates an existing object with the next piece of the current trace instruction.
+  void populateInstr(db_t * inst)
+  {
+     *inst = db_t();
 
      inst->insn = mInstr.mType;
      inst->pc = mInstr.mPc;
@@ -320,7 +405,7 @@ struct CVPTraceReader
      if(mInstr.mNumInRegs >= 1)
      {
        inst->A.valid = true;
-       inst->A.is_int = mInstr.mInRegs.at(0) < Offset::vecOffset || mInstr.mInRegs[0] == Offset::ccOffset;
+       inst->A.is_int = mInstr.mInRegs[0] < Offset::vecOffset || mInstr.mInRegs[0] == Offset::ccOffset;
        inst->A.log_reg = mInstr.mInRegs[0];
        inst->A.value = 0xdeadbeef;
      }
@@ -330,7 +415,7 @@ struct CVPTraceReader
      if(mInstr.mNumInRegs >= 2)
      {
        inst->B.valid = true;
-       inst->B.is_int = mInstr.mInRegs.at(1) < Offset::vecOffset || mInstr.mInRegs[1] == Offset::ccOffset;
+       inst->B.is_int = mInstr.mInRegs[1] < Offset::vecOffset || mInstr.mInRegs[1] == Offset::ccOffset;
        inst->B.log_reg = mInstr.mInRegs[1];
        inst->B.value = 0xdeadbeef;
      }
@@ -340,7 +425,7 @@ struct CVPTraceReader
      if(mInstr.mNumInRegs >= 3)
      {
        inst->C.valid = true;
-       inst->C.is_int = mInstr.mInRegs.at(2) < Offset::vecOffset || mInstr.mInRegs[2] == Offset::ccOffset;
+       inst->C.is_int = mInstr.mInRegs[2] < Offset::vecOffset || mInstr.mInRegs[2] == Offset::ccOffset;
        inst->C.log_reg = mInstr.mInRegs[2];
        inst->C.value = 0xdeadbeef;
      }
@@ -354,9 +439,10 @@ struct CVPTraceReader
      {
        inst->D.valid = true;
        // Flag register is considered to be INT
-       inst->D.is_int = mInstr.mOutRegs.at(mCrackRegIdx) < Offset::vecOffset || mInstr.mOutRegs.at(mCrackRegIdx) == Offset::ccOffset;
+       assert(mCrackRegIdx < mInstr.mNumOutRegs && mCrackValIdx < mInstr.mNumOutRegsValues);
+       inst->D.is_int = mInstr.mOutRegs[mCrackRegIdx] < Offset::vecOffset || mInstr.mOutRegs[mCrackRegIdx] == Offset::ccOffset;
        inst->D.log_reg = mInstr.mOutRegs[mCrackRegIdx];
-       inst->D.value = mInstr.mOutRegsValues.at(mCrackValIdx);
+       inst->D.value = mInstr.mOutRegsValues[mCrackValIdx];
        // if SIMD register, we processed one more 64-bit lane.
        if(!inst->D.is_int)
          start_fp_reg++;
@@ -381,7 +467,7 @@ struct CVPTraceReader
      mRemainingPieces--;
 
      // If there are more output registers to be processed and they are SIMD
-     if(mInstr.mNumOutRegs > mCrackRegIdx && mInstr.mOutRegs.at(mCrackRegIdx) >= Offset::vecOffset && mInstr.mOutRegs[mCrackRegIdx] != Offset::ccOffset)
+     if(mInstr.mNumOutRegs > mCrackRegIdx && mInstr.mOutRegs[mCrackRegIdx] >= Offset::vecOffset && mInstr.mOutRegs[mCrackRegIdx] != Offset::ccOffset)
      {
        // Next output value is in the next 64-bit lane
        mCrackValIdx++;
@@ -395,14 +481,50 @@ struct CVPTraceReader
        mCrackValIdx++;
        mCrackRegIdx++;
      }
+  }
 
-     return inst;
+  // Returns the size in bytes of the trace record at p, or 0 if it does not fit within avail bytes.
+  static size_t recordSize(const uint8_t * p, size_t avail)
+  {
+    size_t size = sizeof(uint64_t) + 1;
+    if(avail < size)
+      return 0;
+
+    uint8_t type = p[sizeof(uint64_t)];
+    if(type == InstClass::loadInstClass || type == InstClass::storeInstClass)
+      size += sizeof(uint64_t) + 1;
+    if(type == InstClass::condBranchInstClass || type == InstClass::uncondDirectBranchInstClass || type == InstClass::uncondIndirectBranchInstClass)
+    {
+      if(avail < size + 1)
+        return 0;
+      size += (p[size] ? 1 + sizeof(uint64_t) : 1);
+    }
+
+    if(avail < size + 1)
+      return 0;
+    size += 1 + p[size];
+
+    if(avail < size + 1)
+      return 0;
+    uint8_t numOutRegs = p[size];
+    const uint8_t * outRegs = p + size + 1;
+    size += 1 + numOutRegs;
+    if(avail < size)
+      return 0;
+
+    for(auto i = 0; i != numOutRegs; i++)
+      size += (outRegs[i] >= Offset::vecOffset && outRegs[i] != Offset::ccOffset) ? 2 * sizeof(uint64_t) : sizeof(uint64_t);
+
+    return (avail < size) ? 0 : size;
   }
 
   // Read bytes from the trace and populate a buffer object.
   // Returns true if something was read from the trace, false if we the trace is over.
   bool readInstr()
   {
+    if(mDict)
+      return readDictInstr();
+
     // Trace Format :
     // Inst PC 				- 8 bytes
     // Inst Type			- 1 byte
@@ -422,66 +544,142 @@ struct CVPTraceReader
     //   If SIMD (32 to 63)		- 16 bytes each
     mInstr.reset();
     start_fp_reg = 0;
-    dpressed_input->read((char*) &mInstr.mPc, sizeof(mInstr.mPc));
 
-    if(dpressed_input->eof())
+    size_t avail = dpressed_input->ensure(cMaxRecordBytes);
+    const uint8_t * p = dpressed_input->data();
+
+    // Near the end of the trace, make sure the whole record is there before decoding it.
+    if(avail < cMaxRecordBytes && recordSize(p, avail) == 0)
       return false;
 
+    const uint8_t * start = p;
+
     mRemainingPieces = 1;
     mSizeFactor = 1;
     mCrackRegIdx = 0;
     mCrackValIdx = 0;
 
+    std::memcpy(&mInstr.mPc, p, sizeof(mInstr.mPc));
+    p += sizeof(mInstr.mPc);
     mInstr.mTarget = mInstr.mPc + 4;
-    dpressed_input->read((char*) &mInstr.mType, sizeof(mInstr.mType));
+    mInstr.mType = *p++;
 
     assert(mInstr.mType != undefInstClass);
 
     if(mInstr.mType == InstClass::loadInstClass || mInstr.mType == InstClass::storeInstClass)
     {
-      dpressed_input->read((char*) &mInstr.mEffAddr, sizeof(mInstr.mEffAddr));
-      dpressed_input->read((char*) &mInstr.mMemSize, sizeof(mInstr.mMemSize));
+      std::memcpy(&mInstr.mEffAddr, p, sizeof(mInstr.mEffAddr));
+      p += sizeof(mInstr.mEffAddr);
+      mInstr.mMemSize = *p++;
     }
     if(mInstr.mType == InstClass::condBranchInstClass || mInstr.mType == InstClass::uncondDirectBranchInstClass || mInstr.mType == InstClass::uncondIndirectBranchInstClass)
     {
-      dpressed_input->read((char*) &mInstr.mTaken, sizeof(mInstr.mTaken));
+      mInstr.mTaken = *p++;
       if(mInstr.mTaken)
-        dpressed_input->read((char*) &mInstr.mTarget, sizeof(mInstr.mTarget));
+      {
+        std::memcpy(&mInstr.mTarget, p, sizeof(mInstr.mTarget));
+        p += sizeof(mInstr.mTarget);
+      }
     }
 
-    dpressed_input->read((char*) &mInstr.mNumInRegs, sizeof(mInstr.mNumInRegs));
+    mInstr.mNumInRegs = *p++;
+    std::memcpy(mInstr.mInRegs, p, mInstr.mNumInRegs);
+    p += mInstr.mNumInRegs;
+
+    mInstr.mNumOutRegs = *p++;
+    std::memcpy(mInstr.mOutRegs, p, mInstr.mNumOutRegs);
+    p += mInstr.mNumOutRegs;
+
+    readValues(start, p);
+    return true;
+  }
+
+  // Same as readInstr(), for the dynamic records of a dictionary trace: the static fields come from mDict.
+  bool readDictInstr()
+  {
+    mInstr.reset();
+    start_fp_reg = 0;
+
+    size_t avail = dpressed_input->ensure(cMaxRecordBytes);
+    const uint8_t * p = dpressed_input->data();
+
+    // Also rejects records that refer to no static instruction.
+    if(dict_record_size(*mDict, p, avail) == 0)
+      return false;
+
+    const uint8_t * start = p;
+
+    mRemainingPieces = 1;
+    mSizeFactor = 1;
+    mCrackRegIdx = 0;
+    mCrackValIdx = 0;
 
-    for(auto i = 0; i != mInstr.mNumInRegs; i++)
+    uint32_t index = 0;
+    for(unsigned shift = 0; ; shift += 7)
     {
-      uint8_t inReg;
-      dpressed_input->read((char*) &inReg, sizeof(inReg));
-      mInstr.mInRegs.push_back(inReg);
+      uint8_t b = *p++;
+      index |= (uint32_t)(b & 0x7f) << shift;
+      if(!(b & 0x80))
+        break;
     }
+    const trace_dict_t::instr_t & s = mDict->instrs[index];
 
-    dpressed_input->read((char*) &mInstr.mNumOutRegs, sizeof(mInstr.mNumOutRegs));
-
-    mRemainingPieces = std::max(mRemainingPieces, mInstr.mNumOutRegs);
+    mInstr.mPc = s.pc;
+    mInstr.mTarget = mInstr.mPc + 4;
+    mInstr.mType = s.type;
 
-    for(auto i = 0; i != mInstr.mNumOutRegs; i++)
+    if(s.flags & DICT_MEM)
+    {
+      std::memcpy(&mInstr.mEffAddr, p, sizeof(mInstr.mEffAddr));
+      p += sizeof(mInstr.mEffAddr);
+      mInstr.mMemSize = s.mem_size;
+    }
+    if(s.flags & DICT_BRANCH)
     {
-      uint8_t outReg;
-      dpressed_input->read((char*) &outReg, sizeof(outReg));
-      mInstr.mOutRegs.push_back(outReg);
+      mInstr.mTaken = *p++;
+      if(mInstr.mTaken)
+      {
+        std::memcpy(&mInstr.mTarget, p, sizeof(mInstr.mTarget));
+        p += sizeof(mInstr.mTarget);
+      }
     }
 
+    const uint8_t * regs = &mDict->regs[s.regs];
+    mInstr.mNumInRegs = s.num_in;
+    std::memcpy(mInstr.mInRegs, regs, s.num_in);
+    mInstr.mNumOutRegs = s.num_out;
+    std::memcpy(mInstr.mOutRegs, regs + s.num_in, s.num_out);
+
+    readValues(start, p);
+    return true;
+  }
+
+  // Reads the output values at p, which end the record that starts at start, and finishes decoding the instruction.
+  void readValues(const uint8_t * start, const uint8_t * p)
+  {
+    mRemainingPieces = std::max(mRemainingPieces, mInstr.mNumOutRegs);
+
+    uint16_t numValues = 0;
     for(auto i = 0; i != mInstr.mNumOutRegs; i++)
     {
       uint64_t val;
-      dpressed_input->read((char*) &val, sizeof(val));
-      mInstr.mOutRegsValues.push_back(val);
+      std::memcpy(&val, p, sizeof(val));
+      p += sizeof(val);
+      mInstr.mOutRegsValues[numValues++] = val;
       if(mInstr.mOutRegs[i] >= Offset::vecOffset && mInstr.mOutRegs[i] != Offset::ccOffset)
       {
-        dpressed_input->read((char*) &val, sizeof(val));
-        mInstr.mOutRegsValues.push_back(val);
+        std::memcpy(&val, p, sizeof(val));
+        p += sizeof(val);
+        mInstr.mOutRegsValues[numValues++] = val;
         if(val != 0)
           mRemainingPieces++;
       }
     }
+    mInstr.mNumOutRegsValues = numValues;
+
+    mRecord = start;
+    mRecordSize = p - start;
+    dpressed_input->consume(p - start);
 
     // Memsize has to be adjusted as it is giving only the access size for one register.
     mInstr.mMemSize = mInstr.mMemSize * std::max(1lu, (long unsigned) mInstr.mNumOutRegs);
@@ -489,24 +687,17 @@ struct CVPTraceReader
 
     // Trace INT instructions with 0 outputs are generally CMP, so we mark them as producing the flag register
     // The trace does not have the value of the flag register, though
-    if(mInstr.mType == aluInstClass && mInstr.mOutRegs.size() == 0)
+    if(mInstr.mType == aluInstClass && mInstr.mNumOutRegs == 0)
     {
-      mInstr.mOutRegs.push_back(Offset::ccOffset);
-      mInstr.mOutRegsValues.push_back(0xdeadbeef);
-      mInstr.mNumOutRegs++;
+      mInstr.mOutRegs[mInstr.mNumOutRegs++] = Offset::ccOffset;
+      mInstr.mOutRegsValues[mInstr.mNumOutRegsValues++] = 0xdeadbeef;
     }
-    else if(mInstr.mType == condBranchInstClass && mInstr.mInRegs.size() == 0)
+    else if(mInstr.mType == condBranchInstClass && mInstr.mNumInRegs == 0)
     {
-      mInstr.mInRegs.push_back(Offset::ccOffset);
-      mInstr.mNumInRegs++;
+      mInstr.mInRegs[mInstr.mNumInRegs++] = Offset::ccOffset;
     }
 
     nInstr++;
-
-    if(nInstr % 100000 == 0)
-      std::cout << nInstr << " instrs " << std::endl;
-
-    return true;
   }
 };
 
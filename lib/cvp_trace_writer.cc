@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "cvp_trace_writer.h"
+
+#define TRACE_WRITE_BUFFER_SIZE	(1 << 20)
+
+cvp_trace_writer_t::cvp_trace_writer_t(const char *name, int level) : name(name), tmp(std::string(name) + ".tmp") {
+   gz = NULL;
+   fp = NULL;
+   num_instr = 0;
+   ok = true;
+
+   size_t len = strlen(name);
+   if ((len >= 3) && !strcmp(name + len - 3, ".gz")) {
+      char mode[8];
+      snprintf(mode, sizeof(mode), "wb%d", level);
+      gz = gzopen(tmp.c_str(), mode);
+      if (gz)
+         gzbuffer(gz, TRACE_WRITE_BUFFER_SIZE);
+   }
+   else {
+      fp = fopen(tmp.c_str(), "wb");
+      if (fp)
+         setvbuf(fp, NULL, _IOFBF, TRACE_WRITE_BUFFER_SIZE);
+   }
+
+   if (!gz && !fp) {
+      fprintf(stderr, "Cannot create trace %s\n", tmp.c_str());
+      exit(1);
+   }
+}
+
+cvp_trace_writer_t::~cvp_trace_writer_t() {
+   if (gz || fp) {
+      ok = false;
+      close();
+   }
+}
+
+void cvp_trace_writer_t::write_record(const uint8_t *record, size_t size) {
+   if (gz)
+      ok = ok && (gzwrite(gz, record, size) == (int)size);
+   else if (fp)
+      ok = ok && (fwrite(record, 1, size, fp) == size);
+   num_instr++;
+}
+
+void cvp_trace_writer_t::write_instr(const CVPTraceReader &reader) {
+   write_record(reader.mRecord, reader.mRecordSize);
+}
+
+bool cvp_trace_writer_t::close() {
+   if (!gz && !fp)
+      return(ok);
+   if (gz)
+      ok = ((gzclose(gz) == Z_OK) && ok);
+   if (fp)
+      ok = ((fclose(fp) == 0) && ok);
+   gz = NULL;
+   fp = NULL;
+   ok = (ok && (rename(tmp.c_str(), name.c_str()) == 0));
+   if (!ok)
+      remove(tmp.c_str());
+   return(ok);
+}
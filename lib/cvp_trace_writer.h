@@ -0,0 +1,48 @@
+#pragma once
+
+// Writes traces in the CVP-1 record format read by CVPTraceReader.
+//
+// Records are copied byte for byte from a reader (the reader's fix-ups, such
+// as the flag register added to CMPs, are not part of the record), so a trace
+// written from another one is bit-exact with it and readable by any CVP-1
+// tool. Records are independent of each other: any subsequence of records, or
+// concatenation of subsequences, is a valid trace. The output is
+// gzip-compressed if its name ends in ".gz". It is written next to its name,
+// as <name>.tmp, and renamed by close(): an existing trace is only replaced by
+// a complete one.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <zlib.h>
+#include <string>
+
+struct CVPTraceReader;
+
+class cvp_trace_writer_t {
+private:
+   std::string name;
+   std::string tmp;	// name + ".tmp", written until close()
+   gzFile gz;	// gzip output, or NULL
+   FILE *fp;	// uncompressed output, or NULL
+   uint64_t num_instr;
+   bool ok;
+
+public:
+   // level: gzip compression level (ignored for uncompressed output).
+   cvp_trace_writer_t(const char *name, int level = 6);
+   // Discards the output if close() was not called.
+   ~cvp_trace_writer_t();
+
+   // Appends one raw trace record.
+   void write_record(const uint8_t *record, size_t size);
+
+   // Appends the record the reader last read with readInstr().
+   void write_instr(const CVPTraceReader &reader);
+
+   uint64_t get_num_instr() const { return num_instr; }
+
+   // Flushes and closes the output and renames it to its name. Returns false if anything could not be
+   // written; the output is then discarded.
+   bool close();
+};
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <zlib.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "trace_reader.h"
+#include "dict_trace.h"
+
+static inline bool is_mem(uint8_t type) {
+   return((type == InstClass::loadInstClass) || (type == InstClass::storeInstClass));
+}
+
+static inline bool is_branch(uint8_t type) {
+   return((type == InstClass::condBranchInstClass) || (type == InstClass::uncondDirectBranchInstClass) || (type == InstClass::uncondIndirectBranchInstClass));
+}
+
+bool is_dict_trace(const char *name) {
+   char magic[sizeof(((dict_trace_header_t *)0)->magic)];
+   FILE *fp = fopen(name, "rb");
+   if (!fp)
+      return(false);
+   bool dict = ((fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) && !memcmp(magic, DICT_TRACE_MAGIC, sizeof(magic)));
+   fclose(fp);
+   return(dict);
+}
+
+// Appends the dynamic record of CVP-1 record p to out, adding its static instruction to the dictionary if it is new.
+static void dict_encode(const uint8_t *p, size_t size, std::unordered_map<std::string, uint32_t> &index,
+                        std::vector<uint8_t> &dict, std::vector<uint8_t> &out) {
+   const uint8_t *end = p + size;
+   uint8_t type = p[8];
+   const uint8_t *q = p + 9;
+
+   // Static fields, in dictionary order: PC, type, access size, registers.
+   std::string key((const char *)p, 9);
+   const uint8_t *addr = NULL;
+   if (is_mem(type)) {
+      addr = q;
+      key.push_back((char)q[8]);
+      q += 9;
+   }
+   else {
+      key.push_back(0);
+   }
+   const uint8_t *branch = q;
+   if (is_branch(type))
+      q += (*q ? 1 + sizeof(uint64_t) : 1);
+   const uint8_t *regs = q;
+   q += 1 + q[0];
+   q += 1 + q[0];
+   key.append((const char *)regs, q - regs);
+
+   auto it = index.find(key);
+   uint32_t i;
+   if (it == index.end()) {
+      i = index.size();
+      index.emplace(key, i);
+      dict.insert(dict.end(), key.begin(), key.end());
+   }
+   else {
+      i = it->second;
+   }
+
+   while (i >= 0x80) {
+      out.push_back((uint8_t)(i | 0x80));
+      i >>= 7;
+   }
+   out.push_back((uint8_t)i);
+   if (addr)
+      out.insert(out.end(), addr, addr + sizeof(uint64_t));
+   out.insert(out.end(), branch, regs);
+   out.insert(out.end(), q, end);	// output values
+}
+
+bool dict_trace_pack(const char *in_name, const char *out_name, size_t block_size, int level) {
+   // Blocks must be able to feed the reader a whole record without help from the next block.
+   block_size = std::max(block_size, MAX_TRACE_INPUT_NEED);
+
+   trace_input_t *input = open_trace_input(in_name);
+   if (!input)
+      return(false);
+   FILE *fp = fopen(out_name, "wb");
+   if (!fp) {
+      delete input;
+      return(false);
+   }
+
+   dict_trace_header_t header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, DICT_TRACE_MAGIC, sizeof(header.magic));
+   header.version = DICT_TRACE_VERSION;
+   header.entry_size = sizeof(block_trace_entry_t);
+   bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);	// written again once complete
+
+   std::unordered_map<std::string, uint32_t> index;
+   std::vector<uint8_t> dict;
+   std::vector<block_trace_entry_t> table;
+   std::vector<uint8_t> raw, packed;
+   block_trace_entry_t e;
+   uint64_t offset = sizeof(header);
+
+   while (ok) {
+      size_t avail = input->ensure(MAX_TRACE_INPUT_NEED);
+      size_t size = CVPTraceReader::recordSize(input->data(), avail);
+      if (size != 0) {
+         if (raw.empty())
+            e.first_instr = header.num_instr;
+         dict_encode(input->data(), size, index, dict, raw);
+         input->consume(size);
+         header.num_instr++;
+      }
+
+      // Compress a full block, or the last one (a truncated last record is dropped).
+      if ((raw.size() >= block_size) || ((size == 0) && !raw.empty())) {
+         uLongf packed_size = compressBound(raw.size());
+         packed.resize(packed_size);
+         ok = ok && (compress2(packed.data(), &packed_size, raw.data(), raw.size(), level) == Z_OK);
+         ok = ok && (fwrite(packed.data(), 1, packed_size, fp) == packed_size);
+         e.offset = offset;
+         e.compressed_size = packed_size;
+         e.size = raw.size();
+         offset += packed_size;
+         header.max_block_size = std::max(header.max_block_size, (uint64_t)e.size);
+         table.push_back(e);
+         raw.clear();
+      }
+      if (size == 0)
+         break;
+   }
+
+   delete input;
+
+   header.num_static = index.size();
+   header.dict_offset = offset;
+   header.dict_size = dict.size();
+   ok = ok && (fwrite(dict.data(), 1, dict.size(), fp) == dict.size());
+   offset += dict.size();
+   header.num_blocks = table.size();
+   header.table_offset = offset;
+   ok = ok && (fwrite(table.data(), sizeof(block_trace_entry_t), table.size(), fp) == table.size());
+   ok = ok && !fseek(fp, 0, SEEK_SET) && (fwrite(&header, sizeof(header), 1, fp) == 1);
+   return((fclose(fp) == 0) && ok);
+}
+
+dict_input_t::dict_input_t(const char *name, unsigned threads) {
+   dict_trace_header_t header;
+   fd = open(name, O_RDONLY);
+   if (fd < 0) {
+      fprintf(stderr, "Cannot open trace %s\n", name);
+      exit(1);
+   }
+   if ((pread(fd, &header, sizeof(header), 0) != sizeof(header)) ||
+       memcmp(header.magic, DICT_TRACE_MAGIC, sizeof(header.magic)) ||
+       (header.version != DICT_TRACE_VERSION) ||
+       (header.entry_size != sizeof(block_trace_entry_t))) {
+      fprintf(stderr, "Invalid dictionary trace %s\n", name);
+      exit(1);
+   }
+
+   table.resize(header.num_blocks);
+   size_t table_size = header.num_blocks * sizeof(block_trace_entry_t);
+   std::vector<uint8_t> bytes(header.dict_size);
+   if ((pread(fd, table.data(), table_size, header.table_offset) != (ssize_t)table_size) ||
+       (pread(fd, bytes.data(), bytes.size(), header.dict_offset) != (ssize_t)bytes.size())) {
+      fprintf(stderr, "Truncated dictionary trace %s\n", name);
+      exit(1);
+   }
+
+   // Unpack the static instructions; the registers of all of them go in dict.regs.
+   dict.instrs.resize(header.num_static);
+   dict.regs.reserve(bytes.size());
+   size_t pos = 0;
+   size_t n;
+   for (n = 0; n < dict.instrs.size(); n++) {
+      trace_dict_t::instr_t &s = dict.instrs[n];
+      if ((pos + 11 > bytes.size()) || (bytes[pos + 8] >= InstClass::undefInstClass))
+         break;
+      memcpy(&s.pc, &bytes[pos], sizeof(s.pc));
+      s.type = bytes[pos + 8];
+      s.mem_size = bytes[pos + 9];
+      s.num_in = bytes[pos + 10];
+      pos += 11;
+      if (pos + s.num_in + 1 > bytes.size())
+         break;
+      s.regs = dict.regs.size();
+      dict.regs.insert(dict.regs.end(), bytes.data() + pos, bytes.data() + pos + s.num_in);
+      pos += s.num_in;
+      s.num_out = bytes[pos++];
+      if (pos + s.num_out > bytes.size())
+         break;
+      dict.regs.insert(dict.regs.end(), bytes.data() + pos, bytes.data() + pos + s.num_out);
+      pos += s.num_out;
+
+      s.flags = ((is_mem(s.type) ? DICT_MEM : 0) | (is_branch(s.type) ? DICT_BRANCH : 0));
+      s.num_values = 0;
+      for (unsigned i = 0; i < s.num_out; i++) {
+         uint8_t reg = dict.regs[s.regs + s.num_in + i];
+         s.num_values += (((reg >= Offset::vecOffset) && (reg != Offset::ccOffset)) ? 2 : 1);
+      }
+   }
+   if ((n != dict.instrs.size()) || (pos != bytes.size())) {
+      fprintf(stderr, "Corrupt dictionary in trace %s\n", name);
+      exit(1);
+   }
+
+   start(header.max_block_size, threads);
+}
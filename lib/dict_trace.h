@@ -0,0 +1,115 @@
+#pragma once
+
+// Dictionary trace format: CVP-1 records with their static fields factored out.
+//
+// A CVP-1 record repeats the instruction class, access size and register
+// names of its static instruction every time it executes. A dictionary trace
+// stores each distinct static instruction once, in a table at the end of the
+// file, and dynamic records that hold only an index into that table plus the
+// truly dynamic fields: effective address, taken flag and target, and output
+// values. CVPTraceReader copies the static fields from the dictionary instead
+// of parsing them, so there is less to inflate and parse per instruction.
+//
+// Dynamic records are cut into blocks compressed independently, laid out like
+// a block trace (block_trace_entry_t), and decompressed on a pool of worker
+// threads by dict_input_t. Use cvp-convert -f dict to produce dictionary traces.
+//
+// Dynamic record:
+//   Static instruction index	- LEB128 varint
+//   If load/store
+//     Effective Address	- 8 bytes
+//   If branch
+//     Taken			- 1 byte
+//     If Taken
+//       Target			- 8 bytes
+//   Output Reg Values		- as in CVP-1 records
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+#include "block_trace.h"
+
+#define DICT_TRACE_MAGIC	"CVPDICTS"
+#define DICT_TRACE_VERSION	1
+
+struct dict_trace_header_t {
+   char magic[8];		// DICT_TRACE_MAGIC, not null-terminated
+   uint32_t version;		// DICT_TRACE_VERSION
+   uint32_t entry_size;		// sizeof(block_trace_entry_t)
+   uint64_t num_blocks;
+   uint64_t num_instr;		// trace instructions in all blocks
+   uint64_t table_offset;	// file offset of the block table
+   uint64_t max_block_size;	// largest uncompressed block
+   uint64_t dict_offset;	// file offset of the dictionary
+   uint32_t dict_size;		// bytes
+   uint32_t num_static;		// static instructions in the dictionary
+};
+
+static_assert(sizeof(dict_trace_header_t) == 64, "dictionary trace header layout changed");
+
+// trace_dict_t::instr_t::flags
+#define DICT_MEM	(1 << 0)	// load/store: the record has an effective address
+#define DICT_BRANCH	(1 << 1)	// branch: the record has a taken flag
+
+// Static instructions of a dictionary trace.
+// In the file, each one is: PC (8 bytes), type, access size, number of input regs, input regs, number of output regs, output regs.
+struct trace_dict_t {
+   struct instr_t {
+      uint64_t pc;
+      uint8_t type;
+      uint8_t mem_size;
+      uint8_t num_in;
+      uint8_t num_out;
+      uint8_t flags;
+      uint16_t num_values;	// 64-bit output values in each record
+      uint32_t regs;		// offset of the input regs, followed by the output regs, in trace_dict_t::regs
+   };
+
+   std::vector<instr_t> instrs;
+   std::vector<uint8_t> regs;
+};
+
+// Size of the dynamic record at p, or 0 if it does not fit within avail bytes or refers to no static instruction.
+inline size_t dict_record_size(const trace_dict_t &dict, const uint8_t *p, size_t avail) {
+   uint64_t index = 0;
+   size_t size = 0;
+   for (unsigned shift = 0; ; shift += 7) {
+      if ((size == avail) || (shift >= 32))
+         return(0);
+      uint8_t b = p[size++];
+      index |= ((uint64_t)(b & 0x7f) << shift);
+      if (!(b & 0x80))
+         break;
+   }
+   if (index >= dict.instrs.size())
+      return(0);
+
+   const trace_dict_t::instr_t &s = dict.instrs[index];
+   if (s.flags & DICT_MEM)
+      size += sizeof(uint64_t);
+   if (s.flags & DICT_BRANCH) {
+      if (size >= avail)
+         return(0);
+      size += (p[size] ? 1 + sizeof(uint64_t) : 1);
+   }
+   size += s.num_values * sizeof(uint64_t);
+   return((size > avail) ? 0 : size);
+}
+
+// Returns true if the file starts with the dictionary trace magic.
+bool is_dict_trace(const char *name);
+
+// Converts a CVP-1 trace (any format open_trace_input() reads) into a dictionary trace.
+bool dict_trace_pack(const char *in_name, const char *out_name,
+                     size_t block_size = DEFAULT_TRACE_BLOCK_SIZE, int level = 6);
+
+// Decompresses the dynamic records of a dictionary trace; the reader decodes them with dictionary().
+class dict_input_t : public block_input_t {
+private:
+   trace_dict_t dict;
+
+public:
+   dict_input_t(const char *name, unsigned threads = 0);
+
+   const trace_dict_t *dictionary() const { return &dict; }
+};
@@ -53,6 +53,7 @@ fifo_t<T>::fifo_t(uint64_t size) {
 
 template <class T>
 fifo_t<T>::~fifo_t() {
+   delete [] q;
 }
 
 template <class T>
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "trace_input.h"
+#include "gz_index.h"
+
+struct gz_index_header_t {
+   char magic[8];		// GZ_INDEX_MAGIC, not null-terminated
+   uint32_t version;		// GZ_INDEX_VERSION
+   uint32_t point_size;		// sizeof(gz_index_point_t)
+   uint64_t span;
+   uint64_t trace_size;
+   uint64_t num_points;
+   uint8_t reserved[24];
+};
+
+static_assert(sizeof(gz_index_header_t) == 64, "gzip index header layout changed");
+
+gz_index_t::gz_index_t() : span(0), trace_size(0), num_tagged(0), fd(-1) {
+}
+
+gz_index_t::~gz_index_t() {
+   if (fd >= 0)
+      close(fd);
+}
+
+void gz_index_t::start(uint64_t span, uint64_t trace_size) {
+   // A point is only useful if there is a full dictionary behind it.
+   this->span = ((span < GZ_INDEX_WINDOW) ? GZ_INDEX_WINDOW : span);
+   this->trace_size = trace_size;
+   points.clear();
+   windows.clear();
+   num_tagged = 0;
+}
+
+void gz_index_t::add_point(uint64_t in_offset, uint32_t bits, uint64_t out_offset, const uint8_t *window, uint32_t window_size) {
+   assert(window_size <= GZ_INDEX_WINDOW);
+   gz_index_point_t p;
+   p.in_offset = in_offset;
+   p.out_offset = out_offset;
+   p.instr = 0;
+   p.instr_offset = 0;
+   p.bits = bits;
+   p.window_size = window_size;
+   points.push_back(p);
+
+   windows.resize(points.size() * GZ_INDEX_WINDOW);
+   memcpy(&windows[(points.size() - 1) * GZ_INDEX_WINDOW], window, window_size);
+}
+
+void gz_index_t::tag(uint64_t instr, uint64_t instr_offset) {
+   while ((num_tagged < points.size()) && (points[num_tagged].out_offset <= instr_offset)) {
+      points[num_tagged].instr = instr;
+      points[num_tagged].instr_offset = instr_offset;
+      num_tagged++;
+   }
+}
+
+bool gz_index_t::save(const char *name) {
+   FILE *fp = fopen(name, "wb");
+   if (!fp)
+      return(false);
+
+   gz_index_header_t header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, GZ_INDEX_MAGIC, sizeof(header.magic));
+   header.version = GZ_INDEX_VERSION;
+   header.point_size = sizeof(gz_index_point_t);
+   header.span = span;
+   header.trace_size = trace_size;
+   header.num_points = num_tagged;	// untagged points are past the last record
+
+   bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+   ok = ok && (fwrite(points.data(), sizeof(gz_index_point_t), num_tagged, fp) == num_tagged);
+   ok = ok && (fwrite(windows.data(), GZ_INDEX_WINDOW, num_tagged, fp) == num_tagged);
+   return((fclose(fp) == 0) && ok);
+}
+
+bool gz_index_t::load(const char *name, uint64_t trace_size) {
+   gz_index_header_t header;
+   fd = open(name, O_RDONLY);
+   if (fd < 0)
+      return(false);
+
+   if ((pread(fd, &header, sizeof(header), 0) != sizeof(header)) ||
+       memcmp(header.magic, GZ_INDEX_MAGIC, sizeof(header.magic)) ||
+       (header.version != GZ_INDEX_VERSION) ||
+       (header.point_size != sizeof(gz_index_point_t)) ||
+       (header.trace_size != trace_size)) {
+      fprintf(stderr, "Ignoring invalid or stale trace index %s\n", name);
+      close(fd);
+      fd = -1;
+      return(false);
+   }
+
+   span = header.span;
+   this->trace_size = trace_size;
+   points.resize(header.num_points);
+   size_t table_size = header.num_points * sizeof(gz_index_point_t);
+   if (pread(fd, points.data(), table_size, sizeof(header)) != (ssize_t)table_size) {
+      fprintf(stderr, "Ignoring truncated trace index %s\n", name);
+      points.clear();
+      close(fd);
+      fd = -1;
+      return(false);
+   }
+   num_tagged = points.size();
+   return(true);
+}
+
+const gz_index_point_t *gz_index_t::find(uint64_t instr) const {
+   auto it = std::upper_bound(points.begin(), points.begin() + num_tagged, instr,
+                              [](uint64_t i, const gz_index_point_t &p) { return i < p.instr; });
+   return((it == points.begin()) ? NULL : &*(it - 1));
+}
+
+bool gz_index_t::read_window(const gz_index_point_t *p, uint8_t *window) const {
+   size_t i = p - points.data();
+   if (fd < 0) {
+      memcpy(window, &windows[i * GZ_INDEX_WINDOW], GZ_INDEX_WINDOW);
+      return(true);
+   }
+   off_t offset = sizeof(gz_index_header_t) + (num_tagged * sizeof(gz_index_point_t)) + (i * GZ_INDEX_WINDOW);
+   return(pread(fd, window, GZ_INDEX_WINDOW, offset) == GZ_INDEX_WINDOW);
+}
+
+bool gz_index_build(const char *trace_name, uint64_t span) {
+   struct stat st;
+   if (stat(trace_name, &st))
+      return(false);
+
+   gz_index_t index;
+   index.start(span, st.st_size);
+
+   // The input records inflate checkpoints, the reader supplies the record boundaries to tag them with.
+   gz_input_t *input = new gz_input_t(trace_name);
+   input->record_index(&index);
+   CVPTraceReader reader(input);
+   do {
+      index.tag(reader.nInstr, input->offset());
+   } while (reader.readInstr());
+
+   std::string index_name = std::string(trace_name) + GZ_INDEX_SUFFIX;
+   return(index.save(index_name.c_str()));
+}
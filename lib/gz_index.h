@@ -0,0 +1,69 @@
+#pragma once
+
+// Random-access index for gzip-compressed traces.
+//
+// gzip cannot be entered in the middle: inflating from a given point needs the
+// bit position within the compressed stream and the last 32 KB of output (the
+// inflate dictionary). Like zlib's zran example, the index records this state
+// at deflate block boundaries every "span" bytes of output. Each point is also
+// tagged with the first trace record that starts at or after it, so that a
+// reader can restart inflation close to any trace instruction and decode only
+// the few records in between.
+//
+// The index lives next to the trace, in <trace>.idx, and is built in one pass
+// with cvp-index. It covers the first gzip member of the trace.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+
+#define GZ_INDEX_MAGIC		"CVPGZIDX"
+#define GZ_INDEX_VERSION	1
+#define GZ_INDEX_WINDOW		32768
+#define GZ_INDEX_SUFFIX		".idx"
+#define DEFAULT_GZ_INDEX_SPAN	(4 << 20)
+
+struct gz_index_point_t {
+   uint64_t in_offset;		// offset in the compressed file of the first byte after the block boundary
+   uint64_t out_offset;		// decompressed offset of the block boundary
+   uint64_t instr;		// number of the first trace record starting at or after out_offset
+   uint64_t instr_offset;	// decompressed offset of that record
+   uint32_t bits;		// number of bits of the byte before in_offset that belong to the next block
+   uint32_t window_size;	// bytes of inflate dictionary stored for this point
+};
+
+class gz_index_t {
+private:
+   std::vector<gz_index_point_t> points;
+   uint64_t span;
+   uint64_t trace_size;		// compressed size of the indexed trace, to detect stale indexes
+   uint64_t num_tagged;		// points [0, num_tagged) are tagged with a trace record
+
+   // Dictionaries: kept in memory while building, read on demand from the file after load().
+   std::vector<uint8_t> windows;
+   int fd;
+
+public:
+   gz_index_t();
+   ~gz_index_t();
+
+   // Building.
+   void start(uint64_t span, uint64_t trace_size);
+   uint64_t get_span() const { return span; }
+   uint64_t last_out_offset() const { return (points.empty() ? 0 : points.back().out_offset); }
+   void add_point(uint64_t in_offset, uint32_t bits, uint64_t out_offset, const uint8_t *window, uint32_t window_size);
+   // Called with each trace record in order: tags pending points that the record starts at or after.
+   void tag(uint64_t instr, uint64_t instr_offset);
+   bool save(const char *name);
+
+   // Using.
+   bool load(const char *name, uint64_t trace_size);
+   // Returns the last point at or before trace record "instr", or NULL if there is none.
+   const gz_index_point_t *find(uint64_t instr) const;
+   // Reads the dictionary of a point into window (GZ_INDEX_WINDOW bytes).
+   bool read_window(const gz_index_point_t *p, uint8_t *window) const;
+   size_t size() const { return num_tagged; }
+};
+
+// Builds <trace_name>.idx in one pass over the trace. Returns false on error.
+bool gz_index_build(const char *trace_name, uint64_t span = DEFAULT_GZ_INDEX_SPAN);
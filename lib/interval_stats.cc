@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <assert.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "fifo.h"
+#include "cache.h"
+#include "bp.h"
+#include "resource_schedule.h"
+#include "uarchsim.h"
+#include "interval_stats.h"
+
+interval_stats_t::interval_stats_t(FILE *fp, uint64_t interval_size, const sim_results_t &start)
+   : fp(fp), interval_size(interval_size) {
+   assert(interval_size);
+   last = new sim_results_t(start);
+   next = (((start.instructions / interval_size) + 1) * interval_size);
+   fprintf(fp, "instructions,interval_instructions,interval_cycles,ipc,branch_mpki,ic_mpki,l1_mpki,l2_mpki,l3_mpki,prefetches,vp_coverage,vp_accuracy,vp_squashes");
+   for (int i = 0; i < NUM_CPI_CAUSES; i++)
+      fprintf(fp, ",cpi_%s", cpi_cause_names[i]);
+   fprintf(fp, ",cpi_in_flight\n");
+}
+
+interval_stats_t::~interval_stats_t() {
+   delete last;
+}
+
+void interval_stats_t::record(const sim_results_t &now) {
+   uint64_t instructions = (now.instructions - last->instructions);
+   uint64_t cycles = (now.cycles - last->cycles);
+   uint64_t eligible = (now.vp_eligible - last->vp_eligible);
+   uint64_t correct = (now.vp_correct - last->vp_correct);
+   uint64_t incorrect = (now.vp_incorrect - last->vp_incorrect);
+   double kilo = ((double)instructions / 1000.0);
+   auto mpki = [&](uint64_t misses) { return(instructions ? ((double)misses / kilo) : 0.0); };
+
+   fprintf(fp, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%" PRIu64 ",%.4f,%.4f,%" PRIu64,
+           now.instructions, instructions, cycles,
+           (cycles ? ((double)instructions / (double)cycles) : 0.0),
+           mpki(now.branch_mispredictions - last->branch_mispredictions),
+           mpki(now.ic_misses - last->ic_misses),
+           mpki(now.l1_misses - last->l1_misses),
+           mpki(now.l2_misses - last->l2_misses),
+           mpki(now.l3_misses - last->l3_misses),
+           (now.prefetches_issued - last->prefetches_issued),
+           (eligible ? ((double)(correct + incorrect) / (double)eligible) : 0.0),
+           ((correct + incorrect) ? ((double)correct / (double)(correct + incorrect)) : 0.0),
+           incorrect);
+   // The causes' cycles never decrease. The in-flight cycles do when the window drains: they were charged to the
+   // causes that moved fetch past them, so their change is signed. Together they add up to the interval's cycles.
+   int64_t in_flight = ((int64_t)now.in_flight_cycles - (int64_t)last->in_flight_cycles);
+   uint64_t charged = 0;
+   for (int i = 0; i < NUM_CPI_CAUSES; i++) {
+      assert(now.cpi_cycles[i] >= last->cpi_cycles[i]);
+      charged += (now.cpi_cycles[i] - last->cpi_cycles[i]);
+      fprintf(fp, ",%.4f", (instructions ? ((double)(now.cpi_cycles[i] - last->cpi_cycles[i]) / (double)instructions) : 0.0));
+   }
+   assert((int64_t)(charged + in_flight) == (int64_t)cycles);
+   fprintf(fp, ",%.4f\n", (instructions ? ((double)in_flight / (double)instructions) : 0.0));
+
+   *last = now;
+   next = (((now.instructions / interval_size) + 1) * interval_size);
+}
+
+void interval_stats_t::finish(const sim_results_t &now) {
+   if (now.instructions > last->instructions)
+      record(now);
+   fflush(fp);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Interval time series of a simulation (cvp -o).
+//
+// The end-of-run measurements hide phases: a trace that averages 3 IPC may
+// alternate between 1 and 5. With -o, the simulator hands its counters to an
+// interval_stats_t every interval_size micro-ops simulated in detail, which
+// writes one CSV row for the interval: IPC, branch and cache misses per
+// thousand micro-ops, prefetches issued, value prediction coverage, accuracy
+// and squashes, and the CPI stack (see uarchsim.h). The cpi_* columns add up
+// to the interval's CPI: the cycles fetch moved through, by cause, and
+// cpi_in_flight, the change in the cycles of the instructions in flight, which
+// is negative when fetch caught up with them. Recording costs one comparison
+// per micro-op and a buffered row per interval.
+//
+// Warmed micro-ops (-S, -s, -x) are not counted: intervals cover the detailed
+// ones. A last, shorter interval is written at the end of the run.
+
+#include <stdio.h>
+#include <inttypes.h>
+
+struct sim_results_t;
+
+class interval_stats_t {
+private:
+   FILE *fp;
+   uint64_t interval_size;	// micro-ops per row
+   uint64_t next;		// simulator's instruction count at the end of the current interval
+   sim_results_t *last;		// simulator's counts at the start of the current interval
+
+public:
+   // Writes the header to fp. "start" holds the simulator's counts so far (not 0 when resuming from a
+   // checkpoint): the first interval ends at the next multiple of interval_size.
+   interval_stats_t(FILE *fp, uint64_t interval_size, const sim_results_t &start);
+   ~interval_stats_t();
+
+   uint64_t next_row() const { return(next); }
+
+   // Writes the row of the interval that ends with the simulator's counts "now".
+   void record(const sim_results_t &now);
+
+   // Writes the row of the last interval, if it has micro-ops, and flushes fp.
+   void finish(const sim_results_t &now);
+};
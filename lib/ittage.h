@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
+#include "checkpoint.h"
 
 #ifndef _ITTAGE_H
 #define _ITTAGE_H
@@ -103,6 +104,24 @@ public:
 
   IPREDICTOR(void) { reinit(); }
 
+  ~IPREDICTOR() {
+    for (int i = 0; i <= NHIST; i++)
+      delete[] itable[i];
+  }
+
+  // As PREDICTOR::checkpoint(): the raw object, keeping this process's table pointers, then the tables.
+  void checkpoint(checkpoint_t &ck) {
+    ck.section("ITTAGE");
+    ck.shape(sizeof(*this), "ITTAGE");
+    ientry *tables[NHIST + 1];
+    memcpy(tables, itable, sizeof(itable));
+    ck.bytes(this, sizeof(*this));
+    if (ck.restoring())
+      memcpy(itable, tables, sizeof(itable));
+    for (int i = 0; i <= NHIST; i++)
+      ck.array(itable[i], 1 << LOGG, "ITTAGE table");
+  }
+
   void reinit() {
     m[0] = 0;
     m[1] = MINHIST;
@@ -134,7 +153,7 @@ public:
     Seed = 0;
 
     for (int i = 0; i < HISTBUFFERLENGTH; i++)
-      ghist[0] = 0;
+      ghist[i] = 0;
     ptghist = 0;
     use_alt_on_na = 0;
     GHIST = 0;
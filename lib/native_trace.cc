@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "native_trace.h"
+
+bool is_native_trace(const char *name) {
+   char magic[sizeof(((native_trace_header_t *)0)->magic)];
+   FILE *fp = fopen(name, "rb");
+   if (!fp)
+      return(false);
+   bool native = ((fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) && !memcmp(magic, NATIVE_TRACE_MAGIC, sizeof(magic)));
+   fclose(fp);
+   return(native);
+}
+
+native_trace_reader_t::native_trace_reader_t(const char *name) {
+   int fd = open(name, O_RDONLY);
+   if (fd < 0) {
+      fprintf(stderr, "Cannot open trace %s\n", name);
+      exit(1);
+   }
+   attach(fd, name);
+}
+
+native_trace_reader_t::native_trace_reader_t(int fd, const char *name) {
+   attach(fd, name);
+}
+
+void native_trace_reader_t::attach(int fd, const char *name) {
+   struct stat st;
+   if (fstat(fd, &st)) {
+      fprintf(stderr, "Cannot open trace %s\n", name);
+      exit(1);
+   }
+
+   map_size = st.st_size;
+   map = ((map_size >= sizeof(native_trace_header_t)) ? mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED);
+   close(fd);
+   if (map == MAP_FAILED) {
+      fprintf(stderr, "Cannot map native trace %s\n", name);
+      exit(1);
+   }
+   madvise(map, map_size, MADV_SEQUENTIAL);
+
+   const native_trace_header_t *header = (const native_trace_header_t *)map;
+   if (memcmp(header->magic, NATIVE_TRACE_MAGIC, sizeof(header->magic)) ||
+       (header->version != NATIVE_TRACE_VERSION) ||
+       (header->record_size != sizeof(native_uop_t)) ||
+       ((map_size - sizeof(native_trace_header_t)) / sizeof(native_uop_t) < header->num_uops)) {
+      fprintf(stderr, "Invalid or truncated native trace %s\n", name);
+      exit(1);
+   }
+
+   uops = (const native_uop_t *)((const uint8_t *)map + sizeof(native_trace_header_t));
+   num_uops = header->num_uops;
+   next = 0;
+   nInstr = 0;
+}
+
+native_trace_reader_t::~native_trace_reader_t() {
+   munmap(map, map_size);
+
+   std::cout  << " Read " << nInstr << " instrs " << std::endl;
+}
+
+db_t *native_trace_reader_t::get_inst() {
+   if (next == num_uops)
+      return(nullptr);
+
+   const native_uop_t &u = uops[next++];
+   db_t *inst = new db_t();
+   native_decode(u, inst);
+   nInstr += ((u.flags & NATIVE_FIRST_PIECE) ? 1 : 0);
+   return(inst);
+}
+
+size_t native_trace_reader_t::get_batch(db_t *out, size_t max) {
+   size_t n = std::min((uint64_t)max, num_uops - next);
+   for (size_t i = 0; i < n; i++) {
+      const native_uop_t &u = uops[next++];
+      out[i] = db_t();
+      native_decode(u, &out[i]);
+      nInstr += ((u.flags & NATIVE_FIRST_PIECE) ? 1 : 0);
+   }
+   return(n);
+}
+
+bool native_trace_reader_t::seek(uint64_t instr) {
+   if (instr < nInstr) {
+      next = 0;
+      nInstr = 0;
+   }
+
+   // Stop at the first piece of trace instruction "instr", i.e., after "instr" first pieces.
+   for (; next < num_uops; next++) {
+      if (uops[next].flags & NATIVE_FIRST_PIECE) {
+         if (nInstr == instr)
+            return(true);
+         nInstr++;
+      }
+   }
+   return(nInstr == instr);
+}
+
+native_trace_writer_t::native_trace_writer_t(const char *name) {
+   fp = fopen(name, "wb");
+   if (!fp) {
+      fprintf(stderr, "Cannot create native trace %s\n", name);
+      exit(1);
+   }
+   setvbuf(fp, NULL, _IOFBF, (1 << 20));
+
+   // Written again with the final counts when the trace is complete.
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, NATIVE_TRACE_MAGIC, sizeof(header.magic));
+   header.version = NATIVE_TRACE_VERSION;
+   header.record_size = sizeof(native_uop_t);
+   fwrite(&header, sizeof(header), 1, fp);
+}
+
+native_trace_writer_t::~native_trace_writer_t() {
+   fseek(fp, 0, SEEK_SET);
+   fwrite(&header, sizeof(header), 1, fp);
+   if (fclose(fp))
+      fprintf(stderr, "Error writing native trace\n");
+}
+
+void native_trace_writer_t::write(const db_t *inst, bool first_piece) {
+   native_uop_t u;
+   native_encode(inst, first_piece, u);
+   fwrite(&u, sizeof(u), 1, fp);
+   header.num_uops++;
+   header.num_instr += (first_piece ? 1 : 0);
+}
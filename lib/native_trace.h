@@ -0,0 +1,143 @@
+#pragma once
+
+// Native trace format: a fixed-layout array of already-cracked micro-ops.
+//
+// A CVP-1 trace has to be inflated, parsed and cracked into db_t pieces every
+// time it is simulated. A native trace stores the result of that work: one
+// native_uop_t per db_t, behind a small header, so that the file can be mmap'ed
+// and each micro-op rebuilt with a few loads. Files are little-endian, like
+// CVP-1 traces. Use cvp-convert to produce them.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "trace_reader.h"
+
+#define NATIVE_TRACE_MAGIC	"CVPNATIV"
+#define NATIVE_TRACE_VERSION	1
+
+struct native_trace_header_t {
+   char magic[8];		// NATIVE_TRACE_MAGIC, not null-terminated
+   uint32_t version;		// NATIVE_TRACE_VERSION
+   uint32_t record_size;	// sizeof(native_uop_t)
+   uint64_t num_uops;		// number of records
+   uint64_t num_instr;		// number of trace instructions the records were cracked from
+   uint8_t reserved[32];
+};
+
+static_assert(sizeof(native_trace_header_t) == 64, "native trace header layout changed");
+
+// native_uop_t::flags
+#define NATIVE_A_VALID		(1 << 0)
+#define NATIVE_B_VALID		(1 << 1)
+#define NATIVE_C_VALID		(1 << 2)
+#define NATIVE_D_VALID		(1 << 3)
+#define NATIVE_A_INT		(1 << 4)
+#define NATIVE_B_INT		(1 << 5)
+#define NATIVE_C_INT		(1 << 6)
+#define NATIVE_D_INT		(1 << 7)
+#define NATIVE_IS_LOAD		(1 << 8)
+#define NATIVE_IS_STORE		(1 << 9)
+#define NATIVE_FIRST_PIECE	(1 << 10)	// first micro-op of a trace instruction
+
+struct native_uop_t {
+   uint64_t pc;
+   uint64_t next_pc;
+   uint64_t addr;
+   uint64_t value;	// D.value (source operand values are not in the trace)
+   uint32_t size;
+   uint16_t flags;
+   uint8_t insn;
+   uint8_t reg[4];	// log_reg of A, B, C, D
+   uint8_t pad[5];
+};
+
+static_assert(sizeof(native_uop_t) == 48, "native micro-op layout changed");
+
+// Source operand values are unknown in the trace; CVPTraceReader sets them to this.
+#define NATIVE_NO_VALUE	0xdeadbeef
+
+inline void native_encode(const db_t *inst, bool first_piece, native_uop_t &u) {
+   memset(&u, 0, sizeof(u));
+   u.pc = inst->pc;
+   u.next_pc = inst->next_pc;
+   u.addr = inst->addr;
+   u.value = inst->D.value;
+   u.size = (uint32_t)inst->size;
+   u.insn = inst->insn;
+   const db_operand_t *ops[4] = {&inst->A, &inst->B, &inst->C, &inst->D};
+   for (int i = 0; i < 4; i++) {
+      if (ops[i]->valid) {
+         u.flags |= (NATIVE_A_VALID << i);
+         u.flags |= (ops[i]->is_int ? (NATIVE_A_INT << i) : 0);
+         u.reg[i] = (uint8_t)ops[i]->log_reg;
+      }
+   }
+   u.flags |= (inst->is_load ? NATIVE_IS_LOAD : 0);
+   u.flags |= (inst->is_store ? NATIVE_IS_STORE : 0);
+   u.flags |= (first_piece ? NATIVE_FIRST_PIECE : 0);
+}
+
+inline void native_decode(const native_uop_t &u, db_t *inst) {
+   inst->insn = u.insn;
+   inst->pc = u.pc;
+   inst->next_pc = u.next_pc;
+   db_operand_t *ops[4] = {&inst->A, &inst->B, &inst->C, &inst->D};
+   for (int i = 0; i < 4; i++) {
+      ops[i]->valid = (u.flags & (NATIVE_A_VALID << i));
+      ops[i]->is_int = (u.flags & (NATIVE_A_INT << i));
+      ops[i]->log_reg = u.reg[i];
+      ops[i]->value = (ops[i]->valid ? NATIVE_NO_VALUE : 0);
+   }
+   inst->D.value = u.value;
+   inst->is_load = (u.flags & NATIVE_IS_LOAD);
+   inst->is_store = (u.flags & NATIVE_IS_STORE);
+   inst->addr = u.addr;
+   inst->size = u.size;
+}
+
+// Returns true if the file starts with the native trace magic.
+bool is_native_trace(const char *name);
+
+// Reads a native trace by mapping it into memory.
+class native_trace_reader_t : public trace_reader_t {
+private:
+   const native_uop_t *uops;
+   uint64_t num_uops;
+   uint64_t next;		// index of the next record to return
+   uint64_t nInstr;		// trace instructions returned so far
+
+   void *map;
+   size_t map_size;
+
+   // Maps the native trace open on fd, and closes fd.
+   void attach(int fd, const char *name);
+
+public:
+   native_trace_reader_t(const char *name);
+
+   // Reads a native trace image already open on fd (e.g., a shared memory segment, see trace_cache.h); closes fd.
+   native_trace_reader_t(int fd, const char *name);
+   ~native_trace_reader_t();
+   db_t *get_inst();
+   size_t get_batch(db_t *out, size_t max);
+   uint64_t num_instr() const { return nInstr; }
+   double fraction_read() const { return (num_uops ? ((double)next / num_uops) : 1.0); }
+   bool seek(uint64_t instr);
+};
+
+// Writes a native trace. The header is completed by the destructor.
+class native_trace_writer_t {
+private:
+   FILE *fp;
+   native_trace_header_t header;
+
+public:
+   native_trace_writer_t(const char *name);
+   ~native_trace_writer_t();
+   void write(const db_t *inst, bool first_piece);
+};
@@ -24,43 +24,25 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <inttypes.h>
 
-bool VP_ENABLE = false;
-bool VP_PERFECT = false;
-uint64_t VP_TRACK = 0;
-uint64_t WINDOW_SIZE = 512;
-uint64_t FETCH_WIDTH = 16;
-uint64_t FETCH_NUM_BRANCH = 16;		// 0: unlimited; >0: finite
-bool FETCH_STOP_AT_INDIRECT = true;
-bool FETCH_STOP_AT_TAKEN = true;
-bool FETCH_MODEL_ICACHE = true;
-
-bool PERFECT_BRANCH_PRED = false;
-bool PERFECT_INDIRECT_PRED = false;
-uint64_t PIPELINE_FILL_LATENCY = 5;
-uint64_t NUM_LDST_LANES = 8;
-uint64_t NUM_ALU_LANES = 16;
-
-bool PREFETCHER_ENABLE = true;
-bool PERFECT_CACHE = false;
-bool WRITE_ALLOCATE = true;
-
-uint64_t IC_SIZE = (1 << 17);
-uint64_t IC_ASSOC = 8;
-uint64_t IC_BLOCKSIZE = 64;
-
-uint64_t L1_SIZE = (1 << 16);
-uint64_t L1_ASSOC = 8;
-uint64_t L1_BLOCKSIZE = 64;
-uint64_t L1_LATENCY = 3;
-
-uint64_t L2_SIZE = (1 << 20);
-uint64_t L2_ASSOC = 8;
-uint64_t L2_BLOCKSIZE = 64;
-uint64_t L2_LATENCY = 12;
-
-uint64_t L3_SIZE = (1 << 23);
-uint64_t L3_ASSOC = 16;
-uint64_t L3_BLOCKSIZE = 128;
-uint64_t L3_LATENCY = 60;
-
-uint64_t MAIN_MEMORY_LATENCY = 150;
+uint64_t TRACE_BUFFER_SIZE = (1 << 22);	// bytes of decompressed trace buffered at a time
+bool TRACE_DECODE_THREAD = false;		// decode the trace on a separate thread
+uint32_t TRACE_THREADS = 0;		// decompression threads for block-compressed traces (0: one per core)
+bool TRACE_SHARED_CACHE = false;	// decode the trace once per host into shared memory, shared by all cvp processes
+uint32_t TRACE_READ_AHEAD = 4;		// compressed chunks of a .gz trace read ahead on an I/O thread (0: synchronous reads)
+bool TRACE_DROP_CACHE = false;		// drop the page cache of trace file chunks already read
+uint64_t SKIP_INSTR = 0;		// trace instructions to skip (without simulating them) before simulation starts
+uint64_t FAST_FORWARD = 0;		// micro-ops warmed functionally (caches and predictors, without timing) before simulation starts
+double PROGRESS_INTERVAL = 10.0;	// seconds between progress reports (0: no reports)
+const char *PROGRESS_FILE = nullptr;	// file holding the latest progress report (NULL: report on stderr)
+const char *SWEEP_FILE = nullptr;	// configurations to simulate in a single pass over the trace, one per line (NULL: just one)
+uint64_t SAMPLE_UNIT = 0;		// micro-ops per measured sampling unit (0: no sampling, simulate everything in detail)
+uint64_t SAMPLE_PERIOD = 0;		// micro-ops from the start of one sampling period to the next
+uint64_t SAMPLE_WARMUP = 0;		// micro-ops simulated in detail, not measured, before each unit
+double SAMPLE_ERROR = 0.0;		// stop sampling once the confidence intervals are within this fraction (0: sample the whole trace)
+const char *SIMPOINT_FILE = nullptr;	// simulate only the simulation points listed in this file (cvp-simpoint)
+uint64_t SIMPOINT_WARMUP = 0;		// trace instructions warmed functionally before each simulation point (0: one interval)
+const char *CHECKPOINT_FILE = nullptr;	// checkpoint of the simulation state, rewritten every CHECKPOINT_PERIOD micro-ops
+uint64_t CHECKPOINT_PERIOD = 0;		// micro-ops between checkpoints (0: no checkpoints)
+const char *RESTORE_FILE = nullptr;	// checkpoint to resume the simulation from
+uint64_t INTERVAL_SIZE = 0;		// micro-ops per row of interval statistics (0: none)
+const char *INTERVAL_FILE = nullptr;	// CSV file of interval statistics
@@ -24,53 +24,27 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _PARAMETERS_H_
 #define _PARAMETERS_H_
 
-enum class VPTracks
-{
-    ALL  = 0,
-    LoadsOnly,
-    LoadsOnlyHitMiss,
-    NumTracks
-};
-
-extern bool VP_ENABLE;
-extern bool VP_PERFECT;
-extern uint64_t VP_TRACK;
-extern uint64_t WINDOW_SIZE;
-extern uint64_t FETCH_WIDTH;
-extern uint64_t FETCH_NUM_BRANCH;
-extern bool FETCH_STOP_AT_INDIRECT;
-extern bool FETCH_STOP_AT_TAKEN;
-extern bool FETCH_MODEL_ICACHE;
-
-extern bool PERFECT_BRANCH_PRED;
-extern bool PERFECT_INDIRECT_PRED;
-extern uint64_t PIPELINE_FILL_LATENCY;
-extern uint64_t NUM_LDST_LANES;
-extern uint64_t NUM_ALU_LANES;
-
-extern bool PREFETCHER_ENABLE;
-extern bool PERFECT_CACHE;
-extern bool WRITE_ALLOCATE;
-
-extern uint64_t IC_SIZE;
-extern uint64_t IC_ASSOC;
-extern uint64_t IC_BLOCKSIZE;
-
-extern uint64_t L1_SIZE;
-extern uint64_t L1_ASSOC;
-extern uint64_t L1_BLOCKSIZE;
-extern uint64_t L1_LATENCY;
-
-extern uint64_t L2_SIZE;
-extern uint64_t L2_ASSOC;
-extern uint64_t L2_BLOCKSIZE;
-extern uint64_t L2_LATENCY;
-
-extern uint64_t L3_SIZE;
-extern uint64_t L3_ASSOC;
-extern uint64_t L3_BLOCKSIZE;
-extern uint64_t L3_LATENCY;
-
-extern uint64_t MAIN_MEMORY_LATENCY;
+extern uint64_t TRACE_BUFFER_SIZE;
+extern bool TRACE_DECODE_THREAD;
+extern uint32_t TRACE_THREADS;
+extern bool TRACE_SHARED_CACHE;
+extern uint32_t TRACE_READ_AHEAD;
+extern bool TRACE_DROP_CACHE;
+extern uint64_t SKIP_INSTR;
+extern uint64_t FAST_FORWARD;
+extern double PROGRESS_INTERVAL;
+extern const char *PROGRESS_FILE;
+extern const char *SWEEP_FILE;
+extern uint64_t SAMPLE_UNIT;
+extern uint64_t SAMPLE_PERIOD;
+extern uint64_t SAMPLE_WARMUP;
+extern double SAMPLE_ERROR;
+extern const char *SIMPOINT_FILE;
+extern uint64_t SIMPOINT_WARMUP;
+extern const char *CHECKPOINT_FILE;
+extern uint64_t CHECKPOINT_PERIOD;
+extern const char *RESTORE_FILE;
+extern uint64_t INTERVAL_SIZE;
+extern const char *INTERVAL_FILE;
 
 #endif
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "progress.h"
+
+progress_t::progress_t(const trace_reader_t *reader, double interval, const char *status_file)
+   : reader(reader), interval(interval), status_file(status_file ? status_file : "") {
+   uops = 0;
+   next_check = ((interval > 0) ? PROGRESS_CHECK_UOPS : UINT64_MAX);
+   start = steady_t::now();
+   next_report = start + std::chrono::duration_cast<steady_t::duration>(std::chrono::duration<double>(interval));
+   start_instr = reader->num_instr();
+   start_fraction = reader->fraction_read();
+}
+
+void progress_t::check() {
+   next_check = uops + PROGRESS_CHECK_UOPS;
+   steady_t::time_point now = steady_t::now();
+   if (now < next_report)
+      return;
+   // Skip missed reports rather than catching up on them.
+   while (next_report <= now)
+      next_report += std::chrono::duration_cast<steady_t::duration>(std::chrono::duration<double>(interval));
+   report(false);
+}
+
+void progress_t::finish() {
+   if (interval > 0)
+      report(true);
+}
+
+void progress_t::report(bool final) {
+   double elapsed = std::chrono::duration<double>(steady_t::now() - start).count();
+   uint64_t instr = reader->num_instr();
+   double fraction = (final ? 1.0 : reader->fraction_read());
+   double mips = ((elapsed > 0) ? ((instr - start_instr) / elapsed / 1e6) : 0.0);
+
+   // Extrapolate from the part of the trace covered since the reporter was created.
+   char eta[32] = "?";
+   if (final) {
+      snprintf(eta, sizeof(eta), "done");
+   }
+   else if (fraction > start_fraction) {
+      uint64_t left = (uint64_t)(elapsed * (1.0 - fraction) / (fraction - start_fraction));
+      snprintf(eta, sizeof(eta), "%" PRIu64 ":%02" PRIu64 ":%02" PRIu64, left / 3600, (left / 60) % 60, left % 60);
+   }
+
+   char line[160];
+   snprintf(line, sizeof(line), "progress: %5.1f%% of trace, %" PRIu64 " instrs, %.2f MIPS, %.0f s elapsed, ETA %s\n",
+            100.0 * fraction, instr, mips, elapsed, eta);
+
+   if (status_file.empty()) {
+      fputs(line, stderr);
+      return;
+   }
+
+   // Write a new file and rename it over the old one, so that readers never see a partial status.
+   std::string tmp = status_file + ".tmp";
+   FILE *fp = fopen(tmp.c_str(), "w");
+   if (fp) {
+      fputs(line, fp);
+      if ((fclose(fp) == 0) && (rename(tmp.c_str(), status_file.c_str()) == 0))
+         return;
+   }
+   fprintf(stderr, "Cannot write status file %s\n", status_file.c_str());
+   status_file.clear();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Periodic progress report for long simulations.
+//
+// The thread that reads the trace calls tick() with the number of micro-ops it
+// just got. tick() only adds to a counter; every PROGRESS_CHECK_UOPS micro-ops
+// it looks at the clock, and once per interval it reports the fraction of the
+// trace consumed, the simulation rate in millions of trace instructions per
+// second, and the estimated time left. Reports go to stderr, or replace the
+// contents of a status file so that job monitors can poll it.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include "trace_reader.h"
+
+// Micro-ops between two looks at the clock.
+#define PROGRESS_CHECK_UOPS	(1 << 16)
+
+class progress_t {
+private:
+   typedef std::chrono::steady_clock steady_t;
+
+   const trace_reader_t *reader;
+   double interval;		// seconds between reports, 0: no reports
+   std::string status_file;	// empty: report on stderr
+
+   uint64_t uops;		// micro-ops ticked so far
+   uint64_t next_check;		// look at the clock when uops reaches this
+
+   steady_t::time_point start;
+   steady_t::time_point next_report;
+   uint64_t start_instr;	// trace position when the reporter was created (e.g., after -k)
+   double start_fraction;
+
+   void check();
+   void report(bool final);
+
+public:
+   progress_t(const trace_reader_t *reader, double interval, const char *status_file = NULL);
+
+   inline void tick(uint64_t n) {
+      uops += n;
+      if (uops >= next_check)
+         check();
+   }
+
+   // Reports one last time (if reporting is enabled) at the end of the simulation.
+   void finish();
+};
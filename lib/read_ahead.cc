@@ -0,0 +1,129 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include "read_ahead.h"
+
+read_ahead_t::read_ahead_t(int fd, size_t chunk_size, unsigned depth, bool drop_cache)
+   : fd(fd), chunk_size(chunk_size), drop_cache(drop_cache), base(0) {
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+   // One slot for the chunk the caller holds, "depth" for the chunks read ahead.
+   slots.resize(depth + 1);
+   for (auto &s : slots) {
+      s.buf = new uint8_t[chunk_size];
+      s.size = 0;
+      s.chunk = 0;
+      s.ready = false;
+   }
+
+   next_read = 0;
+   next_chunk = 0;
+   generation = 0;
+   end_seen = false;
+   stop = false;
+   if (depth > 0)
+      io = std::thread(&read_ahead_t::io_thread, this);
+}
+
+read_ahead_t::~read_ahead_t() {
+   if (io.joinable()) {
+      {
+         std::unique_lock<std::mutex> lk(lock);
+         stop = true;
+      }
+      cv_work.notify_all();
+      io.join();
+   }
+   for (auto &s : slots)
+      delete [] s.buf;
+}
+
+size_t read_ahead_t::read_chunk(uint64_t offset, uint8_t *buf) {
+   size_t size = 0;
+   while (size < chunk_size) {
+      ssize_t num = pread(fd, buf + size, chunk_size - size, offset + size);
+      if (num <= 0)
+         break;
+      size += num;
+   }
+   return(size);
+}
+
+void read_ahead_t::io_thread() {
+   uint8_t *mine = new uint8_t[chunk_size];	// swapped with the slot's buffer once the chunk is read
+
+   std::unique_lock<std::mutex> lk(lock);
+   while (true) {
+      // A chunk can be read once the caller is done with the chunk that last used its slot.
+      cv_work.wait(lk, [this]() {
+         uint64_t held = (next_chunk ? (next_chunk - 1) : 0);
+         return (stop || (!end_seen && (next_read < held + slots.size())));
+      });
+      if (stop)
+         break;
+      uint64_t c = next_read++;
+      uint64_t gen = generation;
+      uint64_t offset = base + c * chunk_size;
+      lk.unlock();
+
+      size_t size = read_chunk(offset, mine);
+
+      lk.lock();
+      if (gen == generation) {
+         slot_t &s = slots[c % slots.size()];
+         std::swap(s.buf, mine);
+         s.size = size;
+         s.chunk = c;
+         s.ready = true;
+         end_seen = (size < chunk_size);
+         cv_ready.notify_all();
+      }
+   }
+
+   delete [] mine;
+}
+
+size_t read_ahead_t::next(const uint8_t *&p) {
+   // The chunk the caller held is consumed: its pages will not be read again.
+   if (drop_cache && next_chunk)
+      posix_fadvise(fd, base + (next_chunk - 1) * chunk_size, chunk_size, POSIX_FADV_DONTNEED);
+
+   if (!io.joinable()) {
+      slot_t &s = slots[0];
+      s.size = read_chunk(base + next_chunk * chunk_size, s.buf);
+      next_chunk++;
+      p = s.buf;
+      return(s.size);
+   }
+
+   std::unique_lock<std::mutex> lk(lock);
+   uint64_t c = next_chunk;
+   slot_t &s = slots[c % slots.size()];
+   // Chunks past the end of the file are never read.
+   cv_ready.wait(lk, [&]() { return ((s.ready && (s.chunk == c)) || (end_seen && (c >= next_read))); });
+   if (!s.ready || (s.chunk != c)) {
+      p = NULL;
+      return(0);
+   }
+   s.ready = false;
+   next_chunk++;
+   lk.unlock();
+   cv_work.notify_all();
+
+   p = s.buf;
+   return(s.size);
+}
+
+void read_ahead_t::seek(uint64_t offset) {
+   {
+      std::unique_lock<std::mutex> lk(lock);
+      generation++;
+      for (auto &s : slots)
+         s.ready = false;
+      base = offset;
+      next_read = 0;
+      next_chunk = 0;
+      end_seen = false;
+   }
+   cv_work.notify_all();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Sequential file reader with asynchronous read-ahead.
+//
+// With many simulations streaming large traces from the same disk, a read()
+// issued only when inflate runs out of input stalls the simulation for the
+// whole disk latency. read_ahead_t keeps up to "depth" chunks in flight on an
+// I/O thread, so the next compressed chunk is usually in memory before it is
+// needed. It also tells the kernel the file is read sequentially and, with
+// drop_cache, that chunks already consumed will not be read again
+// (POSIX_FADV_DONTNEED), so that a pass over a multi-GB trace does not evict
+// the page cache of the other jobs on the host.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define DEFAULT_TRACE_READ_AHEAD	4	// chunks read ahead (0: synchronous reads)
+
+class read_ahead_t {
+private:
+   struct slot_t {
+      uint8_t *buf;
+      size_t size;
+      uint64_t chunk;	// chunk held by the slot
+      bool ready;
+   };
+
+   int fd;
+   size_t chunk_size;
+   bool drop_cache;
+   uint64_t base;		// file offset of chunk 0 (set by seek())
+
+   // I/O thread state, protected by lock.
+   std::mutex lock;
+   std::condition_variable cv_ready;	// signaled when a chunk is ready
+   std::condition_variable cv_work;	// signaled when chunks can be read
+   std::vector<slot_t> slots;		// chunk c goes in slots[c % slots.size()]
+   uint64_t next_read;			// next chunk to read
+   uint64_t next_chunk;			// next chunk to hand out; the one before it is held by the caller
+   uint64_t generation;			// incremented by seek() to drop chunks read for the old position
+   bool end_seen;			// a chunk at or past the end of the file was read
+   bool stop;
+   std::thread io;
+
+   void io_thread();
+
+   // Reads the chunk at "offset" into buf. Returns its size, 0 at the end of the file.
+   size_t read_chunk(uint64_t offset, uint8_t *buf);
+
+public:
+   // depth: chunks read ahead of the caller (0: read synchronously, no I/O thread).
+   read_ahead_t(int fd, size_t chunk_size, unsigned depth = DEFAULT_TRACE_READ_AHEAD, bool drop_cache = false);
+   ~read_ahead_t();
+
+   // Returns the next chunk of the file in p (valid until the next call) and its size, 0 at the end of the file.
+   size_t next(const uint8_t *&p);
+
+   // Continues reading at file offset "offset".
+   void seek(uint64_t offset);
+};
@@ -25,6 +25,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <inttypes.h>
 #include <assert.h>
 #include "resource_schedule.h"
+#include "checkpoint.h"
 
 resource_schedule::resource_schedule(uint64_t width) {
    base_cycle = 0;
@@ -36,6 +37,7 @@ resource_schedule::resource_schedule(uint64_t width) {
 }
 
 resource_schedule::~resource_schedule() {
+   delete [] sched;
 }
 
 void resource_schedule::resize(uint64_t new_depth) {
@@ -59,7 +61,7 @@ void resource_schedule::resize(uint64_t new_depth) {
    for (i = old_depth; i < depth; i++)
       sched[i] = 0;
 
-   delete old;
+   delete [] old;
 }
 
 uint64_t resource_schedule::schedule(uint64_t start_cycle, uint64_t max_delta) 
@@ -122,3 +124,20 @@ void resource_schedule::advance_base_cycle(uint64_t new_base_cycle) {
    base_cycle = new_base_cycle;
 }
 
+// The width may differ: lanes already taken in the checkpoint stay taken.
+void resource_schedule::checkpoint(checkpoint_t &ck) {
+   ck.section("resource schedule");
+   uint64_t saved_depth = depth;
+   ck.io(saved_depth);
+   if (ck.restoring() && ck.good() && (saved_depth != depth)) {
+      if (!saved_depth || (saved_depth % SCHED_DEPTH_INCREMENT)) {
+         ck.fail("corrupt resource schedule");
+         return;
+      }
+      delete [] sched;
+      depth = saved_depth;
+      sched = new uint64_t[depth];
+   }
+   ck.bytes(sched, depth * sizeof(uint64_t));
+   ck.io(base_cycle);
+}
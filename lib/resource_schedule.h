@@ -27,6 +27,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 constexpr uint64_t MAX_CYCLE = ~0lu;
 
+class checkpoint_t;
+
 class resource_schedule {
 private:
    uint64_t *sched;
@@ -43,4 +45,5 @@ public:
    uint64_t schedule(uint64_t start_cycle, uint64_t max_delta = MAX_CYCLE);
    uint64_t try_schedule(uint64_t try_cycle);
    void advance_base_cycle(uint64_t new_base_cycle);
+   void checkpoint(checkpoint_t &ck);
 };
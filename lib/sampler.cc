@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+#include <assert.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "fifo.h"
+#include "cache.h"
+#include "bp.h"
+#include "resource_schedule.h"
+#include "uarchsim.h"
+#include "sampler.h"
+#include "checkpoint.h"
+
+void ratio_estimate_t::add(double x, double y) {
+   sx += x;
+   sy += y;
+   sxx += x * x;
+   syy += y * y;
+   sxy += x * y;
+   n++;
+}
+
+double ratio_estimate_t::estimate() const {
+   return(sy ? (sx / sy) : 0.0);
+}
+
+// Variance of the ratio estimator: sum((x - R y)^2) / (n (n - 1) mean(y)^2).
+double ratio_estimate_t::half_width() const {
+   if ((n < 2) || !sy)
+      return(INFINITY);
+   double r = estimate();
+   double residuals = (sxx - 2 * r * sxy + r * r * syy);
+   double mean_y = (sy / n);
+   return(SAMPLE_Z * sqrt(fmax(residuals, 0.0) / ((double)n * (double)(n - 1) * mean_y * mean_y)));
+}
+
+sampler_t::sampler_t(uarchsim_t *sim, uint64_t unit, uint64_t period, uint64_t warmup, double target_error, bool vp)
+   : sim(sim), unit(unit), period(period), warmup(warmup), target_error(target_error), vp(vp) {
+   assert(unit && (period >= unit + warmup));
+   pos = 0;
+   start_instructions = 0;
+   start_cycles = 0;
+   start_vp_correct = 0;
+   start_vp_incorrect = 0;
+   met = false;
+}
+
+void sampler_t::step_batch(db_t *inst, size_t n) {
+   for (size_t i = 0; (i < n) && !met; i++) {
+      if (pos < period - unit - warmup) {
+         sim->warm(&inst[i]);
+      }
+      else {
+         if (pos == period - unit) {
+            sim_results_t r = sim->results();
+            start_instructions = r.instructions;
+            start_cycles = r.cycles;
+            start_vp_correct = r.vp_correct;
+            start_vp_incorrect = r.vp_incorrect;
+         }
+         sim->step(&inst[i]);
+      }
+
+      if (++pos == period) {
+         end_unit();
+         pos = 0;
+      }
+   }
+}
+
+void sampler_t::end_unit() {
+   sim_results_t r = sim->results();
+   ipc.add(r.instructions - start_instructions, r.cycles - start_cycles);
+   if (vp) {
+      uint64_t correct = (r.vp_correct - start_vp_correct);
+      vp_accuracy.add(correct, correct + (r.vp_incorrect - start_vp_incorrect));
+   }
+
+   // Accuracy is moot while the predictor does not predict.
+   if ((target_error > 0) && (ipc.n >= SAMPLE_MIN_UNITS) &&
+       (ipc.half_width() <= target_error * ipc.estimate()) &&
+       (!vp || !vp_accuracy.sy || (vp_accuracy.half_width() <= target_error)))
+      met = true;
+}
+
+void sampler_t::output() {
+   printf("SAMPLING-------------------------------------------\n");
+   printf("unit = %lu, period = %lu, warmup = %lu micro-ops\n", unit, period, warmup);
+   printf("measured units = %lu\n", ipc.n);
+   if (ipc.n < 2) {
+      printf("Too few units for an estimate: use a shorter period.\n");
+      return;
+   }
+
+   double error = (ipc.half_width() / ipc.estimate());
+   printf("IPC          = %.3f +/- %.3f (%.2f%%)\n", ipc.estimate(), ipc.half_width(), 100.0 * error);
+   if (vp) {
+      if (vp_accuracy.sy) {
+         printf("VP accuracy  = %.2f%% +/- %.2f%%\n", 100.0 * vp_accuracy.estimate(), 100.0 * vp_accuracy.half_width());
+         error = fmax(error, vp_accuracy.half_width());
+      }
+      else
+         printf("VP accuracy  = n/a (no predictions)\n");
+   }
+   printf("confidence   = %.1f%%\n", 100.0 * erf(SAMPLE_Z / sqrt(2.0)));
+   if (target_error > 0) {
+      if (met)
+         printf("target error = %.2f%% (met)\n", 100.0 * target_error);
+      else
+         // The half-width shrinks with the square root of the number of units.
+         printf("target error = %.2f%% (not met: about %.0f units needed)\n", 100.0 * target_error,
+                ceil(ipc.n * pow(error / target_error, 2.0)));
+   }
+}
+
+void sampler_t::checkpoint(checkpoint_t &ck) {
+   ck.section("sampler");
+   ck.shape(unit, "sampling unit");
+   ck.shape(period, "sampling period");
+   ck.shape(warmup, "sampling warmup");
+   ck.io(pos);
+   ck.io(start_instructions);
+   ck.io(start_cycles);
+   ck.io(start_vp_correct);
+   ck.io(start_vp_incorrect);
+   ck.io(ipc);
+   ck.io(vp_accuracy);
+   ck.io(met);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+// Statistical sampling of a simulation (SMARTS).
+//
+// Instead of simulating every micro-op in detail, the sampler splits the trace
+// into periods of "period" micro-ops. In each period, it warms the simulator
+// functionally (uarchsim_t::warm(): caches, branch predictor, prefetcher and
+// value predictor, without timing), then simulates "warmup" micro-ops in detail
+// to fill the pipeline, then measures a unit of "unit" micro-ops in detail at
+// the end of the period.
+//
+// IPC and value prediction accuracy are estimated from the units as ratios of
+// sums (instructions over cycles, correct over all predictions), with a
+// confidence interval derived from the variance between units. If a target
+// error e is given, the sampler reports done() once the IPC interval is within
+// e of the IPC (relative) and the accuracy interval within e (absolute).
+
+#include <inttypes.h>
+#include <stddef.h>
+
+struct db_t;
+class uarchsim_t;
+class checkpoint_t;
+
+// Units measured before the confidence intervals are trusted to stop early.
+#define SAMPLE_MIN_UNITS	30
+
+// Confidence of the reported intervals: z = 3 (99.7%).
+#define SAMPLE_Z		3.0
+
+// Running sums for the ratio estimator sum(x) / sum(y) over units.
+struct ratio_estimate_t {
+   double sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+   uint64_t n = 0;
+
+   void add(double x, double y);
+   double estimate() const;
+   double half_width() const;		// of the confidence interval on estimate()
+};
+
+class sampler_t {
+private:
+   uarchsim_t *sim;
+   uint64_t unit;		// micro-ops per measured unit
+   uint64_t period;		// micro-ops from the start of one period to the next
+   uint64_t warmup;		// micro-ops simulated in detail, not measured, before each unit
+   double target_error;		// stop once every interval is within this fraction (0: sample the whole trace)
+   bool vp;			// estimate value prediction accuracy
+
+   uint64_t pos;		// position in the current period
+
+   // Simulator counts at the start of the current unit.
+   uint64_t start_instructions;
+   uint64_t start_cycles;
+   uint64_t start_vp_correct;
+   uint64_t start_vp_incorrect;
+
+   ratio_estimate_t ipc;
+   ratio_estimate_t vp_accuracy;
+   bool met;
+
+   void end_unit();
+
+public:
+   sampler_t(uarchsim_t *sim, uint64_t unit, uint64_t period, uint64_t warmup, double target_error, bool vp);
+
+   void step_batch(db_t *inst, size_t n);
+
+   // True once the target error is met: the rest of the trace need not be read.
+   bool done() const { return(met); }
+
+   void output();
+
+   // Position in the sampling schedule and the units measured so far (the schedule must be the same).
+   void checkpoint(checkpoint_t &ck);
+};
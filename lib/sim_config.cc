@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <type_traits>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include "sim_config.h"
+
+bool sim_config_t::parse_option(int argc, char **argv, int &i) {
+   if (!strcmp(argv[i], "-v"))
+   {
+      vp_enable = true;
+      i++;
+   }
+   else if (!strcmp(argv[i], "-p"))
+   {
+      vp_perfect = true;
+      i++;
+   }
+   else if (!strcmp(argv[i], "-t"))
+   {
+      i++;
+      if (i < argc)
+      {
+         vp_track = std::stoul(argv[i]);
+         assert(vp_track <  static_cast<std::underlying_type<VPTracks>::type>(VPTracks::NumTracks));
+         i++;
+      }
+      else
+      {
+         printf("Usage: missing track number : -t <track_number>.\n");
+         exit(0);
+      }
+   }
+   else if (!strcmp(argv[i], "-d"))
+   {
+      perfect_cache = true;
+      i++;
+   }
+   else if (!strcmp(argv[i], "-b"))
+   {
+      perfect_branch_pred = true;
+      i++;
+   }
+   else if (!strcmp(argv[i], "-i"))
+   {
+      perfect_indirect_pred = true;
+      i++;
+   }
+   else if (!strcmp(argv[i], "-P"))
+   {
+      prefetcher_enable = true;
+      i++;
+   }
+   else if (!strcmp(argv[i], "-f"))
+   {
+      i++;
+      if (i < argc)
+      {
+         pipeline_fill_latency = atoi(argv[i]);
+         i++;
+      }
+      else
+      {
+         printf("Usage: missing pipeline fill latency: -f <pipeline_fill_latency>.\n");
+         exit(0);
+      }
+   }
+   else if (!strcmp(argv[i], "-M"))
+   {
+      i++;
+      if (i < argc)
+      {
+         num_ldst_lanes = atoi(argv[i]);
+         i++;
+      }
+      else
+      {
+         printf("Usage: missing # load/store lanes: -M <num_ldst_lanes>.\n");
+         exit(0);
+      }
+   }
+   else if (!strcmp(argv[i], "-A"))
+   {
+      i++;
+      if (i < argc)
+      {
+         num_alu_lanes = atoi(argv[i]);
+         i++;
+      }
+      else
+      {
+         printf("Usage: missing # alu lanes: -A <num_alu_lanes>.\n");
+         exit(0);
+      }
+   }
+   //else if (!strcmp(argv[i], "-s")) {
+   //   write_allocate = true;
+   //	i++;
+   //}
+   else if (!strcmp(argv[i], "-F"))
+   {
+      i++;
+      if (i < argc)
+      {
+         unsigned int temp1, temp2, temp3, temp4, temp5;
+         if (sscanf(argv[i], "%d,%d,%d,%d,%d", &temp1, &temp2, &temp3, &temp4, &temp5) == 5)
+         {
+            fetch_width = (uint64_t)temp1;
+            fetch_num_branch = (uint64_t)temp2;
+            fetch_stop_at_indirect = (temp3 ? true : false);
+            fetch_stop_at_taken = (temp4 ? true : false);
+            fetch_model_icache = (temp5 ? true : false);
+         }
+         else
+         {
+            printf("Usage: missing one or more fetch bundle constraints: -F <fetch_width>,<fetch_num_branch>,<fetch_stop_at_indirect>,<fetch_stop_at_taken>,<fetch_model_icache>.\n");
+            exit(0);
+         }
+         i++;
+      }
+      else
+      {
+         printf("Usage: missing one or more fetch bundle constraints: -F <fetch_width>,<fetch_num_branch>,<fetch_stop_at_indirect>,<fetch_stop_at_taken>,<fetch_model_icache>.\n");
+         exit(0);
+      }
+   }
+   else if (!strcmp(argv[i], "-I"))
+   {
+      i++;
+      if (i < argc)
+      {
+         unsigned int temp1, temp2, temp3;
+         if (sscanf(argv[i], "%d,%d,%d", &temp1, &temp2, &temp3) == 3)
+         {
+            ic_size = (uint64_t)(1 << temp1);
+            ic_assoc = (uint64_t)temp2;
+            ic_blocksize = (uint64_t)temp3;
+         }
+         else
+         {
+            printf("Usage: missing one or more I$ parameters: -I <log2_size>,<assoc>,<blocksize>.\n");
+            exit(0);
+         }
+         i++;
+      }
+      else
+      {
+         printf("Usage: missing I$ parameters: -I <log2_size>,<assoc>,<blocksize>.\n");
+         exit(0);
+      }
+   }
+   else if (!strcmp(argv[i], "-D"))
+   {
+      i++;
+      if (i < argc)
+      {
+         unsigned int temp1, temp2, temp3, temp4, temp5, temp6, temp7, temp8, temp9, temp10, temp11, temp12, temp13;
+         if (sscanf(argv[i], "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d",
+                    &temp1, &temp2, &temp3, &temp4,
+                    &temp5, &temp6, &temp7, &temp8,
+                    &temp9, &temp10, &temp11, &temp12,
+                    &temp13) == 13)
+         {
+            l1_size = (uint64_t)(1 << temp1);
+            l1_assoc = (uint64_t)temp2;
+            l1_blocksize = (uint64_t)temp3;
+            l1_latency = (uint64_t)temp4;
+
+            l2_size = (uint64_t)(1 << temp5);
+            l2_assoc = (uint64_t)temp6;
+            l2_blocksize = (uint64_t)temp7;
+            l2_latency = (uint64_t)temp8;
+
+            l3_size = (uint64_t)(1 << temp9);
+            l3_assoc = (uint64_t)temp10;
+            l3_blocksize = (uint64_t)temp11;
+            l3_latency = (uint64_t)temp12;
+
+            main_memory_latency = (uint64_t)temp13;
+         }
+         else
+         {
+            printf("Usage: missing one or more L1$, L2$, and L3$ parameters: -D <log2_L1_size>,<L1_assoc>,<L1_blocksize>,<L1_latency>,<log2_L2_size>,<L2_assoc>,<L2_blocksize>,<L2_latency>,<log2_L3_size>,<L3_assoc>,<L3_blocksize>,<L3_latency>,<main_memory_latency>.\n");
+            exit(0);
+         }
+         i++;
+      }
+      else
+      {
+         printf("Usage: missing L1$, L2$, and L3$ parameters: -D <log2_L1_size>,<L1_assoc>,<L1_blocksize>,<L1_latency>,<log2_L2_size>,<L2_assoc>,<L2_blocksize>,<L2_latency>,<log2_L3_size>,<L3_assoc>,<L3_blocksize>,<L3_latency>,<main_memory_latency>.\n");
+         exit(0);
+      }
+   }
+   else if (!strcmp(argv[i], "-w"))
+   {
+      i++;
+      if (i < argc)
+      {
+         window_size = atoi(argv[i]);
+         i++;
+      }
+      else
+      {
+         printf("Usage: missing window size: -w <window_size>.\n");
+         exit(0);
+      }
+   }
+   else
+   {
+      return(false);
+   }
+   return(true);
+}
+
+bool sim_config_t::parse_string(const std::string &options) {
+   std::istringstream lines(options);
+   std::vector<std::string> words;
+   std::string line, word;
+   while (std::getline(lines, line)) {
+      std::istringstream tokens(line);
+      while ((tokens >> word) && (word[0] != '#'))
+         words.push_back(word);
+   }
+
+   std::vector<char *> args;
+   for (std::string &w : words)
+      args.push_back((char *)w.c_str());
+   int i = 0;
+   while (i < (int)args.size())
+      if (!parse_option(args.size(), args.data(), i))
+         return(false);
+   return(true);
+}
+
+bool sim_config_t::parse_file(const char *name) {
+   std::ifstream file(name);
+   if (!file)
+      return(false);
+   std::stringstream options;
+   options << file.rdbuf();
+   return(parse_string(options.str()));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Configuration of one simulated core.
+//
+// uarchsim_t and the structures it builds (caches, branch predictor) take
+// their parameters from a sim_config_t instead of global variables, so that
+// differently configured simulators can coexist. A configuration is set from
+// the simulator's command line options, given on the command line or in a
+// configuration file (cvp -c).
+
+#include <inttypes.h>
+#include <string>
+
+enum class VPTracks
+{
+    ALL  = 0,
+    LoadsOnly,
+    LoadsOnlyHitMiss,
+    NumTracks
+};
+
+struct sim_config_t {
+   bool vp_enable = false;
+   bool vp_perfect = false;
+   uint64_t vp_track = 0;
+   uint64_t window_size = 512;
+   uint64_t fetch_width = 16;
+   uint64_t fetch_num_branch = 16;		// 0: unlimited; >0: finite
+   bool fetch_stop_at_indirect = true;
+   bool fetch_stop_at_taken = true;
+   bool fetch_model_icache = true;
+
+   bool perfect_branch_pred = false;
+   bool perfect_indirect_pred = false;
+   uint64_t pipeline_fill_latency = 5;
+   uint64_t num_ldst_lanes = 8;
+   uint64_t num_alu_lanes = 16;
+
+   bool prefetcher_enable = true;
+   bool perfect_cache = false;
+   bool write_allocate = true;
+
+   uint64_t ic_size = (1 << 17);
+   uint64_t ic_assoc = 8;
+   uint64_t ic_blocksize = 64;
+
+   uint64_t l1_size = (1 << 16);
+   uint64_t l1_assoc = 8;
+   uint64_t l1_blocksize = 64;
+   uint64_t l1_latency = 3;
+
+   uint64_t l2_size = (1 << 20);
+   uint64_t l2_assoc = 8;
+   uint64_t l2_blocksize = 64;
+   uint64_t l2_latency = 12;
+
+   uint64_t l3_size = (1 << 23);
+   uint64_t l3_assoc = 16;
+   uint64_t l3_blocksize = 128;
+   uint64_t l3_latency = 60;
+
+   uint64_t main_memory_latency = 150;
+
+   // If argv[i] is a simulator option, applies it, advances i past it and its value, and returns true.
+   // Prints usage and exits if its value is missing or malformed.
+   bool parse_option(int argc, char **argv, int &i);
+
+   // Applies the simulator options in "options", separated by white space ('#' comments out the rest of a line).
+   // Returns false if one of them is not a simulator option.
+   bool parse_string(const std::string &options);
+
+   // Applies the simulator options in configuration file "name" (same syntax as parse_string()).
+   // Returns false if the file cannot be read or holds something other than simulator options.
+   bool parse_file(const char *name);
+};
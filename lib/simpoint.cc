@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+#include <assert.h>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "simpoint.h"
+
+bool simpoints_t::read(const char *name) {
+   std::ifstream file(name);
+   if (!file)
+      return(false);
+   interval_size = 0;
+   points.clear();
+   std::string line;
+   while (std::getline(file, line)) {
+      std::istringstream tokens(line.substr(0, line.find('#')));
+      std::string first;
+      if (!(tokens >> first))
+         continue;
+      if (first == "interval_size") {
+         if (!(tokens >> interval_size))
+            return(false);
+      }
+      else {
+         simpoint_t point;
+         std::istringstream interval(first);
+         if (!(interval >> point.interval) || !(tokens >> point.weight))
+            return(false);
+         points.push_back(point);
+      }
+   }
+   std::sort(points.begin(), points.end(), [](const simpoint_t &a, const simpoint_t &b) { return(a.interval < b.interval); });
+   return(interval_size && !points.empty());
+}
+
+bool simpoints_t::write(const char *name, const char *comment) const {
+   FILE *fp = fopen(name, "w");
+   if (!fp)
+      return(false);
+   fprintf(fp, "# %s\n", comment);
+   fprintf(fp, "interval_size %" PRIu64 "\n", interval_size);
+   fprintf(fp, "# interval weight\n");
+   for (const simpoint_t &point : points)
+      fprintf(fp, "%" PRIu64 " %.6f\n", point.interval, point.weight);
+   return(fclose(fp) == 0);
+}
+
+// Coordinate d of the random projection of basic block "pc", uniform in [-1, 1).
+static double project(uint64_t pc, unsigned d) {
+   uint64_t z = (pc ^ ((d + 1) * 0x9E3779B97F4A7C15ull));
+   z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull);
+   z = ((z ^ (z >> 27)) * 0x94D049BB133111EBull);
+   z = (z ^ (z >> 31));
+   return((double)(z >> 11) * (2.0 / (double)(1ull << 53)) - 1.0);
+}
+
+bbv_profile_t::bbv_profile_t(uint64_t interval_size) : interval_size(interval_size) {
+   assert(interval_size);
+   interval = 0;
+   interval_uops = 0;
+   for (unsigned d = 0; d < SIMPOINT_DIMS; d++)
+      vector[d] = 0.0;
+   block_pc = 0;
+   block_uops = 0;
+}
+
+void bbv_profile_t::end_block() {
+   for (unsigned d = 0; d < SIMPOINT_DIMS; d++)
+      vector[d] += ((double)block_uops * project(block_pc, d));
+   block_uops = 0;
+}
+
+void bbv_profile_t::end_interval() {
+   std::vector<double> v(SIMPOINT_DIMS);
+   for (unsigned d = 0; d < SIMPOINT_DIMS; d++) {
+      v[d] = (interval_uops ? (vector[d] / (double)interval_uops) : 0.0);
+      vector[d] = 0.0;
+   }
+   vectors.push_back(v);
+   interval_uops = 0;
+}
+
+void bbv_profile_t::add(const db_t *inst, size_t n, uint64_t instr) {
+   // Intervals are told apart at batch granularity: a batch belongs to the interval it starts in.
+   while (instr / interval_size > interval) {
+      if (block_uops)
+         end_block();
+      end_interval();
+      interval++;
+   }
+
+   for (size_t i = 0; i < n; i++) {
+      if (!block_uops)
+         block_pc = inst[i].pc;
+      block_uops++;
+      interval_uops++;
+      if ((inst[i].insn == InstClass::condBranchInstClass) ||
+          (inst[i].insn == InstClass::uncondDirectBranchInstClass) ||
+          (inst[i].insn == InstClass::uncondIndirectBranchInstClass))
+         end_block();
+   }
+}
+
+void bbv_profile_t::finish(uint64_t instr) {
+   if (block_uops)
+      end_block();
+   // The last interval is shorter: keep it if it is at least half long (or the only one).
+   if (interval_uops && (vectors.empty() || (2 * (instr - interval * interval_size) >= interval_size)))
+      end_interval();
+}
+
+static double distance2(const std::vector<double> &a, const std::vector<double> &b) {
+   double d2 = 0.0;
+   for (size_t d = 0; d < a.size(); d++)
+      d2 += ((a[d] - b[d]) * (a[d] - b[d]));
+   return(d2);
+}
+
+// One k-means run from k-means++ initial centers. Returns the sum of squared distances to the centers.
+static double kmeans(const std::vector<std::vector<double> > &vectors, unsigned k, std::mt19937_64 &rng,
+                     std::vector<std::vector<double> > &centers, std::vector<unsigned> &cluster) {
+   size_t n = vectors.size();
+   std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+   // k-means++: each next center is drawn with probability proportional to the squared distance to the closest one.
+   centers.assign(1, vectors[rng() % n]);
+   std::vector<double> closest(n);
+   for (size_t i = 0; i < n; i++)
+      closest[i] = distance2(vectors[i], centers[0]);
+   while (centers.size() < k) {
+      double sum = 0.0;
+      for (size_t i = 0; i < n; i++)
+         sum += closest[i];
+      size_t next = 0;
+      if (sum > 0.0) {
+         double r = (uniform(rng) * sum);
+         while ((next < n - 1) && ((r -= closest[next]) > 0.0))
+            next++;
+      }
+      centers.push_back(vectors[next]);
+      for (size_t i = 0; i < n; i++)
+         closest[i] = std::min(closest[i], distance2(vectors[i], centers.back()));
+   }
+
+   cluster.assign(n, 0);
+   double distortion = 0.0;
+   for (unsigned iter = 0; iter < SIMPOINT_KMEANS_ITERS; iter++) {
+      bool changed = false;
+      distortion = 0.0;
+      for (size_t i = 0; i < n; i++) {
+         unsigned best = 0;
+         double best_d2 = distance2(vectors[i], centers[0]);
+         for (unsigned c = 1; c < k; c++) {
+            double d2 = distance2(vectors[i], centers[c]);
+            if (d2 < best_d2) {
+               best = c;
+               best_d2 = d2;
+            }
+         }
+         changed |= ((iter == 0) || (cluster[i] != best));
+         cluster[i] = best;
+         distortion += best_d2;
+      }
+      if (!changed)
+         break;
+
+      // Move the centers to the mean of their clusters (empty clusters keep their center).
+      std::vector<std::vector<double> > sums(k, std::vector<double>(vectors[0].size(), 0.0));
+      std::vector<size_t> sizes(k, 0);
+      for (size_t i = 0; i < n; i++) {
+         for (size_t d = 0; d < vectors[i].size(); d++)
+            sums[cluster[i]][d] += vectors[i][d];
+         sizes[cluster[i]]++;
+      }
+      for (unsigned c = 0; c < k; c++)
+         if (sizes[c])
+            for (size_t d = 0; d < sums[c].size(); d++)
+               centers[c][d] = (sums[c][d] / (double)sizes[c]);
+   }
+   return(distortion);
+}
+
+// Bayesian information criterion of a clustering, for spherical Gaussian clusters of equal variance.
+static double bic(size_t n, size_t dims, unsigned k, double distortion, const std::vector<unsigned> &cluster) {
+   if (n <= k)
+      return(-INFINITY);
+   double variance = std::max(distortion / (double)(dims * (n - k)), 1e-12);
+   std::vector<size_t> sizes(k, 0);
+   for (unsigned c : cluster)
+      sizes[c]++;
+   double likelihood = 0.0;
+   for (unsigned c = 0; c < k; c++)
+      if (sizes[c])
+         likelihood += ((double)sizes[c] * log((double)sizes[c] / (double)n));
+   likelihood -= ((double)(n * dims) / 2.0 * log(2.0 * M_PI * variance));
+   likelihood -= (distortion / (2.0 * variance));
+   double parameters = ((double)k * (double)(dims + 1));
+   return(likelihood - parameters / 2.0 * log((double)n));
+}
+
+simpoints_t pick_simpoints(const std::vector<std::vector<double> > &vectors, uint64_t interval_size, unsigned max_k, uint64_t seed) {
+   simpoints_t simpoints;
+   simpoints.interval_size = interval_size;
+   size_t n = vectors.size();
+   if (n == 0)
+      return(simpoints);
+   max_k = std::max(1u, (unsigned)std::min((size_t)max_k, n));
+
+   // Best of several runs for each k.
+   std::mt19937_64 rng(seed);
+   std::vector<std::vector<unsigned> > clusters(max_k + 1);
+   std::vector<std::vector<std::vector<double> > > centers(max_k + 1);
+   std::vector<double> scores(max_k + 1);
+   for (unsigned k = 1; k <= max_k; k++) {
+      double best = INFINITY;
+      for (unsigned run = 0; run < SIMPOINT_KMEANS_RUNS; run++) {
+         std::vector<std::vector<double> > c;
+         std::vector<unsigned> a;
+         double distortion = kmeans(vectors, k, rng, c, a);
+         if (distortion < best) {
+            best = distortion;
+            centers[k] = c;
+            clusters[k] = a;
+         }
+      }
+      scores[k] = ((n > k) ? bic(n, vectors[0].size(), k, best, clusters[k]) : -INFINITY);
+   }
+
+   // The smallest k that scores close enough to the best k.
+   double lo = INFINITY, hi = -INFINITY;
+   for (unsigned k = 1; k <= max_k; k++) {
+      if (std::isfinite(scores[k])) {
+         lo = std::min(lo, scores[k]);
+         hi = std::max(hi, scores[k]);
+      }
+   }
+   unsigned k = 1;
+   if (hi > lo)
+      while ((k < max_k) && !(std::isfinite(scores[k]) && (scores[k] >= lo + SIMPOINT_BIC_THRESHOLD * (hi - lo))))
+         k++;
+
+   // Each cluster is represented by the interval closest to its center.
+   for (unsigned c = 0; c < k; c++) {
+      size_t size = 0, closest = 0;
+      double closest_d2 = INFINITY;
+      for (size_t i = 0; i < n; i++) {
+         if (clusters[k][i] != c)
+            continue;
+         size++;
+         double d2 = distance2(vectors[i], centers[k][c]);
+         if (d2 < closest_d2) {
+            closest = i;
+            closest_d2 = d2;
+         }
+      }
+      if (size)
+         simpoints.points.push_back({closest, (double)size / (double)n});
+   }
+   std::sort(simpoints.points.begin(), simpoints.points.end(), [](const simpoint_t &a, const simpoint_t &b) { return(a.interval < b.interval); });
+   return(simpoints);
+}
+
+void simpoint_estimate_t::add(const simpoint_t &point, uint64_t instructions, uint64_t cycles, uint64_t vp_correct, uint64_t vp_incorrect) {
+   measured.push_back({point, instructions, cycles, vp_correct, vp_incorrect});
+}
+
+// CPIs (not IPCs) are averaged by weight: they add up over the instructions of the trace.
+void simpoint_estimate_t::output(bool vp) {
+   printf("SIMULATION POINTS----------------------------------\n");
+   printf("%10s %8s %12s %8s%s\n", "interval", "weight", "instructions", "IPC", (vp ? "  VP accuracy" : ""));
+   double weights = 0.0, cpi = 0.0, vp_weights = 0.0, accuracy = 0.0;
+   for (const point_t &p : measured) {
+      if (!p.instructions)
+         continue;
+      double p_cpi = ((double)p.cycles / (double)p.instructions);
+      printf("%10" PRIu64 " %8.4f %12" PRIu64 " %8.3f", p.point.interval, p.point.weight, p.instructions, 1.0 / p_cpi);
+      weights += p.point.weight;
+      cpi += (p.point.weight * p_cpi);
+      uint64_t predictions = (p.vp_correct + p.vp_incorrect);
+      if (vp && predictions) {
+         double p_accuracy = ((double)p.vp_correct / (double)predictions);
+         printf("  %10.2f%%", 100.0 * p_accuracy);
+         vp_weights += p.point.weight;
+         accuracy += (p.point.weight * p_accuracy);
+      }
+      printf("\n");
+   }
+   if (weights == 0.0) {
+      printf("No simulation point was simulated: is the simulation point file from this trace?\n");
+      return;
+   }
+   if (weights < 0.999)
+      printf("Points simulated cover %.1f%% of the weight (the trace ended early).\n", 100.0 * weights);
+   printf("estimated IPC         = %.3f\n", weights / cpi);
+   if (vp) {
+      if (vp_weights > 0.0)
+         printf("estimated VP accuracy = %.2f%%\n", 100.0 * accuracy / vp_weights);
+      else
+         printf("estimated VP accuracy = n/a (no predictions)\n");
+   }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// Representative-interval simulation (SimPoint).
+//
+// cvp-simpoint splits a trace into intervals of a fixed number of trace
+// instructions and profiles the basic-block vector of each interval: how many
+// micro-ops it executed in each basic block (a block ends at a branch). The
+// vectors are randomly projected to a few dimensions as they are collected,
+// clustered with k-means (k chosen by the Bayesian information criterion), and
+// the interval closest to the center of each cluster becomes a simulation
+// point, weighted by the fraction of intervals in its cluster.
+//
+// cvp -x simulates only the simulation points, each after functionally warming
+// the simulator, and combines their measurements by weight into whole-trace
+// estimates (simpoint_estimate_t).
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+
+struct db_t;
+
+#define SIMPOINT_DIMS		15	// dimensions of the projected basic-block vectors
+#define SIMPOINT_KMEANS_RUNS	5	// k-means runs (random initial centers) per k, the best is kept
+#define SIMPOINT_KMEANS_ITERS	100	// maximum k-means iterations per run
+#define SIMPOINT_BIC_THRESHOLD	0.9	// smallest k whose BIC is within 90% of the best BIC's range
+
+struct simpoint_t {
+   uint64_t interval;	// index of the interval (its first trace instruction is interval * interval_size)
+   double weight;	// fraction of the trace's intervals that it represents
+};
+
+struct simpoints_t {
+   uint64_t interval_size = 0;	// trace instructions per interval
+   std::vector<simpoint_t> points;	// by increasing interval
+
+   // Simulation point files hold "interval_size <n>", then one "<interval> <weight>" line per point
+   // ('#' starts a comment). read() returns false if the file cannot be read or is malformed.
+   bool read(const char *name);
+   bool write(const char *name, const char *comment) const;
+};
+
+// Collects the projected basic-block vectors of a trace's intervals.
+class bbv_profile_t {
+private:
+   uint64_t interval_size;
+   uint64_t interval;		// interval being profiled
+   uint64_t interval_uops;	// micro-ops in it so far
+   double vector[SIMPOINT_DIMS];
+
+   uint64_t block_pc;		// first micro-op of the current basic block
+   uint64_t block_uops;		// micro-ops in it so far
+
+   void end_block();
+   void end_interval();
+
+public:
+   std::vector<std::vector<double> > vectors;	// one per complete interval, normalized to the interval's length
+
+   bbv_profile_t(uint64_t interval_size);
+
+   // Profiles inst[0..n-1]; "instr" is the number of trace instructions read before inst[0].
+   void add(const db_t *inst, size_t n, uint64_t instr);
+
+   // Ends the profile after "instr" trace instructions: the last interval is kept if it is at least half long.
+   void finish(uint64_t instr);
+};
+
+// Clusters the vectors and returns one simulation point per cluster. k is at most max_k.
+simpoints_t pick_simpoints(const std::vector<std::vector<double> > &vectors, uint64_t interval_size, unsigned max_k, uint64_t seed);
+
+// Whole-trace estimates from the measurements of the simulation points.
+class simpoint_estimate_t {
+private:
+   struct point_t {
+      simpoint_t point;
+      uint64_t instructions;
+      uint64_t cycles;
+      uint64_t vp_correct;
+      uint64_t vp_incorrect;
+   };
+   std::vector<point_t> measured;
+
+public:
+   void add(const simpoint_t &point, uint64_t instructions, uint64_t cycles, uint64_t vp_correct, uint64_t vp_incorrect);
+   void output(bool vp);
+};
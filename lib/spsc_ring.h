@@ -0,0 +1,119 @@
+#pragma once
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread.
+//
+// The producer owns tail and the consumer owns head. Each side keeps a private
+// copy of the other side's index and only reloads the shared one when the ring
+// looks full (producer) or empty (consumer), so the common case touches no
+// cache line written by the other thread.
+
+#include <atomic>
+#include <inttypes.h>
+#include <assert.h>
+
+template <class T>
+class spsc_ring_t {
+private:
+	T *q;
+	uint64_t mask;		// size - 1, size is a power of two
+
+	alignas(64) std::atomic<uint64_t> head;	// next entry to pop (written by consumer)
+	uint64_t cached_tail;			// consumer's copy of tail
+
+	alignas(64) std::atomic<uint64_t> tail;	// next entry to push (written by producer)
+	uint64_t cached_head;			// producer's copy of head
+
+public:
+	spsc_ring_t(uint64_t size);
+	~spsc_ring_t();
+	bool push(const T &value);	// producer: returns false if full
+	bool pop(T &value);		// consumer: returns false if empty
+	bool empty();			// consumer: returns true if nothing left to pop
+
+	// In-place variants for large entries: fill or read the entry inside the ring instead of copying it.
+	T *alloc();			// producer: returns the tail entry to fill, or NULL if full
+	void publish();			// producer: pushes the entry returned by alloc()
+	T *front();			// consumer: returns the head entry, or NULL if empty
+	void release();			// consumer: pops the entry returned by front()
+};
+
+template <class T>
+spsc_ring_t<T>::spsc_ring_t(uint64_t size) {
+   assert(size && ((size & (size - 1)) == 0));
+   q = new T[size];
+   mask = size - 1;
+   head.store(0, std::memory_order_relaxed);
+   tail.store(0, std::memory_order_relaxed);
+   cached_head = 0;
+   cached_tail = 0;
+}
+
+template <class T>
+spsc_ring_t<T>::~spsc_ring_t() {
+   delete [] q;
+}
+
+// push value at tail entry
+template <class T>
+bool spsc_ring_t<T>::push(const T &value) {
+   uint64_t t = tail.load(std::memory_order_relaxed);
+   if (t - cached_head > mask) {
+      cached_head = head.load(std::memory_order_acquire);
+      if (t - cached_head > mask)
+         return(false);
+   }
+   q[t & mask] = value;
+   tail.store(t + 1, std::memory_order_release);
+   return(true);
+}
+
+// pop head entry into value
+template <class T>
+bool spsc_ring_t<T>::pop(T &value) {
+   uint64_t h = head.load(std::memory_order_relaxed);
+   if (h == cached_tail) {
+      cached_tail = tail.load(std::memory_order_acquire);
+      if (h == cached_tail)
+         return(false);
+   }
+   value = q[h & mask];
+   head.store(h + 1, std::memory_order_release);
+   return(true);
+}
+
+template <class T>
+T *spsc_ring_t<T>::alloc() {
+   uint64_t t = tail.load(std::memory_order_relaxed);
+   if (t - cached_head > mask) {
+      cached_head = head.load(std::memory_order_acquire);
+      if (t - cached_head > mask)
+         return(NULL);
+   }
+   return(&q[t & mask]);
+}
+
+template <class T>
+void spsc_ring_t<T>::publish() {
+   tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <class T>
+T *spsc_ring_t<T>::front() {
+   uint64_t h = head.load(std::memory_order_relaxed);
+   if (h == cached_tail) {
+      cached_tail = tail.load(std::memory_order_acquire);
+      if (h == cached_tail)
+         return(NULL);
+   }
+   return(&q[h & mask]);
+}
+
+template <class T>
+void spsc_ring_t<T>::release() {
+   head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <class T>
+bool spsc_ring_t<T>::empty() {
+   return(head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire));
+}
@@ -0,0 +1,158 @@
+#include <string.h>
+#include <assert.h>
+#include "store_queue.h"
+#include "checkpoint.h"
+
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+static inline uint64_t granule_hash(uint64_t tag) {
+   return((tag * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+store_queue_t::store_queue_t(uint64_t window_size) {
+   // A store spans at most a few granules: start with room for two per window entry at half load.
+   uint64_t n = 64;
+   while (n < 4 * window_size)
+      n *= 2;
+   table.resize(n);
+   memset(table.data(), 0, n * sizeof(granule_t));
+   count = 0;
+
+   stores.resize(n);
+   stores_head = 0;
+   stores_count = 0;
+   next_seq = 0;
+}
+
+uint64_t store_queue_t::slot(uint64_t tag) const {
+   uint64_t mask = table.size() - 1;
+   uint64_t i = (granule_hash(tag) & mask);
+   while (table[i].mask && (table[i].tag != tag))
+      i = ((i + 1) & mask);
+   return(i);
+}
+
+// Backward-shift deletion: moves later entries of the probe sequence into the hole, so lookups need no tombstones.
+void store_queue_t::erase(uint64_t i) {
+   uint64_t mask = table.size() - 1;
+   uint64_t j = i;
+   while (true) {
+      j = ((j + 1) & mask);
+      if (!table[j].mask)
+         break;
+      uint64_t home = (granule_hash(table[j].tag) & mask);
+      // Entry j can fill hole i if its home slot is not in (i, j] (cyclically).
+      if (((j > i) && ((home <= i) || (home > j))) || ((j < i) && ((home <= i) && (home > j)))) {
+         table[i] = table[j];
+         i = j;
+      }
+   }
+   table[i].mask = 0;
+   count--;
+}
+
+void store_queue_t::grow() {
+   std::vector<granule_t> old;
+   old.swap(table);
+   table.resize(2 * old.size());
+   memset(table.data(), 0, table.size() * sizeof(granule_t));
+   for (const granule_t &g : old)
+      if (g.mask)
+         table[slot(g.tag)] = g;
+}
+
+void store_queue_t::push_store(uint64_t tag, uint64_t seq) {
+   if (stores_count == stores.size()) {
+      // Unroll the circular buffer into one twice as large.
+      std::vector<written_t> bigger(2 * stores.size());
+      for (uint64_t k = 0; k < stores_count; k++)
+         bigger[k] = stores[(stores_head + k) & (stores.size() - 1)];
+      stores.swap(bigger);
+      stores_head = 0;
+   }
+   stores[(stores_head + stores_count) & (stores.size() - 1)] = {tag, seq};
+   stores_count++;
+}
+
+uint64_t store_queue_t::load(uint64_t addr, uint64_t size, uint64_t cycle, uint64_t data_cache_cycle, bool &miss) const {
+   uint64_t ready = 0;
+   uint64_t end = addr + size;
+   while (addr < end) {
+      uint64_t tag = (addr >> SQ_GRANULE_BITS);
+      uint64_t last = ((tag + 1) << SQ_GRANULE_BITS);
+      if (last > end)
+         last = end;
+      const granule_t &g = table[slot(tag)];
+      for (; addr < last; addr++) {
+         unsigned b = (addr & (SQ_GRANULE_SIZE - 1));
+         if ((g.mask & (1 << b)) && (cycle < g.ret_cycle[b])) {
+            // SQ hit: the byte's timestamp is the later of load's execution cycle and store's execution cycle
+            ready = MAX(ready, MAX(cycle, g.exec_cycle[b]));
+         }
+         else {
+            // SQ miss: the byte's timestamp is its availability in L1 D$
+            ready = MAX(ready, data_cache_cycle);
+            miss = true;
+         }
+      }
+   }
+   return(ready);
+}
+
+void store_queue_t::store(uint64_t addr, uint64_t size, uint64_t exec_cycle, uint64_t ret_cycle) {
+   uint64_t seq = next_seq++;
+   uint64_t end = addr + size;
+   while (addr < end) {
+      if (2 * (count + 1) > table.size())
+         grow();
+
+      uint64_t tag = (addr >> SQ_GRANULE_BITS);
+      uint64_t last = ((tag + 1) << SQ_GRANULE_BITS);
+      if (last > end)
+         last = end;
+      granule_t &g = table[slot(tag)];
+      if (!g.mask) {
+         g.tag = tag;
+         g.ret_max = 0;
+         count++;
+      }
+      for (; addr < last; addr++) {
+         unsigned b = (addr & (SQ_GRANULE_SIZE - 1));
+         g.mask |= (1 << b);
+         g.exec_cycle[b] = exec_cycle;
+         g.ret_cycle[b] = ret_cycle;
+      }
+      g.ret_max = MAX(g.ret_max, ret_cycle);
+      g.seq = seq;
+      push_store(tag, seq);
+   }
+}
+
+void store_queue_t::retire(uint64_t cycle) {
+   while (stores_count) {
+      const written_t &w = stores[stores_head];
+      uint64_t i = slot(w.tag);
+      if (table[i].mask && (table[i].seq == w.seq)) {
+         // Oldest granule still owned by its store: wait for all its bytes to commit.
+         if (table[i].ret_max > cycle)
+            break;
+         erase(i);
+      }
+      // Otherwise a later store wrote the granule and its own entry in stores will drop it.
+      stores_head = ((stores_head + 1) & (stores.size() - 1));
+      stores_count--;
+   }
+}
+
+void store_queue_t::checkpoint(checkpoint_t &ck) {
+   ck.section("store queue");
+   ck.io(table);
+   ck.io(count);
+   ck.io(stores);
+   ck.io(stores_head);
+   ck.io(stores_count);
+   ck.io(next_seq);
+   // Both tables are indexed by masking with their size.
+   if (ck.restoring() && ck.good() && ((table.size() & (table.size() - 1)) || (stores.size() & (stores.size() - 1)) || table.empty() || stores.empty()))
+      ck.fail("corrupt store queue");
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// Store queue: byte timestamps of the stores a load may forward from.
+//
+// A load byte hits in the SQ if the youngest store to that byte has not
+// committed by the time the load searches the SQ. Stores are kept in an
+// open-addressing hash table of 8-byte granules, each holding per-byte
+// timestamps and a byte mask, so a load checks one or two entries instead of
+// walking a per-byte map. Fetch cycles never decrease and a load searches the
+// SQ after its fetch cycle, so a store whose commit cycle is not after the
+// current fetch cycle can never be hit again: retire() drops those, which
+// keeps the table sized to the stores in flight rather than the program's
+// store footprint.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <vector>
+
+class checkpoint_t;
+
+#define SQ_GRANULE_BITS		3
+#define SQ_GRANULE_SIZE		(1 << SQ_GRANULE_BITS)
+
+class store_queue_t {
+private:
+   struct granule_t {
+      uint64_t tag;			// address >> SQ_GRANULE_BITS
+      uint64_t seq;			// store that wrote the granule last (see stores)
+      uint64_t ret_max;			// latest commit cycle among the granule's bytes
+      uint64_t exec_cycle[SQ_GRANULE_SIZE];	// store's execution cycle, per byte
+      uint64_t ret_cycle[SQ_GRANULE_SIZE];	// store's commit cycle, per byte
+      uint8_t mask;			// bytes written (0: free entry)
+   };
+
+   struct written_t {
+      uint64_t tag;
+      uint64_t seq;
+   };
+
+   std::vector<granule_t> table;	// power-of-two size, linear probing
+   uint64_t count;			// entries in use
+
+   // Granules written, in program order. An entry is dropped by retire() when it reaches the head,
+   // if the store it names was the last to write the granule and has committed.
+   std::vector<written_t> stores;	// circular, power-of-two size
+   uint64_t stores_head;
+   uint64_t stores_count;
+   uint64_t next_seq;
+
+   uint64_t slot(uint64_t tag) const;	// entry holding tag, or the free entry where it goes
+   void erase(uint64_t i);
+   void grow();
+   void push_store(uint64_t tag, uint64_t seq);
+
+public:
+   // window_size: initial sizing (the table grows if more stores are in flight).
+   store_queue_t(uint64_t window_size);
+
+   // Returns the cycle the bytes [addr, addr + size) of a load searching the SQ at "cycle" are available:
+   // for bytes that hit, the later of "cycle" and the store's execution cycle; for bytes that miss, data_cache_cycle.
+   // Sets miss if any byte misses.
+   uint64_t load(uint64_t addr, uint64_t size, uint64_t cycle, uint64_t data_cache_cycle, bool &miss) const;
+
+   // Records a store to [addr, addr + size).
+   void store(uint64_t addr, uint64_t size, uint64_t exec_cycle, uint64_t ret_cycle);
+
+   // Drops stores that committed at or before "cycle", which no load searching the SQ after "cycle" can hit.
+   void retire(uint64_t cycle);
+
+   uint64_t size() const { return(count); }	// granules held
+
+   void checkpoint(checkpoint_t &ck);
+};
@@ -4,8 +4,10 @@
 #include <vector>
 #include <deque>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <optional>
+#include "checkpoint.h"
 
 #define DEF_ENUM(ENUM, NAME) _DEF_ENUM(ENUM, NAME)
 #define _DEF_ENUM(ENUM, NAME)                          \
@@ -126,6 +128,8 @@ class StridePrefetcher
             rpt[i].index = i;
             rpt[i].lru = i;
         }
+        lru_info = n - 1;
+        index_of_tag.clear();
         //Clear queue of generated prefetches
         queue.clear();
     }
@@ -135,9 +139,10 @@ class StridePrefetcher
         init(NUM_RPT_ENTRIES);
     }
 
+    // LRU entry: lru holds the time of the last use (a scan, but only on RPT misses).
     uint64_t victim_way()
     {
-        auto entry = std::find_if(rpt.begin(), rpt.end(), [](RPTEntry& e){ return !e.lru; });
+        auto entry = std::min_element(rpt.begin(), rpt.end(), [](const RPTEntry& a, const RPTEntry& b){ return a.lru < b.lru; });
         assert((entry != rpt.end()) && "Must find a valid victim way ");
         spdlog::debug("Prefetch: Found victim entry : {}", *entry);
 
@@ -147,17 +152,22 @@ class StridePrefetcher
     void update_lru(uint64_t index)
     {
         spdlog::debug("Updating LRU Index: {}", index);
-        auto& lru_way = rpt[index];
-        std::for_each(rpt.begin(), rpt.end(), [&lru_way](RPTEntry &e) { if(e.lru > lru_way.lru){ --e.lru;} });
-        lru_way.lru = (NUM_RPT_ENTRIES - 1);
+        rpt[index].lru = ++lru_info;
+    }
+
+    // Entry holding tag, if any.
+    RPTEntry* lookup(uint64_t tag)
+    {
+        auto it = index_of_tag.find(tag);
+        return ((it == index_of_tag.end()) ? nullptr : &rpt[it->second]);
     }
 
     // Prefetches will be generated when the load is fetched as in "Effective Hardware-Based Data Prefetching for High-Performance Processors"
     // However because we train immediately, there is no need for a count variable.
     void lookahead(uint64_t la_pc, uint64_t cycle)
     {
-        auto entry = std::find_if(rpt.begin(), rpt.end(), [la_pc](RPTEntry& e){ return e.tag == la_pc; });
-        if(entry == rpt.end())
+        RPTEntry* entry = lookup(la_pc);
+        if(!entry)
         {
             return;
         }
@@ -170,12 +180,17 @@ class StridePrefetcher
     void train(const PrefetchTrainingInfo & info)
     {
         spdlog::debug("Prefetcher: Training on LD {}", info);
-        auto entry = std::find_if(rpt.begin(), rpt.end(), [&info](RPTEntry& e){ return e.tag == info.pc; });
-        if(entry == rpt.end())
+        RPTEntry* entry = lookup(info.pc);
+        if(!entry)
         {
             //Establish a new entry
             auto victim_index = victim_way();
             auto& victim_entry = rpt[victim_index];
+            if(victim_entry.state != PrefetcherState::Invalid)
+            {
+                index_of_tag.erase(victim_entry.tag);
+            }
+            index_of_tag[info.pc] = victim_index;
             victim_entry.state = PrefetcherState::Initial;
             victim_entry.tag = info.pc;
             victim_entry.prev_address = 0xdeadbeef;
@@ -356,6 +371,22 @@ class StridePrefetcher
         }
     }
 
+    void checkpoint(checkpoint_t &ck)
+    {
+        ck.section("prefetcher");
+        ck.array(rpt.data(), rpt.size(), "prefetcher RPT");
+        ck.io(lru_info);
+        ck.io(index_of_tag);
+        ck.io(queue);
+        ck.io(stat_trainings);
+        ck.io(stat_generated);
+        ck.io(stat_issued);
+        ck.io(stat_duplicate_pf_filtered);
+        ck.io(stat_dropped_untimely_pf);
+        ck.io(stat_put_back);
+        ck.io(stat_stride_zero);
+    }
+
     void print_stats()
     {
         std::cout << "Num Trainings :" << std::dec << stat_trainings  <<std::endl;
@@ -368,7 +399,10 @@ class StridePrefetcher
     }
     private:
     std::array<RPTEntry, NUM_RPT_ENTRIES> rpt;
-    uint64_t lru_info;
+    uint64_t lru_info;	// time of the last use of an entry
+
+    // Index in rpt of the valid entries (a fully associative lookup without scanning the RPT).
+    std::unordered_map<uint64_t, uint64_t> index_of_tag;
 
     //Queue to store generated prefetches
     std::deque<Prefetch> queue;
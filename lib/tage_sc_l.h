@@ -16,6 +16,8 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
+#include "checkpoint.h"
 
 #ifndef _TAGE_SC_L_H_
 #define _TAGE_SC_L_H_
@@ -361,6 +363,16 @@ public:
     predictorsize();
 #endif
   }
+
+  // gtable[2..BORN-1] and gtable[BORN+1..NHIST] share the arrays of gtable[1] and gtable[BORN].
+  ~PREDICTOR() {
+#ifdef LOOPPREDICTOR
+    delete[] ltable;
+#endif
+    delete[] gtable[1];
+    delete[] gtable[BORN];
+    delete[] btable;
+  }
   int predictorsize() {
     int STORAGESIZE = 0;
     int inter = 0;
@@ -444,6 +456,39 @@ public:
     return (STORAGESIZE);
   }
 
+  // The predictor is plain data, but its table pointers only make sense in this process: they are kept across
+  // the raw copy of the object, and the tables follow it.
+  void checkpoint(checkpoint_t &ck) {
+    ck.section("TAGE-SC-L");
+    ck.shape(sizeof(*this), "TAGE-SC-L");
+    std::vector<char> self((char *)this, (char *)this + sizeof(*this));
+    ck.bytes(this, sizeof(*this));
+    if (ck.restoring()) {
+#define KEEP(member) memcpy(&member, &self[(char *)&member - (char *)this], sizeof(member))
+#ifdef IMLI
+      KEEP(IGEHL);
+      KEEP(IMGEHL);
+#endif
+      KEEP(GGEHL);
+      KEEP(PGEHL);
+      KEEP(LGEHL);
+      KEEP(SGEHL);
+      KEEP(TGEHL);
+      KEEP(btable);
+      KEEP(gtable);
+#ifdef LOOPPREDICTOR
+      KEEP(ltable);
+#endif
+#undef KEEP
+    }
+    ck.array(btable, 1 << LOGB, "bimodal table");
+    ck.array(gtable[1], SizeTable[1], "TAGE low banks");
+    ck.array(gtable[BORN], SizeTable[BORN], "TAGE high banks");
+#ifdef LOOPPREDICTOR
+    ck.array(ltable, 1 << LOGL, "loop predictor");
+#endif
+  }
+
   void reinit() {
 
     m[1] = MINHIST;
@@ -505,7 +550,7 @@ public:
     Seed = 0;
 
     for (int i = 0; i < HISTBUFFERLENGTH; i++)
-      ghist[0] = 0;
+      ghist[i] = 0;
     ptghist = 0;
     updatethreshold = 35 << 3;
 
@@ -659,6 +704,21 @@ public:
     for (int i = 0; i < NSECLOCAL; i++) {
       S_slhist[i] = 0;
     }
+    for (int i = 0; i < NTLOCAL; i++) {
+      T_slhist[i] = 0;
+    }
+    // The predictor was a global: these used to start out zeroed.
+    for (int i = 0; i < (1 << LOGSIZEUPS); i++) {
+      WIM[i] = 0;
+    }
+    FirstH = 0;
+    SecondH = 0;
+    IMLIcount = 0;
+#ifdef IMLI
+    for (int i = 0; i < 256; i++) {
+      IMHIST[i] = 0;
+    }
+#endif
     GHIST = 0;
     ptghist = 0;
     phist = 0;
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "native_trace.h"
+#include "trace_cache.h"
+
+#define TRACE_CACHE_INITIAL_UOPS	(1 << 20)	// segment capacity, doubled as needed while decoding
+#define TRACE_CACHE_CREATE_WAIT_MS	1000		// how long a new, still empty segment may stay unlocked
+
+// Name of the trace's segment, from the file's identity. Returns false if the trace cannot be stat'ed.
+static bool segment_name(const char *name, char *seg, size_t size) {
+   struct stat st;
+   if (stat(name, &st))
+      return(false);
+
+   // FNV-1a over the fields that change when the file is replaced or rewritten.
+   uint64_t id[5] = {(uint64_t)st.st_dev, (uint64_t)st.st_ino, (uint64_t)st.st_size, (uint64_t)st.st_mtim.tv_sec, (uint64_t)st.st_mtim.tv_nsec};
+   uint64_t hash = 0xcbf29ce484222325ull;
+   const uint8_t *p = (const uint8_t *)id;
+   for (size_t i = 0; i < sizeof(id); i++)
+      hash = ((hash ^ p[i]) * 0x100000001b3ull);
+   snprintf(seg, size, "/cvp-trace-%016" PRIx64, hash);
+   return(true);
+}
+
+// True if the segment holds a complete native trace image (the magic is written last).
+static bool segment_ready(int fd) {
+   native_trace_header_t header;
+   struct stat st;
+   return((pread(fd, &header, sizeof(header), 0) == sizeof(header)) && !fstat(fd, &st) &&
+          !memcmp(header.magic, NATIVE_TRACE_MAGIC, sizeof(header.magic)) &&
+          (header.version == NATIVE_TRACE_VERSION) && (header.record_size == sizeof(native_uop_t)) &&
+          (((uint64_t)st.st_size - sizeof(header)) / sizeof(native_uop_t) >= header.num_uops));
+}
+
+// Waits until the process building the segment is done. Returns false if it died before completing it.
+static bool segment_wait(int fd) {
+   for (unsigned waited = 0; ; waited++) {
+      // The builder holds an exclusive lock until the segment is complete.
+      flock(fd, LOCK_SH);
+      bool ready = segment_ready(fd);
+      struct stat st;
+      bool empty = (!fstat(fd, &st) && (st.st_size == 0));
+      flock(fd, LOCK_UN);
+      if (ready)
+         return(true);
+
+      // A segment is created empty and locked right away: give its builder a moment to lock it.
+      if (!empty || (waited >= TRACE_CACHE_CREATE_WAIT_MS))
+         return(false);
+      usleep(1000);
+   }
+}
+
+// Sizes and maps the segment for "capacity" micro-ops. Returns NULL if there is not enough shared memory.
+static native_uop_t *segment_map(int fd, uint64_t capacity, void *&map, size_t &map_size) {
+   map_size = sizeof(native_trace_header_t) + capacity * sizeof(native_uop_t);
+   // posix_fallocate() reserves the pages, so running out of shared memory fails here rather than with a SIGBUS.
+   if (posix_fallocate(fd, 0, map_size))
+      return(NULL);
+   map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (map == MAP_FAILED)
+      return(NULL);
+   return((native_uop_t *)((uint8_t *)map + sizeof(native_trace_header_t)));
+}
+
+// Decodes the trace into the (locked, empty) segment. Returns false if it does not fit in shared memory.
+static bool segment_build(int fd, const char *name, const trace_options_t &options) {
+   trace_options_t direct = options;
+   direct.shared_cache = false;
+   direct.fields = TRACE_FIELDS_ALL;	// the segment serves every kind of simulation
+   trace_reader_t *reader = open_trace(name, direct);
+   if (CVPTraceReader *cvp = dynamic_cast<CVPTraceReader *>(reader))
+      cvp->mPrintSummary = false;
+
+   native_trace_header_t header;
+   memset(&header, 0, sizeof(header));
+   uint64_t capacity = TRACE_CACHE_INITIAL_UOPS;
+   void *map;
+   size_t map_size;
+   native_uop_t *uops = segment_map(fd, capacity, map, map_size);
+   bool ok = (uops != NULL);
+
+   db_t inst;
+   while (ok && reader->get_batch(&inst, 1)) {
+      if (header.num_uops == capacity) {
+         munmap(map, map_size);
+         capacity *= 2;
+         uops = segment_map(fd, capacity, map, map_size);
+         if (!uops) {
+            ok = false;
+            break;
+         }
+      }
+      // A micro-op is the first piece of its trace instruction if it made the reader consume a new trace instruction.
+      bool first_piece = (reader->num_instr() != header.num_instr);
+      native_encode(&inst, first_piece, uops[header.num_uops++]);
+      header.num_instr = reader->num_instr();
+   }
+   delete reader;
+
+   if (ok) {
+      // Publish the header, magic last, then drop the unused capacity.
+      header.version = NATIVE_TRACE_VERSION;
+      header.record_size = sizeof(native_uop_t);
+      memcpy(map, &header, sizeof(header));
+      __sync_synchronize();
+      memcpy(map, NATIVE_TRACE_MAGIC, sizeof(header.magic));
+      ok = !ftruncate(fd, sizeof(header) + header.num_uops * sizeof(native_uop_t));
+   }
+   else {
+      fprintf(stderr, "Not enough shared memory to cache %s, reading it directly\n", name);
+   }
+   if (uops)
+      munmap(map, map_size);
+   return(ok);
+}
+
+trace_reader_t *open_cached_trace(const char *name, const trace_options_t &options) {
+   char seg[64];
+   if (is_native_trace(name) || !segment_name(name, seg, sizeof(seg)))
+      return(nullptr);
+
+   for (int attempt = 0; attempt < 2; attempt++) {
+      // First process wins: it builds the segment under an exclusive lock.
+      int fd = shm_open(seg, O_RDWR | O_CREAT | O_EXCL, 0644);
+      if (fd >= 0) {
+         flock(fd, LOCK_EX);
+         fprintf(stderr, "Decoding %s into the shared trace cache\n", name);
+         if (segment_build(fd, name, options)) {
+            flock(fd, LOCK_UN);
+            return(new native_trace_reader_t(fd, name));
+         }
+         shm_unlink(seg);
+         close(fd);
+         return(nullptr);
+      }
+      if (errno != EEXIST)
+         return(nullptr);
+
+      // Everyone else waits for it to be complete, then maps it read-only.
+      fd = shm_open(seg, O_RDONLY, 0);
+      if (fd < 0)
+         continue;	// removed in the meantime
+      if (segment_wait(fd))
+         return(new native_trace_reader_t(fd, name));
+      close(fd);
+
+      // Its builder died: remove it and try again.
+      shm_unlink(seg);
+   }
+   return(nullptr);
+}
+
+int decode_trace(const char *name, const trace_options_t &options) {
+   if (is_native_trace(name))
+      return(open(name, O_RDONLY));
+
+   // The file only lives as long as it is open or mapped.
+   int fd = memfd_create("cvp-trace", 0);
+   if (fd < 0)
+      return(-1);
+   if (!segment_build(fd, name, options)) {
+      close(fd);
+      return(-1);
+   }
+   return(fd);
+}
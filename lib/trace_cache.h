@@ -0,0 +1,28 @@
+#pragma once
+
+// Host-wide cache of decoded traces in POSIX shared memory.
+//
+// Sweeping many configurations over the same trace runs many cvp processes
+// that each inflate, parse and crack the same file. With the cache, the first
+// process to open a trace decodes it once into a shared memory segment laid
+// out like a native trace (see native_trace.h); every other process, concurrent
+// or later, maps that segment read-only and skips decoding altogether. The
+// physical pages are shared, so the host holds one decoded copy of the trace.
+//
+// Segments are named after the trace file's identity (device, inode, size and
+// modification time), so a rewritten trace gets a new segment. A process that
+// finds a segment still being built waits for it. Segments outlive the
+// processes (that is the point); they live in /dev/shm as cvp-trace-* and are
+// removed with rm. Processes that have a segment mapped keep their mapping.
+
+#include "trace_reader.h"
+
+// Opens the trace through the shared memory cache, decoding it into the cache first if no other process has.
+// Returns nullptr if the trace cannot be cached (e.g., no shared memory space), in which case the caller should
+// read it directly. Native traces are not cached: they are already mapped.
+trace_reader_t *open_cached_trace(const char *name, const trace_options_t &options);
+
+// Decodes the trace into an anonymous memory file laid out like a native trace, private to the process, for
+// processes that simulate a trace several times (cvp-sweep): every native_trace_reader_t(dup(fd), name) maps
+// the same decoded pages. Native traces are just opened. Returns -1 if the trace does not fit in memory.
+int decode_trace(const char *name, const trace_options_t &options);
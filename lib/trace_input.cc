@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "trace_input.h"
+
+// Smallest output buffer accepted: must comfortably hold the largest trace record.
+#define MIN_TRACE_BUFFER_SIZE	(64 << 10)
+
+// Size of the gzip member trailer (CRC32 and ISIZE) that raw inflation leaves in the input.
+#define GZIP_TRAILER_SIZE	8
+
+#define IS_GZIP_MAGIC(p)	(((p)[0] == 0x1f) && ((p)[1] == 0x8b))
+
+gz_input_t::gz_input_t(const char *name, size_t buffer_size, unsigned read_ahead, bool drop_cache) : name(name) {
+   fd = open(name, O_RDONLY);
+   if (fd < 0) {
+      fprintf(stderr, "Cannot open trace %s\n", name);
+      exit(1);
+   }
+   struct stat st;
+   file_size = (fstat(fd, &st) ? 0 : st.st_size);
+
+   out_size = ((buffer_size < MIN_TRACE_BUFFER_SIZE) ? MIN_TRACE_BUFFER_SIZE : buffer_size);
+   out_buf = new uint8_t[out_size];
+   file = new read_ahead_t(fd, out_size / 4, read_ahead, drop_cache);
+
+   building = NULL;
+   index_tried = false;
+   have_index = false;
+
+   memset(&strm, 0, sizeof(strm));
+   input_eof = false;
+   file_offset = 0;
+   read_input();
+
+   // Like gzread(), pass files that are not gzip-compressed through unchanged.
+   compressed = ((strm.avail_in >= 2) && IS_GZIP_MAGIC(strm.next_in));
+   if (compressed) {
+      // 15 + 32: maximum window, automatic gzip/zlib header detection.
+      int ret = inflateInit2(&strm, 15 + 32);
+      assert(ret == Z_OK);
+   }
+
+   raw_deflate = false;
+   done = false;
+   member = 0;
+   out_total = 0;
+   cur = end = out_buf;
+}
+
+gz_input_t::~gz_input_t() {
+   if (compressed)
+      inflateEnd(&strm);
+   delete file;
+   close(fd);
+   delete [] out_buf;
+}
+
+bool gz_input_t::read_input() {
+   const uint8_t *p = NULL;
+   size_t num = (input_eof ? 0 : file->next(p));
+   if (num == 0)
+      input_eof = true;
+   file_offset += num;
+   strm.next_in = (Bytef *)p;
+   strm.avail_in = (uInt)num;
+   return (num > 0);
+}
+
+void gz_input_t::skip_input(size_t n) {
+   while (n) {
+      if ((strm.avail_in == 0) && !read_input())
+         return;
+      size_t k = ((n < strm.avail_in) ? n : strm.avail_in);
+      strm.next_in += k;
+      strm.avail_in -= k;
+      n -= k;
+   }
+}
+
+void gz_input_t::rewind() {
+   file->seek(0);
+   input_eof = false;
+   file_offset = 0;
+   read_input();
+   if (compressed)
+      inflateReset2(&strm, 15 + 32);
+
+   raw_deflate = false;
+   done = false;
+   member = 0;
+   out_total = 0;
+   cur = end = out_buf;
+}
+
+bool gz_input_t::restart(const gz_index_point_t *p) {
+   uint8_t window[GZ_INDEX_WINDOW];
+   if (!compressed || !index.read_window(p, window))
+      return(false);
+
+   // The block boundary may be in the middle of a byte: its low "bits" bits are fed to inflate separately.
+   uint64_t start = p->in_offset - (p->bits ? 1 : 0);
+   file->seek(start);
+   input_eof = false;
+   file_offset = start;
+   if (!read_input())
+      return(false);
+
+   inflateReset2(&strm, -15);
+   if (p->bits) {
+      int c = *strm.next_in;
+      strm.next_in++;
+      strm.avail_in--;
+      inflatePrime(&strm, p->bits, c >> (8 - p->bits));
+   }
+   inflateSetDictionary(&strm, window, p->window_size);
+
+   raw_deflate = true;
+   done = false;
+   member = 0;
+   out_total = p->out_offset;
+   cur = end = out_buf;
+   return(true);
+}
+
+void gz_input_t::skip(uint64_t n) {
+   while (n) {
+      size_t avail = ensure(1);
+      if (avail == 0)
+         return;
+      size_t k = ((n < avail) ? n : avail);
+      consume(k);
+      n -= k;
+   }
+}
+
+uint64_t gz_input_t::seek_record(uint64_t instr, uint64_t current) {
+   if (!index_tried) {
+      index_tried = true;
+      struct stat st;
+      std::string index_name = name + GZ_INDEX_SUFFIX;
+      have_index = (!fstat(fd, &st) && index.load(index_name.c_str(), st.st_size));
+   }
+
+   if (have_index) {
+      const gz_index_point_t *p = index.find(instr);
+      // Restart from the index point unless decoding forward from the current record is shorter.
+      if (p && ((p->instr > current) || (instr < current)) && restart(p)) {
+         skip(p->instr_offset - p->out_offset);
+         return(p->instr);
+      }
+   }
+
+   if (instr < current) {
+      rewind();
+      return(0);
+   }
+   return(current);
+}
+
+size_t gz_input_t::refill(size_t need) {
+   assert(need <= out_size);
+
+   // Slide the unconsumed tail to the front of the buffer.
+   size_t left = (size_t)(end - cur);
+   memmove(out_buf, cur, left);
+   cur = out_buf;
+   uint8_t *fill = out_buf + left;
+   uint8_t *limit = out_buf + out_size;
+
+   // Fill the whole buffer, not just "need" bytes, so that refills stay rare.
+   while ((fill < limit) && !done) {
+      if ((strm.avail_in == 0) && !read_input()) {
+         if (!compressed)
+            done = true;
+         // Otherwise, let inflate() flush any output it still holds.
+      }
+
+      if (!compressed) {
+         size_t n = (((size_t)(limit - fill) < strm.avail_in) ? (size_t)(limit - fill) : strm.avail_in);
+         memcpy(fill, strm.next_in, n);
+         fill += n;
+         out_total += n;
+         strm.next_in += n;
+         strm.avail_in -= n;
+         continue;
+      }
+
+      strm.next_out = fill;
+      strm.avail_out = (uInt)(limit - fill);
+      // When building an index, stop at every deflate block boundary to look for checkpoints.
+      int ret = inflate(&strm, (building ? Z_BLOCK : Z_NO_FLUSH));
+      out_total += (uint64_t)(strm.next_out - fill);
+      fill = strm.next_out;
+
+      if (building && (member == 0) && (ret == Z_OK) &&
+          (strm.data_type & 128) && !(strm.data_type & 64) &&
+          (out_total - building->last_out_offset() >= building->get_span())) {
+         uint8_t window[GZ_INDEX_WINDOW];
+         uInt window_size = GZ_INDEX_WINDOW;
+         inflateGetDictionary(&strm, window, &window_size);
+         building->add_point(file_offset - strm.avail_in, (strm.data_type & 7), out_total, window, window_size);
+      }
+
+      if (ret == Z_STREAM_END) {
+         // Raw inflation after a restart stops before the member's trailer.
+         if (raw_deflate)
+            skip_input(GZIP_TRAILER_SIZE);
+
+         // Concatenated gzip members are decompressed as one trace; anything else after a member is ignored.
+         if ((strm.avail_in == 0) && !read_input()) {
+            done = true;
+         }
+         else if (strm.avail_in == 1) {
+            // The next member's magic number straddles two input chunks: inflate its first byte on its own.
+            Bytef first = strm.next_in[0];
+            if ((first == 0x1f) && read_input() && (strm.next_in[0] == 0x8b)) {
+               inflateReset2(&strm, 15 + 32);
+               raw_deflate = false;
+               member++;
+               Bytef *next_in = strm.next_in;
+               uInt avail_in = strm.avail_in;
+               strm.next_in = &first;
+               strm.avail_in = 1;
+               inflate(&strm, Z_NO_FLUSH);	// consumes the byte into the header, produces no output
+               strm.next_in = next_in;
+               strm.avail_in = avail_in;
+            }
+            else {
+               done = true;
+            }
+         }
+         else if (IS_GZIP_MAGIC(strm.next_in)) {
+            inflateReset2(&strm, 15 + 32);
+            raw_deflate = false;
+            member++;
+         }
+         else {
+            done = true;
+         }
+      }
+      else if (ret == Z_BUF_ERROR) {
+         // No progress possible: input exhausted (truncated trace) while output space remains.
+         if (input_eof)
+            done = true;
+      }
+      else if (ret != Z_OK) {
+         fprintf(stderr, "Trace decompression error: %s\n", (strm.msg ? strm.msg : "unknown"));
+         done = true;
+      }
+   }
+
+   end = fill;
+   return (size_t)(end - cur);
+}
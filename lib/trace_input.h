@@ -0,0 +1,135 @@
+#pragma once
+
+// Byte-level input for trace readers.
+//
+// A trace input exposes a window [cur, end) of decompressed trace bytes that
+// the reader decodes in place with pointer arithmetic. When the reader needs
+// more contiguous bytes than the window holds, ensure() asks the backend to
+// slide the unconsumed tail to the front of its buffer and refill the rest.
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string>
+#include <zlib.h>
+#include "gz_index.h"
+#include "read_ahead.h"
+
+struct trace_dict_t;
+
+constexpr size_t DEFAULT_TRACE_BUFFER_SIZE = (4 << 20);
+
+// Largest number of bytes a reader may ask ensure() for (at least one whole trace record).
+constexpr size_t MAX_TRACE_INPUT_NEED = (8 << 10);
+
+class trace_input_t {
+protected:
+   const uint8_t *cur;	// next unconsumed byte
+   const uint8_t *end;	// one past the last valid byte
+
+   // Make at least "need" contiguous bytes available at cur, if the trace has that many left.
+   // Returns the number of bytes available at cur.
+   virtual size_t refill(size_t need) = 0;
+
+public:
+   trace_input_t() : cur(NULL), end(NULL) {}
+   virtual ~trace_input_t() {}
+
+   // Returns the number of contiguous bytes available at data(), which is less than "need" only at the end of the trace.
+   inline size_t ensure(size_t need) {
+      size_t avail = (size_t)(end - cur);
+      return ((avail >= need) ? avail : refill(need));
+   }
+
+   inline const uint8_t *data() const { return cur; }
+   inline void consume(size_t n) { cur += n; }
+
+   // Decompressed offset of data() in the trace.
+   virtual uint64_t offset() const = 0;
+
+   // Approximate fraction of the trace consumed so far, between 0 and 1.
+   virtual double fraction_read() const = 0;
+
+   // Positions the input at the start of a trace record at or before record "instr", using whatever index the
+   // backend has. "current" is the record the input is at now. Returns the record the input is at afterwards;
+   // the reader decodes forward from there.
+   virtual uint64_t seek_record(uint64_t instr, uint64_t current) = 0;
+
+   // Static instructions the records refer to, or nullptr if the records are CVP-1 records (see dict_trace.h).
+   virtual const trace_dict_t *dictionary() const { return nullptr; }
+};
+
+// Reads trace records from a buffer the caller already holds in memory (e.g., one block of a block trace).
+class mem_input_t : public trace_input_t {
+private:
+   const uint8_t *start;
+
+protected:
+   size_t refill(size_t /*need*/) { return (size_t)(end - cur); }
+
+public:
+   mem_input_t(const uint8_t *buf, size_t size) : start(buf) { cur = buf; end = buf + size; }
+
+   uint64_t offset() const { return (uint64_t)(cur - start); }
+   double fraction_read() const { return ((end > start) ? ((double)(cur - start) / (end - start)) : 1.0); }
+   uint64_t seek_record(uint64_t instr, uint64_t current) {
+      if (instr < current) {
+         cur = start;
+         return(0);
+      }
+      return(current);
+   }
+};
+
+// Streams a gzip-compressed (or uncompressed) trace file, inflating straight into a large output buffer.
+class gz_input_t : public trace_input_t {
+private:
+   std::string name;
+   int fd;
+   z_stream strm;
+   bool compressed;	// false: file is not gzip, bytes are copied through
+   bool raw_deflate;	// inflating raw deflate data after restarting from an index point
+   bool input_eof;	// no more bytes in the file
+   bool done;		// no more decompressed bytes will be produced
+   uint64_t member;	// gzip member being inflated
+   uint64_t file_offset;	// bytes read from the file
+   uint64_t file_size;
+   uint64_t out_total;	// decompressed bytes produced
+
+   gz_index_t *building;	// index to record inflate checkpoints into, if any
+   gz_index_t index;	// sidecar index, loaded on the first seek
+   bool index_tried;
+   bool have_index;
+
+   read_ahead_t *file;	// compressed bytes read from the file
+   uint8_t *out_buf;	// decompressed bytes, decoded in place by the reader
+   size_t out_size;
+
+   // Make the next chunk of the file the inflate input. Returns false at end of file.
+   bool read_input();
+
+   // Discard n compressed bytes.
+   void skip_input(size_t n);
+
+   // Restart decompression at the beginning of the file, or from an index point.
+   void rewind();
+   bool restart(const gz_index_point_t *p);
+
+   // Discard n decompressed bytes.
+   void skip(uint64_t n);
+
+protected:
+   size_t refill(size_t need);
+
+public:
+   // read_ahead, drop_cache: see read_ahead_t.
+   gz_input_t(const char *name, size_t buffer_size = DEFAULT_TRACE_BUFFER_SIZE,
+              unsigned read_ahead = DEFAULT_TRACE_READ_AHEAD, bool drop_cache = false);
+   ~gz_input_t();
+
+   uint64_t offset() const { return (out_total - (uint64_t)(end - cur)); }
+   double fraction_read() const { return (file_size ? ((double)(file_offset - strm.avail_in) / file_size) : 1.0); }
+   uint64_t seek_record(uint64_t instr, uint64_t current);
+
+   // Record inflate checkpoints into "index" while the trace is read (see gz_index_build()).
+   void record_index(gz_index_t *index) { building = index; }
+};
@@ -0,0 +1,45 @@
+#include <inttypes.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "native_trace.h"
+#include "block_trace.h"
+#include "columnar_trace.h"
+#include "codec_trace.h"
+#include "dict_trace.h"
+#include "trace_cache.h"
+#include "trace_reader.h"
+
+size_t trace_reader_t::get_batch(db_t *out, size_t max) {
+   size_t n;
+   db_t *inst;
+   for (n = 0; (n < max) && (inst = get_inst()); n++) {
+      out[n] = *inst;
+      delete inst;
+   }
+   return(n);
+}
+
+trace_reader_t *open_trace(const char *name, const trace_options_t &options) {
+   if (options.shared_cache) {
+      trace_reader_t *cached = open_cached_trace(name, options);
+      if (cached)
+         return(cached);
+   }
+   if (is_native_trace(name))
+      return(new native_trace_reader_t(name));
+   if (is_columnar_trace(name))
+      return(new columnar_trace_reader_t(name, options.fields));
+   if (is_dict_trace(name))
+      return(new CVPTraceReader(new dict_input_t(name, options.threads)));
+   return(new CVPTraceReader(open_trace_input(name, options)));
+}
+
+trace_input_t *open_trace_input(const char *name, const trace_options_t &options) {
+   if (is_native_trace(name) || is_columnar_trace(name) || is_dict_trace(name))
+      return(nullptr);
+   if (is_block_trace(name))
+      return(new block_input_t(name, options.threads));
+   if (is_codec_trace(name))
+      return(new codec_input_t(name));
+   return(new gz_input_t(name, options.buffer_size, options.read_ahead, options.drop_cache));
+}
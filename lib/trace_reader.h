@@ -0,0 +1,68 @@
+#pragma once
+
+// Common interface of all trace readers.
+//
+// The simulator does not care how a trace is stored: open_trace() looks at the
+// file's magic header and returns the matching reader. Files without a known
+// magic are CVP-1 traces (gzip-compressed or not) handled by CVPTraceReader,
+// which also reads the CVP-1 records of block and codec traces and the records of dictionary traces.
+
+#include <stddef.h>
+#include <inttypes.h>
+#include "trace_input.h"
+
+struct db_t;
+
+// Micro-op fields a simulation uses (trace_options_t::fields). Formats that store fields
+// separately (columnar traces) do not read the others, which are then zero. The type,
+// operand validity and load/store flags are always read.
+#define TRACE_FIELD_PC		(1 << 0)	// pc
+#define TRACE_FIELD_NEXT_PC	(1 << 1)	// next_pc
+#define TRACE_FIELD_MEM		(1 << 2)	// addr, size
+#define TRACE_FIELD_REGS	(1 << 3)	// log_reg of all operands
+#define TRACE_FIELD_VALUES	(1 << 4)	// D.value
+#define TRACE_FIELDS_ALL	((1 << 5) - 1)
+
+struct trace_options_t {
+   size_t buffer_size;	// decompression buffer size of readers that decompress the trace
+   unsigned threads;	// decompression threads of block-compressed traces (0: one per core)
+   unsigned fields;	// TRACE_FIELD_* mask
+   bool shared_cache;	// read the trace through the host-wide shared memory cache (see trace_cache.h)
+   unsigned read_ahead;	// chunks of a gzip-compressed or uncompressed trace read ahead (see read_ahead.h)
+   bool drop_cache;	// drop the page cache of the chunks of a gzip-compressed or uncompressed trace once read
+
+   trace_options_t() : buffer_size(DEFAULT_TRACE_BUFFER_SIZE), threads(0), fields(TRACE_FIELDS_ALL), shared_cache(false),
+                       read_ahead(DEFAULT_TRACE_READ_AHEAD), drop_cache(false) {}
+};
+
+class trace_reader_t {
+public:
+   virtual ~trace_reader_t() {}
+
+   // Returns the next micro-op (to be deleted by the caller), or nullptr at the end of the trace.
+   // Idiom is : while(instr = get_inst())
+   //              ... process instr
+   virtual db_t *get_inst() = 0;
+
+   // Fills out[0..max-1] with the next micro-ops, in caller-owned storage that can be reused from one call to the next.
+   // Returns the number of micro-ops filled, less than max only at the end of the trace.
+   virtual size_t get_batch(db_t *out, size_t max);
+
+   // Number of trace instructions read so far (a trace instruction may be cracked into several micro-ops).
+   virtual uint64_t num_instr() const = 0;
+
+   // Approximate fraction of the trace read so far, between 0 and 1.
+   virtual double fraction_read() const = 0;
+
+   // Positions the reader so that the next get_inst() returns the first micro-op of trace instruction "instr"
+   // (counting from 0), after which num_instr() is "instr". Returns false if the trace is shorter.
+   virtual bool seek(uint64_t instr) = 0;
+};
+
+// Opens a trace of any supported format.
+trace_reader_t *open_trace(const char *name, const trace_options_t &options = trace_options_t());
+
+// Opens the CVP-1 records of a gzip-compressed, uncompressed, block or codec trace, for CVPTraceReader
+// or tools that copy records. Returns nullptr for formats that hold cracked micro-ops (native, columnar)
+// or other records (dictionary).
+trace_input_t *open_trace_input(const char *name, const trace_options_t &options = trace_options_t());
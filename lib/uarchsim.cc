@@ -33,34 +33,43 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "bp.h"
 #include "resource_schedule.h"
 #include "uarchsim.h"
-#include "parameters.h"
+#include "sim_config.h"
+#include "interval_stats.h"
 
 //uarchsim_t::uarchsim_t():window(WINDOW_SIZE),
-uarchsim_t::uarchsim_t():BP(20,16,20,16,64),window(WINDOW_SIZE),
-			 L3(L3_SIZE, L3_ASSOC, L3_BLOCKSIZE, L3_LATENCY, (cache_t *)NULL),
-			 L2(L2_SIZE, L2_ASSOC, L2_BLOCKSIZE, L2_LATENCY, &L3),
-			 L1(L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, L1_LATENCY, &L2),
-                         IC(IC_SIZE, IC_ASSOC, IC_BLOCKSIZE, 0, &L2) {
-   assert(WINDOW_SIZE);
-   //assert(FETCH_WIDTH);
+uarchsim_t::uarchsim_t(const sim_config_t &config):cfg(config),SQ(cfg.window_size),BP(20,16,20,16,64,cfg.perfect_indirect_pred),window(cfg.window_size),
+			 L3(cfg.l3_size, cfg.l3_assoc, cfg.l3_blocksize, cfg.l3_latency, (cache_t *)NULL, cfg.main_memory_latency),
+			 L2(cfg.l2_size, cfg.l2_assoc, cfg.l2_blocksize, cfg.l2_latency, &L3, cfg.main_memory_latency),
+			 L1(cfg.l1_size, cfg.l1_assoc, cfg.l1_blocksize, cfg.l1_latency, &L2, cfg.main_memory_latency),
+                         IC(cfg.ic_size, cfg.ic_assoc, cfg.ic_blocksize, 0, &L2, cfg.main_memory_latency) {
+   assert(cfg.window_size);
+   //assert(cfg.fetch_width);
 
    //setup logger
    // Set this to "spdlog::level::debug" for verbose debug prints
    spdlog::set_level(spdlog::level::info);
    spdlog::set_pattern("[%l]  %v");
 
-   ldst_lanes = ((NUM_LDST_LANES > 0) ? (new resource_schedule(NUM_LDST_LANES)) : ((resource_schedule *)NULL));
-   alu_lanes = ((NUM_ALU_LANES > 0) ? (new resource_schedule(NUM_ALU_LANES)) : ((resource_schedule *)NULL));
+   ldst_lanes = ((cfg.num_ldst_lanes > 0) ? (new resource_schedule(cfg.num_ldst_lanes)) : ((resource_schedule *)NULL));
+   alu_lanes = ((cfg.num_alu_lanes > 0) ? (new resource_schedule(cfg.num_alu_lanes)) : ((resource_schedule *)NULL));
 
    for (int i = 0; i < RFSIZE; i++)
       RF[i] = 0;
 
+   piece = 0;
+   prev_pc = 0xdeadbeef;
+
    num_fetched = 0;
    num_fetched_branch = 0;
    fetch_cycle = 0;
 
    num_inst = 0;
    cycle = 0;
+   num_warmed = 0;
+   warm_ic_block = 1;	// not a block address
+   for (int i = 0; i < NUM_CPI_CAUSES; i++)
+      cpi_cycles[i] = 0;
+   cycle_cause = CPI_PIPELINE;
  
    // CVP measurements
    num_eligible = 0;
@@ -73,11 +82,32 @@ uarchsim_t::uarchsim_t():BP(20,16,20,16,64),window(WINDOW_SIZE),
 }
 
 uarchsim_t::~uarchsim_t() {
+   delete ldst_lanes;
+   delete alu_lanes;
 }
 
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #define MIN(a, b) (((a) > (b)) ? (b) : (a))
 
+const char *const cpi_cause_names[NUM_CPI_CAUSES] = {
+   "fetch",
+   "icache",
+   "branch",
+   "vp_squash",
+   "pipeline",
+   "dependence",
+   "lanes",
+   "execution",
+   "memory",
+};
+
+void uarchsim_t::advance_fetch(uint64_t to, cpi_cause_t cause) {
+   if (to > fetch_cycle) {
+      cpi_cycles[cause] += (to - fetch_cycle);
+      fetch_cycle = to;
+   }
+}
+
 PredictionRequest uarchsim_t::get_prediction_req_for_track(uint64_t cycle, uint64_t seq_no, uint8_t piece, db_t *inst)
 {
    PredictionRequest req;
@@ -87,7 +117,7 @@ PredictionRequest uarchsim_t::get_prediction_req_for_track(uint64_t cycle, uint6
    req.cache_hit = HitMissInfo::Invalid;
 
 
-   switch(VPTracks(VP_TRACK)){
+   switch(VPTracks(cfg.vp_track)){
    case VPTracks::ALL:
          req.is_candidate = true;
          break;
@@ -129,7 +159,7 @@ uint64_t uarchsim_t::get_load_exec_cycle(db_t *inst) const
    uint64_t exec_cycle = fetch_cycle;
 
    // No need to re-access ICache because fetch_cycle has already been updated    
-   exec_cycle = exec_cycle + PIPELINE_FILL_LATENCY;
+   exec_cycle = exec_cycle + cfg.pipeline_fill_latency;
 
    if (inst->A.valid) {
       assert(inst->A.log_reg < RFSIZE);
@@ -152,13 +182,27 @@ uint64_t uarchsim_t::get_load_exec_cycle(db_t *inst) const
    return exec_cycle;
 }
 
+// The step that delayed an instruction the most, from its fetch cycle and the ends of its steps (see step()).
+static cpi_cause_t slowest_step(uint64_t fetched, const uint64_t *ends) {
+   static const cpi_cause_t steps[] = {CPI_PIPELINE, CPI_DEPENDENCE, CPI_LANES, CPI_EXECUTION, CPI_MEMORY};
+   cpi_cause_t slowest = CPI_PIPELINE;
+   uint64_t longest = 0;
+   uint64_t start = fetched;
+   for (int i = 0; i < 5; i++) {
+      if (ends[i] - start > longest) {
+         longest = (ends[i] - start);
+         slowest = steps[i];
+      }
+      start = ends[i];
+   }
+   return(slowest);
+}
+
 void uarchsim_t::step(db_t *inst) 
 {
    spdlog::debug("Stepping, FC: {}",fetch_cycle);
 
    // Preliminary step: determine which piece of the instruction this is.
-   static uint8_t piece = 0;
-   static uint64_t prev_pc = 0xdeadbeef;
    piece = ((inst->pc == prev_pc) ? (piece + 1) : 0);
    prev_pc = inst->pc;
 
@@ -168,12 +212,15 @@ void uarchsim_t::step(db_t *inst)
    /////////////////////////////
    while (!window.empty() && (fetch_cycle >= window.peekhead().retire_cycle)) {
       window_t w = window.pop();
-      if (VP_ENABLE && !VP_PERFECT)
+      if (cfg.vp_enable && !cfg.vp_perfect)
          updatePredictor(w.seq_no, w.addr, w.value, w.latency);
    }
+
+   // Loads from here on search the SQ after fetch_cycle: stores committed by then can be dropped.
+   SQ.retire(fetch_cycle);
  
    // CVP variables
-   uint64_t seq_no = num_inst;
+   uint64_t seq_no = num_inst + num_warmed;
    bool predictable = (inst->D.valid && (inst->D.log_reg != RFFLAGS));
    PredictionResult pred;
    bool squash = false;
@@ -181,17 +228,15 @@ void uarchsim_t::step(db_t *inst)
    // 
    // Schedule the instruction's execution cycle.
    //
-   uint64_t i;
-   uint64_t addr;
    uint64_t exec_cycle;
 
-   if (FETCH_MODEL_ICACHE)
-      fetch_cycle = IC.access(fetch_cycle, true, inst->pc);   // Note: I-cache hit latency is "0" (above), so fetch cycle doesn't increase on hits.
+   if (cfg.fetch_model_icache)
+      advance_fetch(IC.access(fetch_cycle, true, inst->pc), CPI_ICACHE);   // Note: I-cache hit latency is "0" (above), so fetch cycle doesn't increase on hits.
 
    // Predict at fetch time
-   if (VP_ENABLE)
+   if (cfg.vp_enable)
    {
-      if (VP_PERFECT)
+      if (cfg.vp_perfect)
       {
          PredictionRequest req = get_prediction_req_for_track(fetch_cycle, seq_no, piece, inst);
          pred.predicted_value = inst->D.value;
@@ -217,7 +262,12 @@ void uarchsim_t::step(db_t *inst)
       pred.speculate = false;
    }
  
-   exec_cycle = fetch_cycle + PIPELINE_FILL_LATENCY;
+   // Ends of the steps from fetch to completion (pipeline fill, operands, lane, execution, memory), for the CPI stack.
+   uint64_t fetched = fetch_cycle;
+   uint64_t step_ends[5];
+
+   exec_cycle = fetch_cycle + cfg.pipeline_fill_latency;
+   step_ends[0] = exec_cycle;
 
    if (inst->A.valid) {
       assert(inst->A.log_reg < RFSIZE);
@@ -231,6 +281,7 @@ void uarchsim_t::step(db_t *inst)
       assert(inst->C.log_reg < RFSIZE);
       exec_cycle = MAX(exec_cycle, RF[inst->C.log_reg]);
    }
+   step_ends[1] = exec_cycle;
 
    //
    // Schedule an execution lane.
@@ -241,6 +292,7 @@ void uarchsim_t::step(db_t *inst)
    else {
       if (alu_lanes) exec_cycle = alu_lanes->schedule(exec_cycle);
    }
+   step_ends[2] = exec_cycle;
 
    if (inst->is_load) {
      
@@ -250,7 +302,7 @@ void uarchsim_t::step(db_t *inst)
       exec_cycle = (exec_cycle + 1);
 
       // Train the prefetcher when the load finds out its outcome in the L1D
-      if (PREFETCHER_ENABLE)
+      if (cfg.prefetcher_enable)
       {
          // Generate prefetches ahead of time as in "Effective Hardware-Based Data Prefetching for High-Performance Processors"
          // Instruction PC will be 4B aligned.
@@ -264,27 +316,17 @@ void uarchsim_t::step(db_t *inst)
 
       // Search D$ using AGEN's cycle.
       uint64_t data_cache_cycle;
-      if (PERFECT_CACHE)
-         data_cache_cycle = exec_cycle + L1_LATENCY;
+      if (cfg.perfect_cache)
+         data_cache_cycle = exec_cycle + cfg.l1_latency;
       else
          data_cache_cycle = L1.access(exec_cycle, true, inst->addr);
 
       // Search of SQ takes 1 cycle after AGEN cycle.
       exec_cycle = (exec_cycle + 1);
+      step_ends[3] = exec_cycle;
 
       bool inc_sqmiss = false;
-      uint64_t temp_cycle = 0;
-      for (i = 0, addr = inst->addr; i < inst->size; i++, addr++) {
-         if ((SQ.find(addr) != SQ.end()) && (exec_cycle < SQ[addr].ret_cycle)) {
-            // SQ hit: the byte's timestamp is the later of load's execution cycle and store's execution cycle
-            temp_cycle = MAX(temp_cycle, MAX(exec_cycle, SQ[addr].exec_cycle));
-         }
-         else {
-            // SQ miss: the byte's timestamp is its availability in L1 D$
-            temp_cycle = MAX(temp_cycle, data_cache_cycle);
-            inc_sqmiss = true;
-         }
-      }
+      uint64_t temp_cycle = SQ.load(inst->addr, inst->size, exec_cycle, data_cache_cycle, inc_sqmiss);
 
       num_load++;					// stat
       num_load_sqmiss += (inc_sqmiss ? 1 : 0);		// stat
@@ -306,13 +348,14 @@ void uarchsim_t::step(db_t *inst)
 
       // Account for execution latency.
       exec_cycle += latency;
+      step_ends[3] = exec_cycle;
    }
 
    // Drain prefetches from PF Queue
    // The idea is that a prefetch can go only if there is a free LDST slot "this" cycle
    // Here, "this" means all the cycles between the previous fetch cycle and the current one since all fetched ld/st will have been
    // scheduled and prefetch can correctly "steal" ld/st slots.
-   if(PREFETCHER_ENABLE)
+   if(cfg.prefetcher_enable)
    {
       uint64_t tmp_previous_fetch_cycle;
       Prefetch p;
@@ -352,6 +395,10 @@ void uarchsim_t::step(db_t *inst)
 
    // Update the instruction count and simulation cycle (max. completion cycle among all scheduled instructions).
    num_inst += 1;
+   step_ends[4] = exec_cycle;
+   cpi_cause_t cause = slowest_step(fetched, step_ends);
+   if (exec_cycle > cycle)
+      cycle_cause = cause;
    cycle = MAX(cycle, exec_cycle);
 
    // Update destination register timestamp.
@@ -367,17 +414,14 @@ void uarchsim_t::step(db_t *inst)
    // Update SQ byte timestamps.
    if (inst->is_store) {
       uint64_t data_cache_cycle;
-      if (!WRITE_ALLOCATE || PERFECT_CACHE)
+      if (!cfg.write_allocate || cfg.perfect_cache)
          data_cache_cycle = exec_cycle;
       else
          data_cache_cycle = L1.access(exec_cycle, true, inst->addr);
 
       // uint64_t ret_cycle = MAX(exec_cycle, (window.empty() ? 0 : window.peektail().retire_cycle));
       uint64_t ret_cycle = MAX(data_cache_cycle, (window.empty() ? 0 : window.peektail().retire_cycle));
-      for (i = 0, addr = inst->addr; i < inst->size; i++, addr++) {
-         SQ[addr].exec_cycle = exec_cycle;
-         SQ[addr].ret_cycle = ret_cycle;
-      }
+      SQ.store(inst->addr, inst->size, exec_cycle, ret_cycle);
    }
 
    // CVP measurements
@@ -388,11 +432,14 @@ void uarchsim_t::step(db_t *inst)
    /////////////////////////////
    // Manage window: dispatch.
    /////////////////////////////
+   // An instruction that completes before the previous one retires is held by it (in-order retirement).
+   bool held = (!window.empty() && (window.peektail().retire_cycle > exec_cycle));
    window.push({MAX(exec_cycle, (window.empty() ? 0 : window.peektail().retire_cycle)),
                seq_no,
                ((inst->is_load || inst->is_store) ? inst->addr : 0xDEADBEEF),
                ((inst->D.valid && (inst->D.log_reg != RFFLAGS)) ? inst->D.value : 0xDEADBEEF),
-	       latency});
+	       latency,
+	       (held ? window.peektail().cause : cause)});
 
    /////////////////////////////
    // Manage fetch cycle.
@@ -402,12 +449,12 @@ void uarchsim_t::step(db_t *inst)
    if (squash) {			// control dependency on the retire cycle of the value-mispredicted instruction
       num_fetched = 0;			// new fetch bundle
       assert(!window.empty() && (fetch_cycle < window.peektail().retire_cycle));
-      fetch_cycle = window.peektail().retire_cycle;
+      advance_fetch(window.peektail().retire_cycle, CPI_VP_SQUASH);
    }
    else if (window.full()) {
       if (fetch_cycle < window.peekhead().retire_cycle) {
          num_fetched = 0;		// new fetch bundle
-         fetch_cycle = window.peekhead().retire_cycle;
+         advance_fetch(window.peekhead().retire_cycle, window.peekhead().cause);
       }
    }
    else {				// fetch bundle constraints
@@ -417,38 +464,38 @@ void uarchsim_t::step(db_t *inst)
       bool uncond_indirect = ((InstClass) inst->insn == InstClass::uncondIndirectBranchInstClass);
 
       // Finite fetch bundle.
-      if (FETCH_WIDTH > 0) {
+      if (cfg.fetch_width > 0) {
          num_fetched++;
-         if (num_fetched == FETCH_WIDTH)
+         if (num_fetched == cfg.fetch_width)
             stop = true;
       }
 
       // Finite branch throughput.
-      if ((FETCH_NUM_BRANCH > 0) && (cond_branch || uncond_direct || uncond_indirect)) {
+      if ((cfg.fetch_num_branch > 0) && (cond_branch || uncond_direct || uncond_indirect)) {
          num_fetched_branch++;
-         if (num_fetched_branch == FETCH_NUM_BRANCH)
+         if (num_fetched_branch == cfg.fetch_num_branch)
             stop = true;
       }
 
       // Indirect branch constraint.
-      if (FETCH_STOP_AT_INDIRECT && uncond_indirect)
+      if (cfg.fetch_stop_at_indirect && uncond_indirect)
          stop = true;
 
       // Taken branch constraint.
-      if (FETCH_STOP_AT_TAKEN && (uncond_direct || uncond_indirect || (cond_branch && (inst->next_pc != (inst->pc + 4)))))
+      if (cfg.fetch_stop_at_taken && (uncond_direct || uncond_indirect || (cond_branch && (inst->next_pc != (inst->pc + 4)))))
          stop = true;
 
       if (stop) {
          // new fetch bundle
          num_fetched = 0;
 	 num_fetched_branch = 0;
-         fetch_cycle++;
+         advance_fetch(fetch_cycle + 1, CPI_FETCH);
       }
    }
 
    // Account for the effect of a mispredicted branch on the fetch cycle.
-   if (!PERFECT_BRANCH_PRED && BP.predict((InstClass) inst->insn, inst->pc, inst->next_pc))
-      fetch_cycle = MAX(fetch_cycle, exec_cycle);
+   if (!cfg.perfect_branch_pred && BP.predict((InstClass) inst->insn, inst->pc, inst->next_pc))
+      advance_fetch(exec_cycle, CPI_BRANCH);
 
    spdlog::debug("Updating base_cycle to {}", MIN(fetch_cycle, prefetcher.get_oldest_pf_cycle()));
 
@@ -457,10 +504,181 @@ void uarchsim_t::step(db_t *inst)
    if (ldst_lanes) ldst_lanes->advance_base_cycle(MIN(fetch_cycle, prefetcher.get_oldest_pf_cycle()));
    if (alu_lanes) alu_lanes->advance_base_cycle(MIN(fetch_cycle, prefetcher.get_oldest_pf_cycle()));
 
+   if (intervals && (num_inst == intervals->next_row()))
+      intervals->record(results());
+
    // DEBUG
    //printf("%d,%d\n", num_inst, cycle);
 }
 
+void uarchsim_t::step_batch(db_t *inst, size_t n) {
+   for (size_t i = 0; i < n; i++)
+      step(&inst[i]);
+}
+
+// Functional warming: the instruction accesses the caches and trains the branch predictor, the prefetcher and
+// the value predictor (which sees it retire right away), but is not scheduled: the window, the execution lanes,
+// the store queue and the cycle counts are left alone.
+void uarchsim_t::warm(db_t *inst)
+{
+   piece = ((inst->pc == prev_pc) ? (piece + 1) : 0);
+   prev_pc = inst->pc;
+
+   // Retire what detailed simulation left in flight, so that the value predictor trains in program order.
+   while (!window.empty()) {
+      window_t w = window.pop();
+      if (cfg.vp_enable && !cfg.vp_perfect)
+         updatePredictor(w.seq_no, w.addr, w.value, w.latency);
+      advance_fetch(w.retire_cycle, CPI_PIPELINE);
+      num_fetched = 0;
+      num_fetched_branch = 0;
+      warm_ic_block = 1;
+   }
+
+   uint64_t seq_no = num_inst + num_warmed;
+
+   // Predict before the caches are accessed, as step() does (track LoadsOnlyHitMiss looks them up).
+   if (cfg.vp_enable && !cfg.vp_perfect) {
+      bool predictable = (inst->D.valid && (inst->D.log_reg != RFFLAGS));
+      PredictionRequest req = get_prediction_req_for_track(fetch_cycle, seq_no, piece, inst);
+      PredictionResult pred = getPrediction(req);
+      speculativeUpdate(seq_no, predictable, ((predictable && pred.speculate && req.is_candidate) ? ((pred.predicted_value == inst->D.value) ? 1 : 0) : 2),
+                        inst->pc, inst->next_pc, (InstClass)inst->insn, piece,
+                        (inst->A.valid ? inst->A.log_reg : 0xDEADBEEF),
+                        (inst->B.valid ? inst->B.log_reg : 0xDEADBEEF),
+                        (inst->C.valid ? inst->C.log_reg : 0xDEADBEEF),
+                        (inst->D.valid ? inst->D.log_reg : 0xDEADBEEF));
+   }
+
+   // Consecutive micro-ops mostly share an I-cache block: warming it again would not change the LRU order.
+   if (cfg.fetch_model_icache && ((inst->pc & ~(cfg.ic_blocksize - 1)) != warm_ic_block)) {
+      warm_ic_block = (inst->pc & ~(cfg.ic_blocksize - 1));
+      IC.warm(inst->pc);
+   }
+
+   uint64_t latency;
+   if (inst->is_load) {
+      if (cfg.prefetcher_enable) {
+         prefetcher.lookahead((inst->pc >> 2), fetch_cycle);
+         PrefetchTrainingInfo info{inst->pc >> 2, inst->addr, 0, L1.is_hit(fetch_cycle, inst->addr)};
+         prefetcher.train(info);
+
+         // Prefetches are performed right away.
+         Prefetch p;
+         while (prefetcher.issue(p, fetch_cycle))
+            L1.warm(p.address);
+      }
+      if (!cfg.perfect_cache)
+         L1.warm(inst->addr);
+      latency = MAX(2, 1 + cfg.l1_latency);	// as if it hit in the L1
+   }
+   else if (inst->insn == InstClass::fpInstClass)
+      latency = 3;
+   else if (inst->insn == InstClass::slowAluInstClass)
+      latency = 4;
+   else
+      latency = 1;
+
+   if (inst->is_store && cfg.write_allocate && !cfg.perfect_cache)
+      L1.warm(inst->addr);
+
+   if (!cfg.perfect_branch_pred)
+      BP.warm((InstClass) inst->insn, inst->pc, inst->next_pc);
+
+   if (cfg.vp_enable && !cfg.vp_perfect)
+      updatePredictor(seq_no,
+                      ((inst->is_load || inst->is_store) ? inst->addr : 0xDEADBEEF),
+                      ((inst->D.valid && (inst->D.log_reg != RFFLAGS)) ? inst->D.value : 0xDEADBEEF),
+                      latency);
+
+   num_warmed++;
+}
+
+// A lane schedule present on one side only is dropped (lanes limited when saving, not when restoring) or left empty.
+static void checkpoint_lanes(checkpoint_t &ck, resource_schedule *lanes) {
+   bool present = (lanes != NULL);
+   ck.io(present);
+   if (!present)
+      return;
+   if (lanes) {
+      lanes->checkpoint(ck);
+   }
+   else {
+      resource_schedule dropped(1);
+      dropped.checkpoint(ck);
+   }
+}
+
+void uarchsim_t::checkpoint(checkpoint_t &ck) {
+   ck.section("simulator");
+   ck.array(RF, RFSIZE, "register file");
+   SQ.checkpoint(ck);
+   L1.checkpoint(ck);
+   L2.checkpoint(ck);
+   L3.checkpoint(ck);
+   IC.checkpoint(ck);
+   BP.checkpoint(ck);
+   prefetcher.checkpoint(ck);
+
+   ck.section("pipeline");
+   ck.io(piece);
+   ck.io(prev_pc);
+   ck.io(fetch_cycle);
+   ck.io(previous_fetch_cycle);
+   ck.io(num_fetched);
+   ck.io(num_fetched_branch);
+
+   // The window is saved by content, so that it can be restored into a larger one.
+   std::vector<window_t> in_flight;
+   while (!window.empty())
+      in_flight.push_back(window.pop());
+   ck.io(in_flight);
+   if (ck.restoring() && (in_flight.size() > cfg.window_size))
+      ck.fail("the checkpoint's window holds more instructions than this window");
+   else
+      for (const window_t &w : in_flight)
+         window.push(w);
+   checkpoint_lanes(ck, ldst_lanes);
+   checkpoint_lanes(ck, alu_lanes);
+
+   ck.section("measurements");
+   ck.io(num_inst);
+   ck.io(cycle);
+   ck.io(num_warmed);
+   ck.io(num_eligible);
+   ck.io(num_correct);
+   ck.io(num_incorrect);
+   ck.io(num_load);
+   ck.io(num_load_sqmiss);
+   ck.io(stat_pfs_issued_to_mem);
+   ck.array(cpi_cycles, NUM_CPI_CAUSES, "CPI stack causes");
+   ck.io(cycle_cause);
+   warm_ic_block = 1;	// the I-cache may be a different one
+}
+
+sim_results_t uarchsim_t::results() const {
+   sim_results_t r;
+   r.instructions = num_inst;
+   r.cycles = cycle;
+   r.loads = num_load;
+   r.load_sqmisses = num_load_sqmiss;
+   r.vp_eligible = num_eligible;
+   r.vp_correct = num_correct;
+   r.vp_incorrect = num_incorrect;
+   r.branch_mispredictions = BP.mispredictions();
+   r.ic_misses = IC.get_misses();
+   r.l1_misses = L1.get_misses();
+   r.l2_misses = L2.get_misses();
+   r.l3_misses = L3.get_misses();
+   r.prefetches_issued = stat_pfs_issued_to_mem;
+   for (int i = 0; i < NUM_CPI_CAUSES; i++)
+      r.cpi_cycles[i] = cpi_cycles[i];
+   // Not added to cpi_cycles: fetch moves past these cycles later and charges them to its own causes.
+   r.in_flight_cycles = ((cycle > fetch_cycle) ? (cycle - fetch_cycle) : 0);
+   r.in_flight_cause = cycle_cause;
+   return(r);
+}
+
 #define KILOBYTE	(1<<10)
 #define MEGABYTE	(1<<20)
 #define SCALED_SIZE(size)	((size/KILOBYTE >= KILOBYTE) ? (size/MEGABYTE) : (size/KILOBYTE))
@@ -476,25 +694,25 @@ void uarchsim_t::output() {
       //return track_names[static_cast<std::underlying_type<VPTracks>::type>(t)].c_str();
       return track_names[track].c_str();
    };
-   printf("VP_ENABLE = %d\n", (VP_ENABLE ? 1 : 0));
-   printf("VP_PERFECT = %s\n", (VP_ENABLE ? (VP_PERFECT ? "1" : "0") : "n/a"));
-   printf("VP_TRACK = %s\n", (VP_ENABLE ? get_track_name(VP_TRACK) : "n/a"));
-   printf("WINDOW_SIZE = %ld\n", WINDOW_SIZE);
-   printf("FETCH_WIDTH = %ld\n", FETCH_WIDTH);
-   printf("FETCH_NUM_BRANCH = %ld\n", FETCH_NUM_BRANCH);
-   printf("FETCH_STOP_AT_INDIRECT = %s\n", (FETCH_STOP_AT_INDIRECT ? "1" : "0"));
-   printf("FETCH_STOP_AT_TAKEN = %s\n", (FETCH_STOP_AT_TAKEN ? "1" : "0"));
-   printf("FETCH_MODEL_ICACHE = %s\n", (FETCH_MODEL_ICACHE ? "1" : "0"));
-   printf("PERFECT_BRANCH_PRED = %s\n", (PERFECT_BRANCH_PRED ? "1" : "0"));
-   printf("PERFECT_INDIRECT_PRED = %s\n", (PERFECT_INDIRECT_PRED ? "1" : "0"));
-   printf("PIPELINE_FILL_LATENCY = %ld\n", PIPELINE_FILL_LATENCY);
-   printf("NUM_LDST_LANES = %ld%s", NUM_LDST_LANES, ((NUM_LDST_LANES > 0) ? "\n" : " (unbounded)\n"));
-   printf("NUM_ALU_LANES = %ld%s", NUM_ALU_LANES, ((NUM_ALU_LANES > 0) ? "\n" : " (unbounded)\n"));
+   printf("VP_ENABLE = %d\n", (cfg.vp_enable ? 1 : 0));
+   printf("VP_PERFECT = %s\n", (cfg.vp_enable ? (cfg.vp_perfect ? "1" : "0") : "n/a"));
+   printf("VP_TRACK = %s\n", (cfg.vp_enable ? get_track_name(cfg.vp_track) : "n/a"));
+   printf("WINDOW_SIZE = %ld\n", cfg.window_size);
+   printf("FETCH_WIDTH = %ld\n", cfg.fetch_width);
+   printf("FETCH_NUM_BRANCH = %ld\n", cfg.fetch_num_branch);
+   printf("FETCH_STOP_AT_INDIRECT = %s\n", (cfg.fetch_stop_at_indirect ? "1" : "0"));
+   printf("FETCH_STOP_AT_TAKEN = %s\n", (cfg.fetch_stop_at_taken ? "1" : "0"));
+   printf("FETCH_MODEL_ICACHE = %s\n", (cfg.fetch_model_icache ? "1" : "0"));
+   printf("PERFECT_BRANCH_PRED = %s\n", (cfg.perfect_branch_pred ? "1" : "0"));
+   printf("PERFECT_INDIRECT_PRED = %s\n", (cfg.perfect_indirect_pred ? "1" : "0"));
+   printf("PIPELINE_FILL_LATENCY = %ld\n", cfg.pipeline_fill_latency);
+   printf("NUM_LDST_LANES = %ld%s", cfg.num_ldst_lanes, ((cfg.num_ldst_lanes > 0) ? "\n" : " (unbounded)\n"));
+   printf("NUM_ALU_LANES = %ld%s", cfg.num_alu_lanes, ((cfg.num_alu_lanes > 0) ? "\n" : " (unbounded)\n"));
    //BP.output();
    printf("MEMORY HIERARCHY CONFIGURATION---------------------\n");
-   printf("STRIDE Prefetcher = %s\n", PREFETCHER_ENABLE ? "1" : "0");
-   printf("PERFECT_CACHE = %s\n", (PERFECT_CACHE ? "1" : "0"));
-   printf("WRITE_ALLOCATE = %s\n", (WRITE_ALLOCATE ? "1" : "0"));
+   printf("STRIDE Prefetcher = %s\n", cfg.prefetcher_enable ? "1" : "0");
+   printf("PERFECT_CACHE = %s\n", (cfg.perfect_cache ? "1" : "0"));
+   printf("WRITE_ALLOCATE = %s\n", (cfg.write_allocate ? "1" : "0"));
    printf("Within-pipeline factors:\n");
    printf("\tAGEN latency = 1 cycle\n");
    printf("\tStore Queue (SQ): SQ size = window size, oracle memory disambiguation, store-load forwarding = 1 cycle after store's or load's agen.\n");
@@ -503,23 +721,23 @@ void uarchsim_t::output() {
    printf("\t* are buffered until the block is allocated and the store is\n");
    printf("\t* performed in the L1$. While buffered, conflicting loads get\n");
    printf("\t* the store's data as they would from the SQ.\n");
-   if (FETCH_MODEL_ICACHE) {
+   if (cfg.fetch_model_icache) {
       printf("I$: %ld %s, %ld-way set-assoc., %ldB block size\n",
-   	     SCALED_SIZE(IC_SIZE), SCALED_UNIT(IC_SIZE), IC_ASSOC, IC_BLOCKSIZE);
+   	     SCALED_SIZE(cfg.ic_size), SCALED_UNIT(cfg.ic_size), cfg.ic_assoc, cfg.ic_blocksize);
    }
    printf("L1$: %ld %s, %ld-way set-assoc., %ldB block size, %ld-cycle search latency\n",
-   	  SCALED_SIZE(L1_SIZE), SCALED_UNIT(L1_SIZE), L1_ASSOC, L1_BLOCKSIZE, L1_LATENCY);
+   	  SCALED_SIZE(cfg.l1_size), SCALED_UNIT(cfg.l1_size), cfg.l1_assoc, cfg.l1_blocksize, cfg.l1_latency);
    printf("L2$: %ld %s, %ld-way set-assoc., %ldB block size, %ld-cycle search latency\n",
-   	  SCALED_SIZE(L2_SIZE), SCALED_UNIT(L2_SIZE), L2_ASSOC, L2_BLOCKSIZE, L2_LATENCY);
+   	  SCALED_SIZE(cfg.l2_size), SCALED_UNIT(cfg.l2_size), cfg.l2_assoc, cfg.l2_blocksize, cfg.l2_latency);
    printf("L3$: %ld %s, %ld-way set-assoc., %ldB block size, %ld-cycle search latency\n",
-   	  SCALED_SIZE(L3_SIZE), SCALED_UNIT(L3_SIZE), L3_ASSOC, L3_BLOCKSIZE, L3_LATENCY);
-   printf("Main Memory: %ld-cycle fixed search time\n", MAIN_MEMORY_LATENCY);
+   	  SCALED_SIZE(cfg.l3_size), SCALED_UNIT(cfg.l3_size), cfg.l3_assoc, cfg.l3_blocksize, cfg.l3_latency);
+   printf("Main Memory: %ld-cycle fixed search time\n", cfg.main_memory_latency);
    printf("STORE QUEUE MEASUREMENTS---------------------------\n");
    printf("Number of loads: %ld\n", num_load);
    printf("Number of loads that miss in SQ: %ld (%.2f%%)\n", num_load_sqmiss, 100.0*(double)num_load_sqmiss/(double)num_load);
    printf("Number of PFs issued to the memory system %ld\n", stat_pfs_issued_to_mem);
    printf("MEMORY HIERARCHY MEASUREMENTS----------------------\n");
-   if (FETCH_MODEL_ICACHE) {
+   if (cfg.fetch_model_icache) {
       printf("I$:\n"); IC.stats();
    }
    printf("L1$:\n"); L1.stats();
@@ -530,6 +748,14 @@ void uarchsim_t::output() {
    printf("instructions = %ld\n", num_inst);
    printf("cycles       = %ld\n", cycle);
    printf("IPC          = %.3f\n", ((double)num_inst/(double)cycle));
+   if (num_warmed)
+      printf("warmed       = %ld (functional warming, not timed)\n", num_warmed);
+   printf("CPI STACK------------------------------------------\n");
+   sim_results_t r = results();
+   r.cpi_cycles[r.in_flight_cause] += r.in_flight_cycles;
+   for (int i = 0; i < NUM_CPI_CAUSES; i++)
+      printf("%-10s = %.3f (%5.2f%%)\n", cpi_cause_names[i], ((double)r.cpi_cycles[i]/(double)num_inst), (100.0*(double)r.cpi_cycles[i]/(double)cycle));
+   printf("total CPI  = %.3f\n", ((double)cycle/(double)num_inst));
    printf("Prefetcher------------------------------------------\n");
    prefetcher.print_stats();
    printf("CVP STUDY------------------------------------------\n");
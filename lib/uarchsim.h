@@ -27,6 +27,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "spdlog/fmt/ostr.h"
 #include "cvp.h"
 #include "stride_prefetcher.h"
+#include "store_queue.h"
+#include "sim_config.h"
+#include "checkpoint.h"
 using namespace std;
 
 #ifndef _RISCV_UARCHSIM_H
@@ -35,36 +38,80 @@ using namespace std;
 #define RFSIZE 65	// integer: r0-r31.  fp/simd: r32-r63. flags: r64.
 #define RFFLAGS 64	// flags register is r64 (65th register)
 
+// Causes the cycles of a simulation are attributed to (CPI stack). Every advance of the fetch cycle is charged to
+// its cause; when fetch waits for a full window, the advance is charged to the step that delayed the oldest
+// instruction (the longest of its dependence, lane, execution and memory delays). The cycles after the fetch cycle,
+// for the instructions in flight, are charged to the step that delayed the last one to complete.
+enum cpi_cause_t {
+   CPI_FETCH,		// fetch bundle boundaries (fetch width, branches per bundle, taken and indirect branches)
+   CPI_ICACHE,		// I-cache misses
+   CPI_BRANCH,		// branch mispredictions: fetch waits for the branch to execute
+   CPI_VP_SQUASH,	// value mispredictions: fetch waits for the mispredicted instruction to retire
+   CPI_PIPELINE,	// pipeline fill latency (and draining the window before functional warming)
+   CPI_DEPENDENCE,	// waiting for source operands
+   CPI_LANES,		// waiting for an execution lane
+   CPI_EXECUTION,	// execution latency (ALU, AGEN and SQ search for loads)
+   CPI_MEMORY,		// load data latency past the SQ search (D$ hits and misses, store-load forwarding)
+   NUM_CPI_CAUSES
+};
+
+extern const char *const cpi_cause_names[NUM_CPI_CAUSES];
+
 struct window_t {
    uint64_t retire_cycle;
    uint64_t seq_no;
    uint64_t addr;
    uint64_t value;
    uint64_t latency;
+   cpi_cause_t cause;	// step that delayed the retire cycle (CPI stack)
 };
 
-struct store_queue_t {
-   uint64_t exec_cycle;	// store's execution cycle
-   uint64_t ret_cycle;	// store's commit cycle
+// Headline measurements of a simulation, for drivers that tabulate many of them.
+struct sim_results_t {
+   uint64_t instructions;
+   uint64_t cycles;
+   uint64_t loads;
+   uint64_t load_sqmisses;
+   uint64_t vp_eligible;
+   uint64_t vp_correct;
+   uint64_t vp_incorrect;	// each squashes the instructions after it
+   uint64_t branch_mispredictions;
+   uint64_t ic_misses;
+   uint64_t l1_misses;
+   uint64_t l2_misses;
+   uint64_t l3_misses;
+   uint64_t prefetches_issued;
+   uint64_t cpi_cycles[NUM_CPI_CAUSES];	// cycles up to the fetch cycle by cause (never decrease)
+   uint64_t in_flight_cycles;		// cycles after the fetch cycle, of the instructions in flight,
+   cpi_cause_t in_flight_cause;		// and their cause: with cpi_cycles, they add up to cycles
 };
 
+class interval_stats_t;
+
 // Class for a microarchitectural simulator.
 
 class uarchsim_t {
    private:
       // Add your class member variables here to facilitate your limit study.
 
+      // configuration (declared first: the structures below are built from it)
+      const sim_config_t cfg;
+
       // register timestamps
       uint64_t RF[RFSIZE];
 
       // store queue byte timestamps
-      map<uint64_t, store_queue_t> SQ;
+      store_queue_t SQ;
 
       // memory block timestamps
       cache_t L1;
       cache_t L2;
       cache_t L3;
 
+      // piece of the current trace instruction (instructions cracked into several micro-ops share their PC)
+      uint8_t piece;
+      uint64_t prev_pc;
+
       // fetch timestamp
       uint64_t fetch_cycle;
       uint64_t previous_fetch_cycle = 0;
@@ -88,6 +135,14 @@ class uarchsim_t {
       uint64_t num_inst;
       uint64_t cycle;
 
+      // Instructions warmed functionally (not timed, not in num_inst).
+      uint64_t num_warmed;
+      uint64_t warm_ic_block;	// I-cache block last warmed, while no detailed simulation touched the I-cache
+
+      // CPI stack: cycles up to fetch_cycle by cause, and the cause of the cycles after it.
+      uint64_t cpi_cycles[NUM_CPI_CAUSES];
+      cpi_cause_t cycle_cause;
+
       // CVP measurements
       uint64_t num_eligible;
       uint64_t num_correct;
@@ -99,16 +154,27 @@ class uarchsim_t {
 
       uint64_t stat_pfs_issued_to_mem = 0;
 
+      // Interval time series (-o), recorded every time num_inst reaches its next row.
+      interval_stats_t *intervals = NULL;
+
       // Helper for oracle hit/miss information
       uint64_t get_load_exec_cycle(db_t *inst) const;
 
+      // Moves fetch_cycle forward to "to" (if later) because of "cause" (CPI stack).
+      void advance_fetch(uint64_t to, cpi_cause_t cause);
+
    public:
-      uarchsim_t();
+      uarchsim_t(const sim_config_t &config);
       ~uarchsim_t();
 
       //void set_funcsim(processor_t *funcsim);
       void step(db_t *inst);
+      void step_batch(db_t *inst, size_t n);	// steps inst[0..n-1] in order
+      void warm(db_t *inst);			// trains caches and predictors with inst, without timing it
       void output();
+      sim_results_t results() const;
+      void record_intervals(interval_stats_t *stats) { intervals = stats; }
+      void checkpoint(checkpoint_t &ck);	// saves or restores the complete state (see checkpoint.h)
       PredictionRequest get_prediction_req_for_track(uint64_t cycle, uint64_t seq_no, uint8_t piece, db_t *inst);
 };
 
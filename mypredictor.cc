@@ -842,9 +842,54 @@ speculativeUpdate (uint64_t seq_no,	// dynamic micro-instruction # (starts at 0
       }
 }
 
+// random() state, kept here so that checkpoints can save it (initstate(1, ..., 128) is the default state).
+static int32_t random_state[32];
+
 void
 beginPredictor (int argc_other, char **argv_other)
 {
+  initstate (1, (char *) random_state, sizeof (random_state));
+}
+
+// Checkpoint hooks (see cvp.h): the predictor's state is its global tables, histories and in-flight instructions.
+static bool
+transferState (FILE * fp, bool save)
+{
+  struct
+  {
+    void *p;
+    size_t size;
+  } state[] = {
+    {gpath, sizeof (gpath)}, {&gtargeth, sizeof (gtargeth)},
+    {STR, sizeof (STR)}, {&SafeStride, sizeof (SafeStride)},
+    {LDATA, sizeof (LDATA)}, {Vtage, sizeof (Vtage)},
+    {&TICK, sizeof (TICK)}, {&LastMispVT, sizeof (LastMispVT)},
+    {Update, sizeof (Update)}, {&seq_commit, sizeof (seq_commit)},
+    {random_state, sizeof (random_state)}
+  };
+  static int32_t parked[32];
+  if (save)
+    setstate ((char *) random_state);	// syncs the position of random() in random_state
+  else
+    initstate (1, (char *) parked, sizeof (parked));	// setstate() below would otherwise overwrite that position
+  for (auto & s:state)
+    if ((save ? fwrite (s.p, 1, s.size, fp) : fread (s.p, 1, s.size, fp)) != s.size)
+      return false;
+  if (!save)
+    setstate ((char *) random_state);
+  return true;
+}
+
+bool
+savePredictor (FILE * fp)
+{
+  return transferState (fp, true);
+}
+
+bool
+restorePredictor (FILE * fp)
+{
+  return transferState (fp, false);
 }
 
 void
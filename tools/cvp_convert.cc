@@ -0,0 +1,112 @@
+// cvp-convert: converts a trace to another trace format.
+//
+// Usage: cvp-convert [-f <format>] <input trace> <output file>
+//
+// The input may be in any format the simulator reads. Supported output formats:
+//   native : pre-cracked micro-ops, memory-mapped by the simulator (default)
+//   block  : CVP-1 records in independently compressed blocks, decompressed in parallel by the simulator
+//            (the input must be a CVP-1, block or codec trace)
+//   columnar : pre-cracked micro-ops stored field by field, so that simulations read only the fields they use
+//   codec  : CVP-1 records coded as residuals of PC, address and value predictions, much smaller than gzip
+//            (the input must be a CVP-1, block or codec trace)
+//   dict   : records holding only dynamic fields, static fields stored once per static instruction
+//            (the input must be a CVP-1, block or codec trace)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "trace_reader.h"
+#include "native_trace.h"
+#include "block_trace.h"
+#include "columnar_trace.h"
+#include "codec_trace.h"
+#include "dict_trace.h"
+#include "parameters.h"
+#include "progress.h"
+
+static void usage(const char *prog) {
+   printf("usage:\t%s\n\t[optional: -f <format>, format is one of: native (default), block, columnar, codec, dict]\n\t[optional: -b <block_KB> (block and dict formats)]\n\t[optional: -j <threads> (block format)]\n\t[REQUIRED: input trace file]\n\t[REQUIRED: output file]\n", prog);
+   exit(0);
+}
+
+int main(int argc, char **argv) {
+   const char *format = "native";
+   size_t block_size = DEFAULT_TRACE_BLOCK_SIZE;
+   int i = 1;
+
+   while ((i < argc) && (argv[i][0] == '-')) {
+      if (!strcmp(argv[i], "-f") && (i + 1 < argc)) {
+         format = argv[i + 1];
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-b") && (i + 1 < argc)) {
+         block_size = ((size_t)atoi(argv[i + 1]) << 10);
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-j") && (i + 1 < argc)) {
+         TRACE_THREADS = atoi(argv[i + 1]);
+         i += 2;
+      }
+      else {
+         usage(argv[0]);
+      }
+   }
+   if (i + 2 != argc)
+      usage(argv[0]);
+
+   const char *in_name = argv[i];
+   const char *out_name = argv[i + 1];
+
+   if (!strcmp(format, "block") || !strcmp(format, "codec") || !strcmp(format, "dict")) {
+      if (is_native_trace(in_name) || is_columnar_trace(in_name) || is_dict_trace(in_name)) {
+         fprintf(stderr, "%s: %s is not a CVP-1 trace, convert the trace it was converted from\n", argv[0], in_name);
+         return(1);
+      }
+      bool ok;
+      if (!strcmp(format, "block"))
+         ok = block_trace_pack(in_name, out_name, block_size, 6, TRACE_THREADS);
+      else if (!strcmp(format, "codec"))
+         ok = codec_trace_pack(in_name, out_name);
+      else
+         ok = dict_trace_pack(in_name, out_name, block_size);
+      if (!ok) {
+         fprintf(stderr, "%s: cannot write %s\n", argv[0], out_name);
+         return(1);
+      }
+      return(0);
+   }
+   if (strcmp(format, "native") && strcmp(format, "columnar"))
+      usage(argv[0]);
+
+   trace_options_t options;
+   options.buffer_size = TRACE_BUFFER_SIZE;
+   options.threads = TRACE_THREADS;
+   trace_reader_t *reader = open_trace(in_name, options);
+   bool columnar = !strcmp(format, "columnar");
+   native_trace_writer_t *native_writer = (columnar ? NULL : new native_trace_writer_t(out_name));
+   columnar_trace_writer_t *columnar_writer = (columnar ? new columnar_trace_writer_t(out_name) : NULL);
+   progress_t progress(reader, PROGRESS_INTERVAL);
+
+   db_t *inst;
+   uint64_t prev_num_instr = 0;
+   while ((inst = reader->get_inst())) {
+      // A micro-op is the first piece of its trace instruction if it made the reader consume a new trace instruction.
+      bool first_piece = (reader->num_instr() != prev_num_instr);
+      if (columnar)
+         columnar_writer->write(inst, first_piece);
+      else
+         native_writer->write(inst, first_piece);
+      prev_num_instr = reader->num_instr();
+      delete inst;
+      progress.tick(1);
+   }
+   progress.finish();
+
+   delete native_writer;
+   delete columnar_writer;
+   delete reader;
+   return(0);
+}
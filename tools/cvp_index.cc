@@ -0,0 +1,40 @@
+// cvp-index: builds the random-access index of a gzip-compressed trace.
+//
+// Usage: cvp-index [-s <span_MB>] <trace.gz>
+//
+// Writes <trace.gz>.idx, which lets the simulator start at any trace instruction
+// (-k) after inflating at most about span_MB of the trace.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "gz_index.h"
+
+static void usage(const char *prog) {
+   printf("usage:\t%s\n\t[optional: -s <span_MB>, distance between index points (default: %d)]\n\t[REQUIRED: .gz trace file]\n", prog, (DEFAULT_GZ_INDEX_SPAN >> 20));
+   exit(0);
+}
+
+int main(int argc, char **argv) {
+   uint64_t span = DEFAULT_GZ_INDEX_SPAN;
+   int i = 1;
+
+   while ((i < argc) && (argv[i][0] == '-')) {
+      if (!strcmp(argv[i], "-s") && (i + 1 < argc)) {
+         span = ((uint64_t)atoi(argv[i + 1]) << 20);
+         i += 2;
+      }
+      else {
+         usage(argv[0]);
+      }
+   }
+   if (i + 1 != argc)
+      usage(argv[0]);
+
+   if (!gz_index_build(argv[i], span)) {
+      fprintf(stderr, "Cannot build index of %s\n", argv[i]);
+      return(1);
+   }
+   return(0);
+}
@@ -0,0 +1,81 @@
+// cvp-simpoint: picks the simulation points of a trace (see lib/simpoint.h).
+//
+// Usage: cvp-simpoint [-i <interval_size>] [-k <max_k>] [-s <seed>] <trace> <simpoint_file>
+//
+// Profiles the basic-block vector of every interval of interval_size trace
+// instructions, clusters them and writes the representative intervals and
+// their weights to simpoint_file, for cvp -x.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <string>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "trace_reader.h"
+#include "simpoint.h"
+
+#define DEFAULT_INTERVAL_SIZE	1000000
+#define DEFAULT_MAX_K		10
+#define BATCH_SIZE		64
+
+static void usage(const char *prog) {
+   printf("usage:\t%s\n\t[optional: -i <interval_size>, trace instructions per interval (default: %d)]\n\t[optional: -k <max_k>, maximum number of simulation points (default: %d)]\n\t[optional: -s <seed> of the clustering (default: 1)]\n\t[REQUIRED: trace file]\n\t[REQUIRED: simulation point file to write]\n", prog, DEFAULT_INTERVAL_SIZE, DEFAULT_MAX_K);
+   exit(0);
+}
+
+int main(int argc, char **argv) {
+   uint64_t interval_size = DEFAULT_INTERVAL_SIZE;
+   unsigned max_k = DEFAULT_MAX_K;
+   uint64_t seed = 1;
+   int i = 1;
+
+   while ((i < argc) && (argv[i][0] == '-')) {
+      if (!strcmp(argv[i], "-i") && (i + 1 < argc)) {
+         interval_size = strtoull(argv[i + 1], NULL, 0);
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-k") && (i + 1 < argc)) {
+         max_k = atoi(argv[i + 1]);
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-s") && (i + 1 < argc)) {
+         seed = strtoull(argv[i + 1], NULL, 0);
+         i += 2;
+      }
+      else {
+         usage(argv[0]);
+      }
+   }
+   if ((i + 2 != argc) || !interval_size || !max_k)
+      usage(argv[0]);
+
+   // The profile only needs the pc and class of each micro-op.
+   trace_options_t options;
+   options.fields = TRACE_FIELD_PC;
+   trace_reader_t *reader = open_trace(argv[i], options);
+   bbv_profile_t profile(interval_size);
+   db_t batch[BATCH_SIZE];
+   uint64_t instr;
+   size_t n;
+   do {
+      instr = reader->num_instr();
+      n = reader->get_batch(batch, BATCH_SIZE);
+      profile.add(batch, n, instr);
+   } while (n == BATCH_SIZE);
+   instr = reader->num_instr();
+   profile.finish(instr);
+   delete reader;
+
+   simpoints_t simpoints = pick_simpoints(profile.vectors, interval_size, max_k, seed);
+   std::string comment = (std::string("simulation points of ") + argv[i]);
+   if (!simpoints.write(argv[i + 1], comment.c_str())) {
+      fprintf(stderr, "Cannot write %s\n", argv[i + 1]);
+      return(1);
+   }
+   printf("%" PRIu64 " instructions, %zu intervals of %" PRIu64 ", %zu simulation points:\n", instr, profile.vectors.size(), interval_size, simpoints.points.size());
+   for (const simpoint_t &point : simpoints.points)
+      printf("\tinterval %" PRIu64 " (instructions %" PRIu64 "..), weight %.4f\n", point.interval, point.interval * interval_size, point.weight);
+   return(0);
+}
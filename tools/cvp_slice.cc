@@ -0,0 +1,164 @@
+// cvp-slice: cuts, samples and splices CVP-1 traces.
+//
+// Usage: cvp-slice [-p <period>,<length>[,<offset>]] [-z <gzip_level>] <output trace> <input>[@<start>[+<count>]] ...
+//
+// The output is the concatenation of the input segments, in order. A segment
+// is a whole input trace, or "count" trace instructions (default: up to the
+// end) starting at trace instruction "start". With -p, only the first
+// "length" instructions of every "period" instructions of each segment are
+// kept, starting "offset" instructions into the segment (periodic sampling).
+//
+// Records are copied byte for byte, so the output is a regular CVP-1 trace
+// (gzip-compressed if its name ends in ".gz"). Inputs may be gzip, uncompressed,
+// block or codec traces; starting a segment deep into a gzip trace is fast if the
+// trace has an index (see cvp-index). Every input is opened before the output
+// is created, and an existing output file is only replaced by a complete trace.
+//
+// Examples:
+//   cvp-slice warm_and_measure.gz a.gz@0+10000000 b.gz@50000000+100000000
+//   cvp-slice -p 10000000,100000 sampled.gz a.gz
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "cvp_trace_writer.h"
+#include "trace_reader.h"
+#include "parameters.h"
+
+static void usage(const char *prog) {
+   printf("usage:\t%s\n\t[optional: -p <period>,<length>[,<offset>] to keep length out of every period instructions]\n\t[optional: -z <gzip_level> (default: 6)]\n\t[REQUIRED: output trace file]\n\t[REQUIRED: one or more input segments: <trace file>[@<start>[+<count>]]]\n", prog);
+   exit(0);
+}
+
+struct segment_t {
+   std::string name;
+   uint64_t start;
+   uint64_t count;	// UINT64_MAX: up to the end of the trace
+};
+
+// Parses <trace file>[@<start>[+<count>]].
+static bool parse_segment(const char *arg, segment_t &seg) {
+   seg.name = arg;
+   seg.start = 0;
+   seg.count = UINT64_MAX;
+
+   const char *at = strrchr(arg, '@');
+   if (!at)
+      return(true);
+   seg.name.assign(arg, at - arg);
+
+   char *end;
+   seg.start = strtoull(at + 1, &end, 0);
+   if (end == at + 1)
+      return(false);
+   if (*end == '+') {
+      const char *count = end + 1;
+      seg.count = strtoull(count, &end, 0);
+      if (end == count)
+         return(false);
+   }
+   return(*end == '\0');
+}
+
+// Opens the segment's trace, or returns NULL after reporting why it cannot be sliced.
+static CVPTraceReader *open_segment(const char *prog, const segment_t &seg) {
+   trace_options_t options;
+   options.buffer_size = TRACE_BUFFER_SIZE;
+   trace_reader_t *trace = open_trace(seg.name.c_str(), options);
+   CVPTraceReader *reader = dynamic_cast<CVPTraceReader *>(trace);
+   if (!reader || reader->mDict) {
+      fprintf(stderr, "%s: %s is not a CVP-1 trace, use the trace it was converted from\n", prog, seg.name.c_str());
+      delete trace;
+      return(NULL);
+   }
+   reader->mPrintSummary = false;
+   return(reader);
+}
+
+// Copies trace instructions [from, from + n) of the segment's reader to the writer.
+// Returns the number of instructions copied (fewer than n at the end of the trace).
+static uint64_t copy(CVPTraceReader *reader, uint64_t from, uint64_t n, cvp_trace_writer_t &writer) {
+   if ((reader->num_instr() != from) && !reader->seek(from))
+      return(0);
+   uint64_t copied;
+   for (copied = 0; (copied < n) && reader->readInstr(); copied++)
+      writer.write_instr(*reader);
+   return(copied);
+}
+
+int main(int argc, char **argv) {
+   uint64_t period = 0, length = 0, offset = 0;
+   int level = 6;
+   int i = 1;
+
+   while ((i < argc) && (argv[i][0] == '-')) {
+      if (!strcmp(argv[i], "-p") && (i + 1 < argc)) {
+         int n = sscanf(argv[i + 1], "%" SCNu64 ",%" SCNu64 ",%" SCNu64, &period, &length, &offset);
+         if ((n < 2) || (period == 0) || (length == 0) || (length > period))
+            usage(argv[0]);
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-z") && (i + 1 < argc)) {
+         level = atoi(argv[i + 1]);
+         i += 2;
+      }
+      else {
+         usage(argv[0]);
+      }
+   }
+   if (i + 2 > argc)
+      usage(argv[0]);
+
+   const char *out_name = argv[i++];
+   std::vector<segment_t> segments(argc - i);
+   for (size_t s = 0; s < segments.size(); s++) {
+      if (!parse_segment(argv[i + s], segments[s])) {
+         fprintf(stderr, "%s: invalid segment %s\n", argv[0], argv[i + s]);
+         return(1);
+      }
+   }
+
+   // Check every segment before creating the output, so that a mistyped argument does not cost an existing trace.
+   for (auto &seg : segments) {
+      CVPTraceReader *reader = open_segment(argv[0], seg);
+      if (!reader)
+         return(1);
+      delete reader;
+   }
+
+   cvp_trace_writer_t writer(out_name, level);
+
+   for (auto &seg : segments) {
+      CVPTraceReader *reader = open_segment(argv[0], seg);
+      if (!reader)
+         return(1);
+
+      uint64_t end = ((seg.count > UINT64_MAX - seg.start) ? UINT64_MAX : (seg.start + seg.count));
+      uint64_t before = writer.get_num_instr();
+      if (period == 0) {
+         copy(reader, seg.start, end - seg.start, writer);
+      }
+      else {
+         for (uint64_t from = seg.start + offset; from < end; from += period) {
+            uint64_t n = std::min(length, end - from);
+            if (copy(reader, from, n, writer) < n)
+               break;
+         }
+      }
+      fprintf(stderr, "%s: %" PRIu64 " instrs\n", seg.name.c_str(), writer.get_num_instr() - before);
+      delete reader;
+   }
+
+   if (!writer.close()) {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], out_name);
+      return(1);
+   }
+   fprintf(stderr, "%s: %" PRIu64 " instrs\n", out_name, writer.get_num_instr());
+   return(0);
+}
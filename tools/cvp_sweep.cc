@@ -0,0 +1,278 @@
+// cvp-sweep: runs many (trace, configuration) simulations on a thread pool in one process.
+//
+// Usage: cvp-sweep [-j <threads>] [-o <output file>] [-B <trace_buffer_MB>] <sweep_file> <trace> [<trace> ...]
+//        cvp-sweep [-j <threads>] [-o <output file>] [-B <trace_buffer_MB>] -l <job_file>
+//
+// Each line of the sweep file holds the simulator options of one configuration
+// (see cvp -m); every configuration is simulated on every trace. Each line of a
+// job file holds a trace name followed by the simulator options of one job.
+// Empty lines and lines starting with '#' are ignored.
+//
+// Each trace is decoded once into memory, in the native trace layout, and all
+// the jobs on that trace read the same decoded pages; the decoded trace is
+// dropped when its last job is done. Jobs are started longest first (by trace
+// file size), and threads take the next job as soon as they are done with one,
+// so that the long jobs do not end up last. Results are written as one CSV
+// table, in job order.
+//
+// The value predictor is global state shared by the whole process: only
+// perfect value prediction (-v -p) can be simulated. Use cvp -m to sweep
+// configurations with the value predictor.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cvp.h"
+#include "trace_reader.h"
+#include "native_trace.h"
+#include "trace_cache.h"
+#include "sim_config.h"
+#include "fifo.h"
+#include "cache.h"
+#include "bp.h"
+#include "resource_schedule.h"
+#include "uarchsim.h"
+
+#define SWEEP_BATCH_SIZE	64	// micro-ops handed from the reader to the simulator at a time
+
+struct sweep_trace_t {
+   std::string name;
+   uint64_t size;		// file size, to start long jobs first
+   std::mutex lock;		// held while decoding
+   bool decoded;
+   int fd;			// decoded trace (-1: could not decode, read directly)
+   unsigned jobs_left;		// jobs that have not opened the decoded trace yet (protected by lock)
+};
+
+struct sweep_job_t {
+   size_t trace;
+   std::string options;
+   sim_config_t config;
+   sim_results_t results;
+   bool ok;
+};
+
+static void usage(const char *prog) {
+   printf("usage:\t%s\n\t[optional: -j <threads> (default: one per core)]\n\t[optional: -o <output file> (default: stdout)]\n\t[optional: -B <trace_buffer_MB>]\n\t[REQUIRED: <sweep_file> followed by one or more trace files, or -l <job_file>]\n", prog);
+   exit(0);
+}
+
+// Returns the non-empty, non-comment lines of a file.
+static std::vector<std::string> read_lines(const char *prog, const char *name) {
+   std::ifstream file(name);
+   if (!file) {
+      fprintf(stderr, "%s: cannot read %s\n", prog, name);
+      exit(1);
+   }
+   std::vector<std::string> lines;
+   std::string line;
+   while (std::getline(file, line)) {
+      std::istringstream tokens(line);
+      std::string first;
+      if ((tokens >> first) && (first[0] != '#'))
+         lines.push_back(line);
+   }
+   return(lines);
+}
+
+static size_t add_trace(std::vector<sweep_trace_t *> &traces, const std::string &name) {
+   for (size_t t = 0; t < traces.size(); t++)
+      if (traces[t]->name == name)
+         return(t);
+   struct stat st;
+   if (stat(name.c_str(), &st)) {
+      fprintf(stderr, "Cannot open trace %s\n", name.c_str());
+      exit(1);
+   }
+   sweep_trace_t *trace = new sweep_trace_t;
+   trace->name = name;
+   trace->size = st.st_size;
+   trace->decoded = false;
+   trace->fd = -1;
+   trace->jobs_left = 0;
+   traces.push_back(trace);
+   return(traces.size() - 1);
+}
+
+static void add_job(const char *prog, std::vector<sweep_job_t> &jobs, size_t trace, const std::string &options) {
+   sweep_job_t job;
+   job.trace = trace;
+   // Trim the options and drop comments: they label the job in the results.
+   std::string label = options.substr(0, options.find('#'));
+   size_t first = label.find_first_not_of(" \t");
+   size_t last = label.find_last_not_of(" \t\r");
+   job.options = ((first == std::string::npos) ? "" : label.substr(first, last - first + 1));
+   if (!job.config.parse_string(job.options)) {
+      fprintf(stderr, "%s: invalid configuration: %s\n", prog, job.options.c_str());
+      exit(1);
+   }
+   if (job.config.vp_enable && !job.config.vp_perfect) {
+      fprintf(stderr, "%s: %s: only perfect value prediction (-v -p) can be swept in one process, use cvp -m\n", prog, job.options.c_str());
+      exit(1);
+   }
+   job.ok = false;
+   jobs.push_back(job);
+}
+
+// Opens the trace of a job, decoding it first if it is the first job on it.
+static trace_reader_t *open_job_trace(sweep_trace_t &trace, const trace_options_t &options) {
+   std::lock_guard<std::mutex> guard(trace.lock);
+   if (!trace.decoded) {
+      fprintf(stderr, "Decoding %s\n", trace.name.c_str());
+      trace.fd = decode_trace(trace.name.c_str(), options);
+      trace.decoded = true;
+   }
+
+   trace_reader_t *reader;
+   if (trace.fd >= 0)
+      reader = new native_trace_reader_t(dup(trace.fd), trace.name.c_str());
+   else
+      reader = open_trace(trace.name.c_str(), options);
+
+   // Readers keep the decoded trace mapped: it is freed once the last one is done.
+   if ((--trace.jobs_left == 0) && (trace.fd >= 0)) {
+      close(trace.fd);
+      trace.fd = -1;
+   }
+   return(reader);
+}
+
+static void print_csv(FILE *fp, const std::vector<sweep_trace_t *> &traces, const std::vector<sweep_job_t> &jobs) {
+   fprintf(fp, "trace,config,instructions,cycles,ipc,loads,load_sq_misses,vp_eligible,vp_correct,vp_incorrect\n");
+   for (const sweep_job_t &job : jobs) {
+      if (!job.ok)
+         continue;
+      const sim_results_t &r = job.results;
+      // Options may hold commas (e.g., -F): quote them.
+      fprintf(fp, "%s,\"%s\",%" PRIu64 ",%" PRIu64 ",%.3f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+              traces[job.trace]->name.c_str(), job.options.c_str(), r.instructions, r.cycles,
+              (r.cycles ? ((double)r.instructions / (double)r.cycles) : 0.0),
+              r.loads, r.load_sqmisses, r.vp_eligible, r.vp_correct, r.vp_incorrect);
+   }
+}
+
+int main(int argc, char **argv) {
+   unsigned threads = 0;
+   const char *out_name = NULL;
+   const char *job_file = NULL;
+   trace_options_t options;
+   int i = 1;
+
+   while ((i < argc) && (argv[i][0] == '-')) {
+      if (!strcmp(argv[i], "-j") && (i + 1 < argc)) {
+         threads = atoi(argv[i + 1]);
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-o") && (i + 1 < argc)) {
+         out_name = argv[i + 1];
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-B") && (i + 1 < argc)) {
+         options.buffer_size = ((size_t)atoi(argv[i + 1]) << 20);
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-l") && (i + 1 < argc)) {
+         job_file = argv[i + 1];
+         i += 2;
+      }
+      else {
+         usage(argv[0]);
+      }
+   }
+   if (job_file ? (i != argc) : (argc - i < 2))
+      usage(argv[0]);
+   if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+
+   std::vector<sweep_trace_t *> traces;
+   std::vector<sweep_job_t> jobs;
+   if (job_file) {
+      for (const std::string &line : read_lines(argv[0], job_file)) {
+         std::istringstream tokens(line);
+         std::string trace;
+         tokens >> trace;
+         std::string rest;
+         std::getline(tokens, rest);
+         add_job(argv[0], jobs, add_trace(traces, trace), rest);
+      }
+   }
+   else {
+      std::vector<std::string> configs = read_lines(argv[0], argv[i]);
+      for (int t = i + 1; t < argc; t++)
+         for (const std::string &config : configs)
+            add_job(argv[0], jobs, add_trace(traces, argv[t]), config);
+   }
+   if (jobs.empty())
+      usage(argv[0]);
+   for (const sweep_job_t &job : jobs)
+      traces[job.trace]->jobs_left++;
+
+   // Longest first: jobs on larger traces first, and the jobs on a trace together so that it is decoded once
+   // and freed early.
+   std::vector<size_t> order(jobs.size());
+   for (size_t k = 0; k < jobs.size(); k++)
+      order[k] = k;
+   std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      const sweep_trace_t *ta = traces[jobs[a].trace], *tb = traces[jobs[b].trace];
+      return((ta->size > tb->size) || ((ta->size == tb->size) && (jobs[a].trace < jobs[b].trace)));
+   });
+
+   // Trace readers print a summary on stdout when they are done: keep stdout for the results only.
+   FILE *fp = (out_name ? fopen(out_name, "w") : fdopen(dup(1), "w"));
+   if (!fp) {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], (out_name ? out_name : "stdout"));
+      return(1);
+   }
+   fflush(stdout);
+   dup2(2, 1);
+
+   threads = std::min((size_t)threads, jobs.size());
+   std::atomic<size_t> next_job(0);
+   std::atomic<size_t> num_done(0);
+   auto start = std::chrono::steady_clock::now();
+   std::vector<std::thread> workers;
+   for (unsigned w = 0; w < threads; w++) {
+      workers.emplace_back([&]() {
+         std::vector<db_t> batch(SWEEP_BATCH_SIZE);
+         size_t k;
+         while ((k = next_job++) < jobs.size()) {
+            sweep_job_t &job = jobs[order[k]];
+            sweep_trace_t &trace = *traces[job.trace];
+            trace_reader_t *reader = open_job_trace(trace, options);
+
+            uarchsim_t *sim = new uarchsim_t(job.config);
+            size_t n;
+            while ((n = reader->get_batch(batch.data(), SWEEP_BATCH_SIZE)))
+               sim->step_batch(batch.data(), n);
+            job.results = sim->results();
+            job.ok = true;
+            delete sim;
+            delete reader;
+
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            fprintf(stderr, "[%zu/%zu] %s %s: IPC %.3f (%.0f s)\n", ++num_done, jobs.size(), trace.name.c_str(), job.options.c_str(),
+                    (job.results.cycles ? ((double)job.results.instructions / (double)job.results.cycles) : 0.0), elapsed);
+         }
+      });
+   }
+   for (auto &t : workers)
+      t.join();
+
+   print_csv(fp, traces, jobs);
+   fclose(fp);
+   for (sweep_trace_t *trace : traces)
+      delete trace;
+   return(0);
+}
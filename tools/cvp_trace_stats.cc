@@ -0,0 +1,395 @@
+// cvp-trace-stats: characterizes traces without simulating them.
+//
+// Usage: cvp-trace-stats [-j <threads>] [-f csv|json] [-o <output file>] <trace> [<trace> ...]
+//
+// For each trace, reports the instruction class mix, the load/store size
+// histogram, the number of static instructions, the instruction and data
+// footprints (distinct 64-byte lines) and register usage, as seen by the
+// simulator (i.e., after CVPTraceReader's flag-register fix-ups). Statistics
+// are per trace instruction, before cracking into micro-ops.
+//
+// Traces are decoded in parallel: gzip (or uncompressed) and codec traces one
+// per thread, block traces one block at a time, so that a single block trace
+// also keeps all threads busy. Native, columnar and dictionary traces do not
+// hold CVP-1 records and are not supported: profile the trace they were
+// converted from.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include "cvp.h"
+#include "cvp_trace_reader.h"
+#include "native_trace.h"
+#include "block_trace.h"
+#include "columnar_trace.h"
+#include "dict_trace.h"
+#include "trace_reader.h"
+
+#define LINE_SHIFT	6	// footprints are counted in 64-byte lines
+#define NUM_REGS	(Offset::ccOffset + 1)
+#define NUM_SIZE_BINS	8	// 1, 2, 4, 8, 16, 32, 64 bytes, other
+
+static const char *class_names[] = {"aluOp", "loadOp", "stOp", "condBrOp", "uncondDirBrOp", "uncondIndBrOp", "fpOp", "slowAluOp"};
+static const char *size_bin_names[NUM_SIZE_BINS] = {"1", "2", "4", "8", "16", "32", "64", "other"};
+#define NUM_CLASSES	(sizeof(class_names) / sizeof(class_names[0]))
+
+// Set of 64-bit keys (open addressing, linear probing). Key 0 is tracked on the side.
+class u64_set_t {
+private:
+   std::vector<uint64_t> slots;
+   uint64_t count;
+   bool has_zero;
+   int shift;	// 64 - log2(slots.size())
+
+   inline uint64_t slot_of(uint64_t key) const { return ((key * 0x9e3779b97f4a7c15ull) >> shift); }
+
+   void grow() {
+      std::vector<uint64_t> old;
+      old.swap(slots);
+      slots.assign(old.size() * 2, 0);
+      shift--;
+      for (uint64_t key : old)
+         if (key)
+            place(key);
+   }
+
+   inline bool place(uint64_t key) {
+      uint64_t mask = slots.size() - 1;
+      for (uint64_t i = slot_of(key); ; i = ((i + 1) & mask)) {
+         if (slots[i] == key)
+            return(false);
+         if (slots[i] == 0) {
+            slots[i] = key;
+            return(true);
+         }
+      }
+   }
+
+public:
+   u64_set_t() : slots(1 << 10, 0), count(0), has_zero(false), shift(64 - 10) {}
+
+   inline void insert(uint64_t key) {
+      if (key == 0) {
+         has_zero = true;
+         return;
+      }
+      if (place(key) && (++count * 2 > slots.size()))
+         grow();
+   }
+
+   void merge(const u64_set_t &other) {
+      for (uint64_t key : other.slots)
+         if (key)
+            insert(key);
+      has_zero = (has_zero || other.has_zero);
+   }
+
+   uint64_t size() const { return (count + (has_zero ? 1 : 0)); }
+};
+
+struct trace_stats_t {
+   uint64_t instr;
+   uint64_t classes[NUM_CLASSES];
+   uint64_t load_sizes[NUM_SIZE_BINS];
+   uint64_t store_sizes[NUM_SIZE_BINS];
+   uint64_t taken;
+   uint64_t reg_reads[NUM_REGS];
+   uint64_t reg_writes[NUM_REGS];
+   u64_set_t pcs;
+   u64_set_t code_lines;
+   u64_set_t data_lines;
+   bool ok;
+
+   trace_stats_t() : instr(0), taken(0), ok(true) {
+      memset(classes, 0, sizeof(classes));
+      memset(load_sizes, 0, sizeof(load_sizes));
+      memset(store_sizes, 0, sizeof(store_sizes));
+      memset(reg_reads, 0, sizeof(reg_reads));
+      memset(reg_writes, 0, sizeof(reg_writes));
+   }
+
+   void add(const CVPTraceReader::Instr &in);
+   void merge(const trace_stats_t &other);
+};
+
+static inline unsigned size_bin(uint64_t size) {
+   for (unsigned b = 0; b < NUM_SIZE_BINS - 1; b++)
+      if (size == (1u << b))
+         return(b);
+   return(NUM_SIZE_BINS - 1);
+}
+
+void trace_stats_t::add(const CVPTraceReader::Instr &in) {
+   instr++;
+   if (in.mType < NUM_CLASSES)
+      classes[in.mType]++;
+   taken += (in.mTaken ? 1 : 0);
+
+   pcs.insert(in.mPc);
+   code_lines.insert(in.mPc >> LINE_SHIFT);
+
+   if ((in.mType == InstClass::loadInstClass) || (in.mType == InstClass::storeInstClass)) {
+      uint64_t size = (in.mMemSize ? in.mMemSize : 1);
+      ((in.mType == InstClass::loadInstClass) ? load_sizes : store_sizes)[size_bin(size)]++;
+      for (uint64_t line = (in.mEffAddr >> LINE_SHIFT); line <= ((in.mEffAddr + size - 1) >> LINE_SHIFT); line++)
+         data_lines.insert(line);
+   }
+
+   for (unsigned i = 0; i < in.mNumInRegs; i++)
+      if (in.mInRegs[i] < NUM_REGS)
+         reg_reads[in.mInRegs[i]]++;
+   for (unsigned i = 0; i < in.mNumOutRegs; i++)
+      if (in.mOutRegs[i] < NUM_REGS)
+         reg_writes[in.mOutRegs[i]]++;
+}
+
+void trace_stats_t::merge(const trace_stats_t &other) {
+   instr += other.instr;
+   taken += other.taken;
+   for (unsigned i = 0; i < NUM_CLASSES; i++)
+      classes[i] += other.classes[i];
+   for (unsigned i = 0; i < NUM_SIZE_BINS; i++) {
+      load_sizes[i] += other.load_sizes[i];
+      store_sizes[i] += other.store_sizes[i];
+   }
+   for (unsigned i = 0; i < NUM_REGS; i++) {
+      reg_reads[i] += other.reg_reads[i];
+      reg_writes[i] += other.reg_writes[i];
+   }
+   pcs.merge(other.pcs);
+   code_lines.merge(other.code_lines);
+   data_lines.merge(other.data_lines);
+   ok = (ok && other.ok);
+}
+
+// Decodes every record of "reader" into "stats".
+static void profile(CVPTraceReader &reader, trace_stats_t &stats) {
+   reader.mPrintSummary = false;
+   while (reader.readInstr())
+      stats.add(reader.mInstr);
+}
+
+// A unit of work: a whole stream trace, or one block of a block trace.
+struct work_t {
+   size_t trace;
+   int64_t block;	// -1: whole trace
+};
+
+struct trace_t {
+   std::string name;
+   int fd;		// block traces only
+   std::vector<block_trace_entry_t> table;
+   size_t max_block_size;
+};
+
+static void usage(const char *prog) {
+   printf("usage:\t%s\n\t[optional: -j <threads> (default: one per core)]\n\t[optional: -f <format>, format is one of: csv (default), json]\n\t[optional: -o <output file> (default: stdout)]\n\t[REQUIRED: one or more .gz or block trace files]\n", prog);
+   exit(0);
+}
+
+static void print_csv(FILE *fp, const std::vector<trace_t> &traces, const std::vector<trace_stats_t> &stats) {
+   fprintf(fp, "trace,instr");
+   for (auto name : class_names)
+      fprintf(fp, ",%s", name);
+   fprintf(fp, ",taken");
+   for (auto name : size_bin_names)
+      fprintf(fp, ",load_%s", name);
+   for (auto name : size_bin_names)
+      fprintf(fp, ",store_%s", name);
+   fprintf(fp, ",static_instr,code_footprint_bytes,data_footprint_bytes,int_reads,simd_reads,flag_reads,int_writes,simd_writes,flag_writes,regs_used\n");
+
+   for (size_t t = 0; t < traces.size(); t++) {
+      const trace_stats_t &s = stats[t];
+      if (!s.ok)
+         continue;
+      fprintf(fp, "%s,%" PRIu64, traces[t].name.c_str(), s.instr);
+      for (auto n : s.classes)
+         fprintf(fp, ",%" PRIu64, n);
+      fprintf(fp, ",%" PRIu64, s.taken);
+      for (auto n : s.load_sizes)
+         fprintf(fp, ",%" PRIu64, n);
+      for (auto n : s.store_sizes)
+         fprintf(fp, ",%" PRIu64, n);
+
+      uint64_t reads[3] = {0, 0, 0}, writes[3] = {0, 0, 0}, used = 0;
+      for (unsigned r = 0; r < NUM_REGS; r++) {
+         unsigned kind = ((r < Offset::vecOffset) ? 0 : ((r == Offset::ccOffset) ? 2 : 1));
+         reads[kind] += s.reg_reads[r];
+         writes[kind] += s.reg_writes[r];
+         used += ((s.reg_reads[r] || s.reg_writes[r]) ? 1 : 0);
+      }
+      fprintf(fp, ",%" PRIu64 ",%" PRIu64 ",%" PRIu64, s.pcs.size(), (s.code_lines.size() << LINE_SHIFT), (s.data_lines.size() << LINE_SHIFT));
+      fprintf(fp, ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+              reads[0], reads[1], reads[2], writes[0], writes[1], writes[2], used);
+   }
+}
+
+static void print_json_array(FILE *fp, const char *key, const uint64_t *v, unsigned n) {
+   fprintf(fp, "      \"%s\": [", key);
+   for (unsigned i = 0; i < n; i++)
+      fprintf(fp, "%s%" PRIu64, (i ? ", " : ""), v[i]);
+   fprintf(fp, "]");
+}
+
+static void print_json_map(FILE *fp, const char *key, const char **names, const uint64_t *v, unsigned n) {
+   fprintf(fp, "      \"%s\": {", key);
+   for (unsigned i = 0; i < n; i++)
+      fprintf(fp, "%s\"%s\": %" PRIu64, (i ? ", " : ""), names[i], v[i]);
+   fprintf(fp, "}");
+}
+
+static void print_json(FILE *fp, const std::vector<trace_t> &traces, const std::vector<trace_stats_t> &stats) {
+   bool first = true;
+   fprintf(fp, "[\n");
+   for (size_t t = 0; t < traces.size(); t++) {
+      const trace_stats_t &s = stats[t];
+      if (!s.ok)
+         continue;
+      fprintf(fp, "%s   {\n", (first ? "" : ",\n"));
+      first = false;
+      // Trace names are file names: only quotes and backslashes need escaping.
+      fprintf(fp, "      \"trace\": \"");
+      for (char c : traces[t].name)
+         fprintf(fp, (((c == '"') || (c == '\\')) ? "\\%c" : "%c"), c);
+      fprintf(fp, "\",\n      \"instr\": %" PRIu64 ",\n", s.instr);
+      print_json_map(fp, "classes", class_names, s.classes, NUM_CLASSES);
+      fprintf(fp, ",\n      \"taken\": %" PRIu64 ",\n", s.taken);
+      print_json_map(fp, "load_sizes", size_bin_names, s.load_sizes, NUM_SIZE_BINS);
+      fprintf(fp, ",\n");
+      print_json_map(fp, "store_sizes", size_bin_names, s.store_sizes, NUM_SIZE_BINS);
+      fprintf(fp, ",\n      \"static_instr\": %" PRIu64 ",\n", s.pcs.size());
+      fprintf(fp, "      \"code_footprint_bytes\": %" PRIu64 ",\n", (s.code_lines.size() << LINE_SHIFT));
+      fprintf(fp, "      \"data_footprint_bytes\": %" PRIu64 ",\n", (s.data_lines.size() << LINE_SHIFT));
+      print_json_array(fp, "reg_reads", s.reg_reads, NUM_REGS);
+      fprintf(fp, ",\n");
+      print_json_array(fp, "reg_writes", s.reg_writes, NUM_REGS);
+      fprintf(fp, "\n   }");
+   }
+   fprintf(fp, "\n]\n");
+}
+
+int main(int argc, char **argv) {
+   unsigned threads = 0;
+   const char *format = "csv";
+   const char *out_name = NULL;
+   int i = 1;
+
+   while ((i < argc) && (argv[i][0] == '-')) {
+      if (!strcmp(argv[i], "-j") && (i + 1 < argc)) {
+         threads = atoi(argv[i + 1]);
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-f") && (i + 1 < argc)) {
+         format = argv[i + 1];
+         i += 2;
+      }
+      else if (!strcmp(argv[i], "-o") && (i + 1 < argc)) {
+         out_name = argv[i + 1];
+         i += 2;
+      }
+      else {
+         usage(argv[0]);
+      }
+   }
+   if ((i == argc) || (strcmp(format, "csv") && strcmp(format, "json")))
+      usage(argv[0]);
+   if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+
+   // Split the traces into work units.
+   std::vector<trace_t> traces(argc - i);
+   std::vector<work_t> work;
+   for (size_t t = 0; t < traces.size(); t++) {
+      trace_t &trace = traces[t];
+      trace.name = argv[i + t];
+      trace.fd = -1;
+      trace.max_block_size = 0;
+      if (is_native_trace(trace.name.c_str()) || is_columnar_trace(trace.name.c_str()) || is_dict_trace(trace.name.c_str())) {
+         fprintf(stderr, "%s: %s is not a CVP-1 trace, profile the trace it was converted from\n", argv[0], trace.name.c_str());
+         return(1);
+      }
+      if (is_block_trace(trace.name.c_str())) {
+         block_trace_header_t header;
+         trace.fd = block_trace_open(trace.name.c_str(), header, trace.table);
+         if (trace.fd < 0)
+            return(1);
+         trace.max_block_size = header.max_block_size;
+         for (size_t b = 0; b < trace.table.size(); b++)
+            work.push_back(work_t{t, (int64_t)b});
+      }
+      else if (access(trace.name.c_str(), R_OK) == 0) {
+         work.push_back(work_t{t, -1});
+      }
+      else {
+         fprintf(stderr, "Cannot open trace %s\n", trace.name.c_str());
+         return(1);
+      }
+   }
+
+   // Each thread accumulates into its own statistics, merged per trace at the end.
+   threads = std::min((size_t)threads, std::max((size_t)1, work.size()));
+   std::vector<std::vector<trace_stats_t>> partial(threads);
+   std::atomic<size_t> next_work(0);
+   std::vector<std::thread> workers;
+   for (unsigned w = 0; w < threads; w++) {
+      workers.emplace_back([&, w]() {
+         std::vector<trace_stats_t> &mine = partial[w];
+         std::vector<uint8_t> in, buf;
+         mine.resize(traces.size());
+         size_t k;
+         while ((k = next_work++) < work.size()) {
+            const trace_t &trace = traces[work[k].trace];
+            trace_stats_t &stats = mine[work[k].trace];
+            if (work[k].block < 0) {
+               CVPTraceReader reader(open_trace_input(trace.name.c_str()));
+               profile(reader, stats);
+               continue;
+            }
+            const block_trace_entry_t &e = trace.table[work[k].block];
+            buf.resize(trace.max_block_size);
+            if (!block_trace_read(trace.fd, e, in, buf.data())) {
+               fprintf(stderr, "Corrupt block %" PRId64 " in block trace %s\n", work[k].block, trace.name.c_str());
+               stats.ok = false;
+               continue;
+            }
+            // Blocks start on record boundaries: each one is decoded by a reader of its own.
+            CVPTraceReader reader(new mem_input_t(buf.data(), e.size));
+            profile(reader, stats);
+         }
+      });
+   }
+   for (auto &t : workers)
+      t.join();
+
+   std::vector<trace_stats_t> stats(traces.size());
+   for (size_t t = 0; t < traces.size(); t++) {
+      for (auto &p : partial)
+         stats[t].merge(p[t]);
+      if (traces[t].fd >= 0)
+         close(traces[t].fd);
+   }
+
+   FILE *fp = (out_name ? fopen(out_name, "w") : stdout);
+   if (!fp) {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], out_name);
+      return(1);
+   }
+   if (!strcmp(format, "json"))
+      print_json(fp, traces, stats);
+   else
+      print_csv(fp, traces, stats);
+
+   bool ok = true;
+   for (auto &s : stats)
+      ok = (ok && s.ok);
+   if (fp != stdout)
+      fclose(fp);
+   return(ok ? 0 : 1);
+}